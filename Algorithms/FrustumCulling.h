@@ -0,0 +1,247 @@
+#pragma once
+
+/// GPU frustum culling of instances straight into indirect draw commands.  Instance bounds live in a GPUVector (spheres or boxes, world space),
+/// a compute pass appends the index of every visible instance to a compacted buffer and counts it in the instanceCount of its draw's DrawElementsIndirectCommand.
+/// The client never sees per instance visibility : draw() issues one glMultiDrawElementsIndirect over the culled commands.
+/// Program is built by the client from Shaders/Culling/FrustumCull.glsl with Shaders/Raytracing/FrustumIntersection.glsl (see FrustumCullPrograms).  FrustumCullCPU() is the reference, for verification.
+
+#include <cmath>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "GL_Containers/GPUVector.h"
+#include "GL_Containers/IndirectDraw.h"
+
+namespace glSugar
+{
+    /// must match local_size_x in Shaders/Culling/FrustumCull.glsl
+    constexpr GLuint CullGroupSize = 256;
+
+    struct FrustumCullPrograms
+    {
+        gl::Program cull;   // FrustumCull.glsl, with FrustumIntersection.glsl
+    };
+
+    /// center, radius.  Same encoding as the vec4 spheres of Shaders/Raytracing
+    struct BoundingSphere
+    {
+        float center[3];
+        float radius;
+    };
+
+    /// two std430 vec4s, w unused
+    struct BoundingBox
+    {
+        float min[3];
+        float pad0;
+        float max[3];
+        float pad1;
+    };
+
+    /// 6 planes, xyz inward facing unit normal and w distance : dot(normal, p) + w >= 0 is inside
+    struct Frustum
+    {
+        float planes[6][4];
+
+        /// - planes of a column major (OpenGL) view projection matrix, in the space the matrix transforms from.  Left, right, bottom, top, near, far
+        static Frustum fromMatrix(const float m[16])
+        {
+            Frustum rval;
+
+            for (int p = 0; p < 6; p++)
+            {
+                const int row = p / 2;
+                const float sign = (p % 2 == 0) ? 1.f : -1.f;
+
+                for (int k = 0; k < 4; k++)
+                {
+                    rval.planes[p][k] = m[k * 4 + 3] + sign * m[k * 4 + row];
+                }
+
+                const float len = std::sqrt(rval.planes[p][0] * rval.planes[p][0] + rval.planes[p][1] * rval.planes[p][1] + rval.planes[p][2] * rval.planes[p][2]);
+
+                for (int k = 0; k < 4; k++)
+                {
+                    rval.planes[p][k] /= len;
+                }
+            }
+
+            return rval;
+        }
+
+        /// - same test as SphereInFrustum() in FrustumIntersection.glsl
+        bool contains(const BoundingSphere& s) const
+        {
+            for (const auto& p : planes)
+            {
+                if (p[0] * s.center[0] + p[1] * s.center[1] + p[2] * s.center[2] + p[3] < -s.radius) return false;
+            }
+
+            return true;
+        }
+
+        /// - same test as AABBInFrustum() in FrustumIntersection.glsl
+        bool contains(const BoundingBox& b) const
+        {
+            for (const auto& p : planes)
+            {
+                float d = p[3];
+
+                for (int k = 0; k < 3; k++)
+                {
+                    d += p[k] * (p[k] >= 0.f ? b.max[k] : b.min[k]);
+                }
+
+                if (d < 0.f) return false;
+            }
+
+            return true;
+        }
+    };
+
+    /// - draw commands whose instance counts are written by a GPU culling pass.
+    /// - setDraws() lays out one range of Visible() per draw, sized to the instances that may use it.  cull() fills the ranges with the indices of visible instances
+    ///   and sets each command's instanceCount.  Visible instances past a draw's capacity are dropped and its instanceCount stays at the capacity.  The draw's shaders find their instance at Visible()[gl_BaseInstance + gl_InstanceID], or bind Visible() as an
+    ///   instanced uint attribute, which baseInstance offsets automatically
+    struct GPUFrustumCuller
+    {
+        /// - one command per mesh.  draws[c].instanceCount is the most instances that can use mesh c (its slice of Visible()); baseInstance is assigned here
+        void setDraws(std::span<const DrawElementsIndirectCommand> draws)
+        {
+            std::vector<DrawElementsIndirectCommand> reset(draws.begin(), draws.end());
+
+            GLuint base = 0;
+
+            for (DrawElementsIndirectCommand& d : reset)
+            {
+                const GLuint capacity = d.instanceCount;
+
+                d.baseInstance = base;
+                d.instanceCount = 0;
+
+                base += capacity;
+            }
+
+            capacities.clear();
+
+            for (const DrawElementsIndirectCommand& d : draws)
+            {
+                capacities.push_back(d.instanceCount);
+            }
+
+            resetCommands.assign(reset);
+            commands.assign(reset);
+            visible.resize(std::max<GLuint>(base, 1u));
+        }
+
+        /// - cull bounds[i] for i < bounds.Size(), instance i going to command drawIds[i] (or command 0 without drawIds).  Which instances of a draw are kept
+        ///   when more than its capacity are visible is unspecified
+        template <bool Mapped>
+        void cull(FrustumCullPrograms& progs, GPUVector<BoundingSphere, Mapped>& bounds, const Frustum& frustum, GPUVector<GLuint>* drawIds = nullptr)
+        {
+            glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, "Frustum Cull Spheres");
+            dispatch(progs, bounds, false, frustum, drawIds);
+            glPopDebugGroup();
+        }
+
+        template <bool Mapped>
+        void cull(FrustumCullPrograms& progs, GPUVector<BoundingBox, Mapped>& bounds, const Frustum& frustum, GPUVector<GLuint>* drawIds = nullptr)
+        {
+            glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, "Frustum Cull Boxes");
+            dispatch(progs, bounds, true, frustum, drawIds);
+            glPopDebugGroup();
+        }
+
+        /// - one glMultiDrawElementsIndirect over every draw, with the vao and element buffer bound by the caller
+        void draw(GLenum mode, GLenum indexType = GL_UNSIGNED_INT)
+        {
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commands.storage().name());
+            glMultiDrawElementsIndirect(mode, indexType, (const void*)commands.StorageOffset(), GLsizei(commands.Size()), 0);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        }
+
+        /// - the culled commands, eg. to readAsync() the visible counts for stats
+        GPUVector<DrawElementsIndirectCommand>& Commands()
+        {
+            return commands;
+        }
+
+        /// - visible instance indices, draw c's at [baseInstance, baseInstance + instanceCount)
+        GPUVector<GLuint>& Visible()
+        {
+            return visible;
+        }
+
+    private:
+
+        GPUVector<DrawElementsIndirectCommand> commands;
+        GPUVector<DrawElementsIndirectCommand> resetCommands;   // commands with zero instance counts
+        GPUVector<GLuint> visible;
+        GPUVector<GLuint> capacities;                           // instanceCount of each draw as passed to setDraws()
+
+        template <typename Bounds, bool Mapped>
+        void dispatch(FrustumCullPrograms& progs, GPUVector<Bounds, Mapped>& bounds, bool boxes, const Frustum& frustum, GPUVector<GLuint>* drawIds)
+        {
+            assert(commands.Size() > 0);
+            assert(!drawIds || drawIds->Size() >= bounds.Size());
+
+            // -- the pass runs on the server, so it has to see staged / unflushed writes
+            bounds.flush();
+
+            if (drawIds)
+            {
+                drawIds->flush();
+            }
+
+            resetCommands.storage().CopySubData(commands.storage(), resetCommands.StorageOffset(), commands.StorageOffset(), commands.SizeBytes());
+            glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+            if (bounds.Size())
+            {
+                // -- bind() starts heap backed vectors at their first element, the shader indexes every buffer from 0
+                bounds.bind(GL_SHADER_STORAGE_BUFFER, 0);
+                (drawIds ? *drawIds : visible).bind(GL_SHADER_STORAGE_BUFFER, 1);
+                visible.bind(GL_SHADER_STORAGE_BUFFER, 2);
+                commands.bind(GL_SHADER_STORAGE_BUFFER, 3);
+                capacities.bind(GL_SHADER_STORAGE_BUFFER, 4);
+
+                gl::Program& p = progs.cull;
+                p.Use();
+                p.Uniform1<GLuint>("count", GLuint(bounds.Size()));
+                p.Uniform1<GLint>("boxes", boxes ? 1 : 0);
+                p.Uniform1<GLint>("hasDrawIds", drawIds ? 1 : 0);
+
+                for (int i = 0; i < 6; i++)
+                {
+                    const std::string name = "planes[" + std::to_string(i) + "]";
+                    p.Uniform4<GLfloat>(name.c_str(), frustum.planes[i][0], frustum.planes[i][1], frustum.planes[i][2], frustum.planes[i][3]);
+                }
+
+                glDispatchCompute(GLuint((bounds.Size() + CullGroupSize - 1) / CullGroupSize), 1, 1);
+            }
+
+            // -- read next as indirect commands and as instance data
+            glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+        }
+    };
+
+    /*** CPU reference implementation ***/
+
+    /// - visible instance indices of each draw, in instance order.  drawIds empty puts every instance in draw 0
+    template <typename Bounds>
+    std::vector<std::vector<GLuint>> FrustumCullCPU(std::span<const Bounds> bounds, const Frustum& frustum, std::size_t drawCount, std::span<const GLuint> drawIds = {})
+    {
+        std::vector<std::vector<GLuint>> rval(drawCount);
+
+        for (std::size_t i = 0; i < bounds.size(); i++)
+        {
+            if (frustum.contains(bounds[i]))
+            {
+                rval[drawIds.empty() ? 0u : drawIds[i]].push_back(GLuint(i));
+            }
+        }
+
+        return rval;
+    }
+}
@@ -0,0 +1,516 @@
+#pragma once
+
+/// GPU resident particle system.  Particles live in a GPUPingPongVector and every stage runs in compute shaders, built by the client from Shaders/Particles/ (see ParticlePrograms) :
+/// - simulate : age, gravity / drag, collision with planes and spheres, and compaction of the survivors into the back buffer, all in one pass (ParticleSimulate.glsl)
+/// - emit : append the particles queued with emit() (ParticleEmit.glsl)
+/// - finalize : clamp the count and write the indirect dispatch / draw commands (ParticleFinalize.glsl)
+/// - sort : optional back to front draw order with RadixSortIndices() (ParticleSortKeys.glsl)
+/// The live count never leaves the GPU : the simulation is dispatched, and the particles drawn, with indirect commands the finalize pass writes.
+/// ParticleSystemCPU runs the same stages on the client, for verification.
+
+#include <cmath>
+#include <cstddef>
+#include <span>
+#include <vector>
+
+#include "Algorithms/RadixSort.h"
+#include "GL_Containers/GPUPingPongVector.h"
+#include "GL_Containers/IndirectDraw.h"
+
+namespace glSugar
+{
+    /// must match local_size_x of ParticleSimulate.glsl / ParticleEmit.glsl / ParticleSortKeys.glsl
+    constexpr GLuint ParticleGroupSize = 256;
+
+    /// std430 layout of Particle in Shaders/Particles
+    struct Particle
+    {
+        float position[3];
+        float age;
+        float velocity[3];
+        float lifetime;
+        float color[4];
+    };
+
+    static_assert(sizeof(Particle) == 48);
+
+    /// spawn volume and initial state of particles.  Positions are uniform directions scaled by radius * random, velocities by velocitySpread * random
+    struct ParticleEmitter
+    {
+        float position[3] = { 0.f, 0.f, 0.f };
+        float radius = 0.f;
+        float velocity[3] = { 0.f, 0.f, 0.f };
+        float velocitySpread = 1.f;
+        float color[4] = { 1.f, 1.f, 1.f, 1.f };
+        float lifetimeMin = 1.f;
+        float lifetimeMax = 2.f;
+    };
+
+    /// xyz normal (unit length), w distance : points with dot(normal, p) + w < 0 are pushed back out
+    struct ParticlePlane
+    {
+        float normal[3];
+        float distance;
+    };
+
+    /// particles inside are pushed out to the surface
+    struct ParticleSphere
+    {
+        float center[3];
+        float radius;
+    };
+
+    struct ParticleSimulationSettings
+    {
+        float gravity[3] = { 0.f, -9.81f, 0.f };
+        float drag = 0.f;               // fraction of the velocity lost per second
+        float restitution = 0.5f;       // fraction of the normal velocity kept by a bounce
+        float friction = 0.1f;          // fraction of the tangential velocity lost by a bounce
+    };
+
+    /// layout of the commands ParticleFinalize.glsl writes
+    struct ParticleIndirectCommands
+    {
+        GLuint dispatch[3];                 // glDispatchComputeIndirect of the next step
+        GLuint pad;
+        DrawArraysIndirectCommand drawArrays;
+        DrawElementsIndirectCommand drawElements;
+    };
+
+    struct ParticlePrograms
+    {
+        gl::Program simulate;   // ParticleSimulate.glsl
+        gl::Program emit;       // ParticleEmit.glsl
+        gl::Program finalize;   // ParticleFinalize.glsl
+        gl::Program sortKeys;   // ParticleSortKeys.glsl, with SortKey.glsl
+    };
+
+    /// PCG hash, matches particleHash() in ParticleEmit.glsl
+    inline GLuint particleHash(GLuint v)
+    {
+        const GLuint state = v * 747796405u + 2891336453u;
+        const GLuint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+        return (word >> 22u) ^ word;
+    }
+
+    struct ParticleSystem
+    {
+        ParticleSimulationSettings settings;
+
+        /// - capacity is fixed : emission past it is dropped
+        explicit ParticleSystem(std::size_t capacityIn) : particles(capacityIn), capacity(capacityIn)
+        {
+            particles.reserve(capacity);
+
+            const ParticleIndirectCommands none = {};
+            commands.Storage(sizeof(none), &none, GL_DYNAMIC_STORAGE_BIT);
+
+            // -- zero length SSBO bindings are invalid, so keep a slot in each even without colliders
+            planes.reserve(1);
+            spheres.reserve(1);
+        }
+
+        /// - queue count particles from emitter, appended by the next update()
+        void emit(const ParticleEmitter& emitter, GLuint count)
+        {
+            if (count)
+            {
+                emitQueue.push_back({ emitter, count });
+            }
+        }
+
+        void setColliders(std::span<const ParticlePlane> planesIn, std::span<const ParticleSphere> spheresIn)
+        {
+            planes.assign(planesIn);
+            spheres.assign(spheresIn);
+        }
+
+        /// - one step : simulate and collide the live particles, append the queued emissions, write the indirect commands.  No readback of the count
+        void update(ParticlePrograms& progs, float dt)
+        {
+            glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, "Particle Update");
+
+            GLuint emitted = 0;
+
+            for (const EmitRequest& e : emitQueue)
+            {
+                emitted += e.count;
+            }
+
+            refineBound();
+
+            particles.beginStep(std::min(capacity, bound + emitted));
+            particles.bind(0, 1);
+            particles.bindCounters(2);
+
+            {
+                planes.bind(GL_SHADER_STORAGE_BUFFER, 3);
+                spheres.bind(GL_SHADER_STORAGE_BUFFER, 4);
+
+                gl::Program& p = progs.simulate;
+                p.Use();
+                p.Uniform1<GLuint>("frontSlot", particles.FrontCounterIndex());
+                p.Uniform1<GLuint>("backSlot", particles.BackCounterIndex());
+                p.Uniform1<GLfloat>("dt", dt);
+                p.Uniform3<GLfloat>("gravity", settings.gravity[0], settings.gravity[1], settings.gravity[2]);
+                p.Uniform1<GLfloat>("drag", settings.drag);
+                p.Uniform1<GLfloat>("restitution", settings.restitution);
+                p.Uniform1<GLfloat>("friction", settings.friction);
+                p.Uniform1<GLuint>("planeCount", GLuint(planes.Size()));
+                p.Uniform1<GLuint>("sphereCount", GLuint(spheres.Size()));
+
+                glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, commands.name());
+                glDispatchComputeIndirect(GLintptr(offsetof(ParticleIndirectCommands, dispatch)));
+                glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+            }
+
+            for (const EmitRequest& e : emitQueue)
+            {
+                const ParticleEmitter& em = e.emitter;
+
+                gl::Program& p = progs.emit;
+                p.Use();
+                p.Uniform1<GLuint>("backSlot", particles.BackCounterIndex());
+                p.Uniform1<GLuint>("capacity", GLuint(capacity));
+                p.Uniform1<GLuint>("emitCount", e.count);
+                p.Uniform1<GLuint>("seed", nextSeed);
+                p.Uniform3<GLfloat>("position", em.position[0], em.position[1], em.position[2]);
+                p.Uniform1<GLfloat>("radius", em.radius);
+                p.Uniform3<GLfloat>("velocity", em.velocity[0], em.velocity[1], em.velocity[2]);
+                p.Uniform1<GLfloat>("velocitySpread", em.velocitySpread);
+                p.Uniform4<GLfloat>("color", em.color[0], em.color[1], em.color[2], em.color[3]);
+                p.Uniform1<GLfloat>("lifetimeMin", em.lifetimeMin);
+                p.Uniform1<GLfloat>("lifetimeMax", em.lifetimeMax);
+
+                glDispatchCompute((e.count + ParticleGroupSize - 1) / ParticleGroupSize, 1, 1);
+                glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+                nextSeed += e.count;
+            }
+
+            emitQueue.clear();
+
+            {
+                glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, commands.name());
+
+                gl::Program& p = progs.finalize;
+                p.Use();
+                p.Uniform1<GLuint>("backSlot", particles.BackCounterIndex());
+                p.Uniform1<GLuint>("capacity", GLuint(capacity));
+
+                glDispatchCompute(1, 1, 1);
+            }
+
+            particles.swap();
+
+            bound = particles.Size();
+            emittedSinceReadback += emitted;
+
+            glPopDebugGroup();
+        }
+
+        /// - back to front draw order for alpha blending : DrawOrder()[i] is the index of the i'th particle to draw.  Draw with drawSorted()
+        void sort(ParticlePrograms& progs, StreamCompactionPrograms& scanProgs, RadixSortPrograms& radixProgs, RadixSortScratch& scratch, const float eye[3])
+        {
+            glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, "Particle Sort");
+
+            // -- keys past the live count sort last, and the draw only takes the live count
+            sortKeys.resize(bound);
+
+            if (bound)
+            {
+                particles.front().bind(GL_SHADER_STORAGE_BUFFER, 0);
+                sortKeys.bind(GL_SHADER_STORAGE_BUFFER, 1);
+                particles.bindCounters(2);
+
+                gl::Program& p = progs.sortKeys;
+                p.Use();
+                p.Uniform1<GLuint>("frontSlot", particles.FrontCounterIndex());
+                p.Uniform1<GLuint>("count", GLuint(bound));
+                p.Uniform3<GLfloat>("eye", eye[0], eye[1], eye[2]);
+
+                glDispatchCompute(GLuint((bound + ParticleGroupSize - 1) / ParticleGroupSize), 1, 1);
+                glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+            }
+
+            RadixSortIndices(scanProgs, radixProgs, sortKeys, drawOrder, scratch);
+
+            glPopDebugGroup();
+        }
+
+        /// - draw the live particles in storage order.  The bound vao reads them from Particles().front(), see GPUPingPongVector::bindVertexBuffer (rebind every update)
+        ///   or from an SSBO with gl_VertexID
+        void draw(GLenum mode = GL_POINTS)
+        {
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commands.name());
+            glDrawArraysIndirect(mode, (const void*)offsetof(ParticleIndirectCommands, drawArrays));
+        }
+
+        /// - draw the live particles in the order of the last sort().  The bound vao needs DrawOrder().storage() as its element buffer
+        void drawSorted(GLenum mode = GL_POINTS)
+        {
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commands.name());
+            glDrawElementsIndirect(mode, GL_UNSIGNED_INT, (const void*)offsetof(ParticleIndirectCommands, drawElements));
+        }
+
+        GPUPingPongVector<Particle>& Particles()
+        {
+            return particles;
+        }
+
+        GPUVector<GLuint>& DrawOrder()
+        {
+            return drawOrder;
+        }
+
+        /// - dispatch and draw commands for the current particles, laid out as ParticleIndirectCommands
+        gl::Buffer& IndirectCommands()
+        {
+            return commands;
+        }
+
+        std::size_t Capacity() const
+        {
+            return capacity;
+        }
+
+        /// - upper bound of the live count known on the client, without stalling.  Tightened whenever an asynchronous read of the count lands
+        std::size_t CountBound() const
+        {
+            return bound;
+        }
+
+    private:
+
+        struct EmitRequest
+        {
+            ParticleEmitter emitter;
+            GLuint count;
+        };
+
+        GPUPingPongVector<Particle> particles;
+        std::size_t capacity;
+
+        gl::Buffer commands;
+
+        GPUVector<ParticlePlane> planes;
+        GPUVector<ParticleSphere> spheres;
+
+        GPUVector<GLuint> sortKeys;
+        GPUVector<GLuint> drawOrder;
+
+        std::vector<EmitRequest> emitQueue;
+        GLuint nextSeed = 0;
+
+        std::size_t bound = 0;
+
+        // -- count read back a few frames late, plus what was emitted since, bounds the live count
+        GPUReadback<GLuint> countReadback;
+        bool countPending = false;
+        std::size_t emittedSinceReadback = 0;
+
+        void refineBound()
+        {
+            if (countPending && countReadback.ready())
+            {
+                bound = std::min(bound, std::size_t(countReadback.data()[0]) + emittedSinceReadback);
+                particles.setSizeBound(bound);
+                countPending = false;
+            }
+
+            if (!countPending)
+            {
+                countReadback = particles.readCountAsync();
+                countPending = true;
+                emittedSinceReadback = 0;
+            }
+        }
+    };
+
+    /*** CPU reference implementation ***/
+
+    namespace detail
+    {
+        inline float particleRandom01(GLuint& state)
+        {
+            state = particleHash(state);
+            return float(state >> 8u) * (1.0f / 16777216.0f);
+        }
+
+        inline void particleRandomDirection(GLuint& state, float out[3])
+        {
+            const float z = particleRandom01(state) * 2.f - 1.f;
+            const float phi = particleRandom01(state) * 6.28318530718f;
+            const float r = std::sqrt(std::max(0.f, 1.f - z * z));
+
+            out[0] = r * std::cos(phi);
+            out[1] = r * std::sin(phi);
+            out[2] = z;
+        }
+
+        inline float particleDot(const float a[3], const float b[3])
+        {
+            return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+        }
+
+        inline void particleBounce(float velocity[3], const float n[3], const ParticleSimulationSettings& settings)
+        {
+            const float vn = particleDot(velocity, n);
+
+            if (vn < 0.f)
+            {
+                for (int k = 0; k < 3; k++)
+                {
+                    const float vt = velocity[k] - n[k] * vn;
+                    velocity[k] = vt * (1.f - settings.friction) - n[k] * (vn * settings.restitution);
+                }
+            }
+        }
+    }
+
+    /// - same as ParticleEmit.glsl : count particles seeded from seed + index, appended to out
+    inline void EmitParticlesCPU(const ParticleEmitter& em, GLuint count, GLuint seed, std::vector<Particle>& out)
+    {
+        for (GLuint i = 0; i < count; i++)
+        {
+            GLuint state = particleHash(seed + i);
+
+            Particle p = {};
+            float dir[3];
+
+            detail::particleRandomDirection(state, dir);
+            const float r = em.radius * detail::particleRandom01(state);
+
+            for (int k = 0; k < 3; k++) p.position[k] = em.position[k] + dir[k] * r;
+
+            detail::particleRandomDirection(state, dir);
+            const float s = em.velocitySpread * detail::particleRandom01(state);
+
+            for (int k = 0; k < 3; k++) p.velocity[k] = em.velocity[k] + dir[k] * s;
+
+            const float t = detail::particleRandom01(state);
+            p.lifetime = em.lifetimeMin + (em.lifetimeMax - em.lifetimeMin) * t;
+            std::copy(em.color, em.color + 4, p.color);
+
+            out.push_back(p);
+        }
+    }
+
+    /// - same as ParticleSimulate.glsl, except that the survivors keep their order
+    inline std::vector<Particle> SimulateParticlesCPU(std::span<const Particle> in, const ParticleSimulationSettings& settings,
+        std::span<const ParticlePlane> planes, std::span<const ParticleSphere> spheres, float dt)
+    {
+        std::vector<Particle> rval;
+        rval.reserve(in.size());
+
+        for (Particle p : in)
+        {
+            p.age += dt;
+
+            if (p.age >= p.lifetime) continue;
+
+            const float damping = std::max(0.f, 1.f - settings.drag * dt);
+
+            for (int k = 0; k < 3; k++)
+            {
+                p.velocity[k] = (p.velocity[k] + settings.gravity[k] * dt) * damping;
+                p.position[k] += p.velocity[k] * dt;
+            }
+
+            for (const ParticlePlane& plane : planes)
+            {
+                const float d = detail::particleDot(plane.normal, p.position) + plane.distance;
+
+                if (d < 0.f)
+                {
+                    for (int k = 0; k < 3; k++) p.position[k] -= plane.normal[k] * d;
+                    detail::particleBounce(p.velocity, plane.normal, settings);
+                }
+            }
+
+            for (const ParticleSphere& sphere : spheres)
+            {
+                float toP[3] = { p.position[0] - sphere.center[0], p.position[1] - sphere.center[1], p.position[2] - sphere.center[2] };
+                const float dist = std::sqrt(detail::particleDot(toP, toP));
+
+                if (dist < sphere.radius && dist > 0.f)
+                {
+                    const float n[3] = { toP[0] / dist, toP[1] / dist, toP[2] / dist };
+
+                    for (int k = 0; k < 3; k++) p.position[k] = sphere.center[k] + n[k] * sphere.radius;
+                    detail::particleBounce(p.velocity, n, settings);
+                }
+            }
+
+            rval.push_back(p);
+        }
+
+        return rval;
+    }
+
+    /// - ParticleSystem on the client : same stages, same emission seeds, order preserving
+    struct ParticleSystemCPU
+    {
+        ParticleSimulationSettings settings;
+        std::vector<ParticlePlane> planes;
+        std::vector<ParticleSphere> spheres;
+
+        std::vector<Particle> particles;
+
+        explicit ParticleSystemCPU(std::size_t capacityIn) : capacity(capacityIn)
+        {
+        }
+
+        void emit(const ParticleEmitter& emitter, GLuint count)
+        {
+            if (count)
+            {
+                emitQueue.push_back({ emitter, count });
+            }
+        }
+
+        void update(float dt)
+        {
+            particles = SimulateParticlesCPU(particles, settings, planes, spheres, dt);
+
+            for (const auto& [emitter, count] : emitQueue)
+            {
+                EmitParticlesCPU(emitter, count, nextSeed, particles);
+                nextSeed += count;
+            }
+
+            emitQueue.clear();
+
+            if (particles.size() > capacity)
+            {
+                particles.resize(capacity);
+            }
+        }
+
+        /// - matches ParticleSystem::DrawOrder() after sort(), up to particles at the same distance
+        std::vector<GLuint> sortOrder(const float eye[3]) const
+        {
+            std::vector<GLuint> keys(particles.size());
+
+            for (std::size_t i = 0; i < particles.size(); i++)
+            {
+                const float d[3] = { particles[i].position[0] - eye[0], particles[i].position[1] - eye[1], particles[i].position[2] - eye[2] };
+                keys[i] = ~FloatToSortKey(std::sqrt(detail::particleDot(d, d)));
+            }
+
+            return RadixSortIndicesCPU(keys);
+        }
+
+    private:
+
+        struct EmitRequest
+        {
+            ParticleEmitter emitter;
+            GLuint count;
+        };
+
+        std::size_t capacity;
+        std::vector<EmitRequest> emitQueue;
+        GLuint nextSeed = 0;
+    };
+}
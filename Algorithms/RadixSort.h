@@ -0,0 +1,267 @@
+#pragma once
+
+/// GPU LSD radix sort of 32 bit uint keys, optionally moving a uint payload (eg. particle indices) with them.  Sorts GPUVector buffers in place.
+/// 4 bits per pass : histogram per workgroup, exclusive scan of the histograms (Scan() from StreamCompaction.h), stable scatter.
+/// Programs are built by the client from Shaders/RadixSort/ (see RadixSortPrograms).  Float keys : floatToSortKey() / backToFrontSortKey() in SortKey.glsl.
+/// RadixSortCPU() is the same algorithm on the client, for verification.
+
+#include <cstring>
+#include <span>
+#include <vector>
+
+#include "Algorithms/StreamCompaction.h"
+
+namespace glSugar
+{
+    constexpr GLuint RadixBits = 4;
+    constexpr GLuint RadixDigits = 1u << RadixBits;
+
+    struct RadixSortPrograms
+    {
+        gl::Program histogram;  // RadixHistogram.glsl
+        gl::Program scatter;    // RadixScatter.glsl
+    };
+
+    /// Temporary GPU storage for the sort passes.  Keep one around and reuse it to avoid reallocating every frame
+    struct RadixSortScratch
+    {
+        ScanScratch scan;
+
+        gl::Buffer keys;            // ping pong partners of the keys / values being sorted
+        gl::Buffer values;
+        gl::Buffer histograms;
+
+        std::size_t capacity = 0;
+        std::size_t histogramCapacity = 0;
+
+        void reserve(std::size_t count)
+        {
+            if (capacity < count)
+            {
+                keys = gl::Buffer();
+                keys.Storage(count * sizeof(GLuint), nullptr, 0);
+
+                values = gl::Buffer();
+                values.Storage(count * sizeof(GLuint), nullptr, 0);
+
+                capacity = count;
+            }
+
+            const std::size_t histogramCount = RadixDigits * scanBlockCount(count);
+
+            if (histogramCapacity < histogramCount)
+            {
+                histograms = gl::Buffer();
+                histograms.Storage(histogramCount * sizeof(GLuint), nullptr, 0);
+                histogramCapacity = histogramCount;
+            }
+        }
+    };
+
+    /// - sort count keys in place, ascending and stable.  Only the low keyBits bits are sorted on (rounded up to a multiple of RadixBits); fewer bits means fewer passes.
+    /// - values, if not null, move with the keys.  iotaValues fills values with each key's original index instead of reading them, ie. values becomes the sorted order.
+    /// - keys / values start at byte offsets keysOffset / valuesOffset, which must be multiples of GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT
+    inline void RadixSort(StreamCompactionPrograms& scanProgs, RadixSortPrograms& progs,
+        gl::Buffer& keys, std::size_t keysOffset,
+        gl::Buffer* values, std::size_t valuesOffset,
+        bool iotaValues,
+        std::size_t count,
+        RadixSortScratch& scratch,
+        GLuint keyBits = 32u)
+    {
+        if (!count) return;
+
+        assert(values || !iotaValues);
+
+        scratch.reserve(count);
+
+        const GLuint blocks = scanBlockCount(count);
+        const GLuint passes = (std::min(keyBits, 32u) + RadixBits - 1) / RadixBits;
+
+        const GLsizeiptr bytes = GLsizeiptr(count * sizeof(GLuint));
+
+        // -- (buffer, offset) pairs ping ponging between the caller's buffers and the scratch buffers
+        struct Range
+        {
+            gl::Buffer* buffer;
+            std::size_t offset;
+
+            void bind(GLuint index, GLsizeiptr size) const
+            {
+                glBindBufferRange(GL_SHADER_STORAGE_BUFFER, index, buffer->name(), GLintptr(offset), size);
+            }
+        };
+
+        Range keysIn = { &keys, keysOffset };
+        Range keysOut = { &scratch.keys, 0u };
+        Range valuesIn = values ? Range{ values, valuesOffset } : keysIn;
+        Range valuesOut = values ? Range{ &scratch.values, 0u } : keysOut;
+
+        for (GLuint pass = 0; pass < passes; pass++)
+        {
+            const GLuint shift = pass * RadixBits;
+
+            keysIn.bind(0, bytes);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, scratch.histograms.name());
+
+            progs.histogram.Use();
+            progs.histogram.Uniform1<GLuint>("count", GLuint(count));
+            progs.histogram.Uniform1<GLuint>("shift", shift);
+            progs.histogram.Uniform1<GLuint>("blockCount", blocks);
+
+            glDispatchCompute(blocks, 1, 1);
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+            Scan(scanProgs, scratch.histograms, 0u, scratch.histograms, 0u, RadixDigits * blocks, false, scratch.scan);
+
+            keysIn.bind(0, bytes);
+            keysOut.bind(1, bytes);
+            valuesIn.bind(2, bytes);
+            valuesOut.bind(3, bytes);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, scratch.histograms.name());
+
+            progs.scatter.Use();
+            progs.scatter.Uniform1<GLuint>("count", GLuint(count));
+            progs.scatter.Uniform1<GLuint>("shift", shift);
+            progs.scatter.Uniform1<GLuint>("blockCount", blocks);
+            progs.scatter.Uniform1<GLint>("hasValues", values ? 1 : 0);
+            progs.scatter.Uniform1<GLint>("iotaValues", (iotaValues && pass == 0) ? 1 : 0);
+
+            glDispatchCompute(blocks, 1, 1);
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+            std::swap(keysIn, keysOut);
+
+            if (values)
+            {
+                std::swap(valuesIn, valuesOut);
+            }
+        }
+
+        // -- an odd number of passes leaves the result in the scratch buffers
+        if (keysIn.buffer != &keys)
+        {
+            keysIn.buffer->CopySubData(keys, 0u, keysOffset, bytes);
+
+            if (values)
+            {
+                valuesIn.buffer->CopySubData(*values, 0u, valuesOffset, bytes);
+            }
+        }
+        else if (values && iotaValues && passes == 0)
+        {
+            // -- nothing to sort on, but values still has to come out as the identity order
+            std::vector<GLuint> iota(count);
+            std::iota(iota.begin(), iota.end(), GLuint(0));
+            values->SubData(valuesOffset, bytes, iota.data());
+        }
+
+        // -- sorted indices are commonly drawn straight from, as an element buffer or instance attribute
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_ELEMENT_ARRAY_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+    }
+
+    template <bool Mapped>
+    void RadixSort(StreamCompactionPrograms& scanProgs, RadixSortPrograms& progs, GPUVector<GLuint, Mapped>& keys, RadixSortScratch& scratch, GLuint keyBits = 32u)
+    {
+        glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, "Radix Sort");
+
+        // -- the sort runs on the server, so it has to see any staged / unflushed writes
+        keys.flush();
+
+        RadixSort(scanProgs, progs, keys.storage(), keys.StorageOffset(), nullptr, 0u, false, keys.Size(), scratch, keyBits);
+
+        glPopDebugGroup();
+    }
+
+    /// - sort keys, moving values with them.  values must hold at least keys.Size() elements
+    template <bool KeysMapped, bool ValuesMapped>
+    void RadixSort(StreamCompactionPrograms& scanProgs, RadixSortPrograms& progs, GPUVector<GLuint, KeysMapped>& keys, GPUVector<GLuint, ValuesMapped>& values, RadixSortScratch& scratch, GLuint keyBits = 32u)
+    {
+        glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, "Radix Sort Key Value");
+
+        assert(values.Size() >= keys.Size());
+
+        keys.flush();
+        values.flush();
+
+        RadixSort(scanProgs, progs, keys.storage(), keys.StorageOffset(), &values.storage(), values.StorageOffset(), false, keys.Size(), scratch, keyBits);
+
+        glPopDebugGroup();
+    }
+
+    /// - sort keys and write the sorted order to indices : indices[i] is the original position of the i'th smallest key.  eg. back to front draw order for particles
+    template <bool KeysMapped, bool IndicesMapped>
+    void RadixSortIndices(StreamCompactionPrograms& scanProgs, RadixSortPrograms& progs, GPUVector<GLuint, KeysMapped>& keys, GPUVector<GLuint, IndicesMapped>& indices, RadixSortScratch& scratch, GLuint keyBits = 32u)
+    {
+        glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, "Radix Sort Indices");
+
+        keys.flush();
+        indices.resize(keys.Size());
+
+        RadixSort(scanProgs, progs, keys.storage(), keys.StorageOffset(), &indices.storage(), indices.StorageOffset(), true, keys.Size(), scratch, keyBits);
+
+        glPopDebugGroup();
+    }
+
+    /*** CPU reference implementation ***/
+
+    /// matches floatToSortKey() in SortKey.glsl
+    inline GLuint FloatToSortKey(float f)
+    {
+        GLuint u;
+        std::memcpy(&u, &f, sizeof(u));
+        return (u & 0x80000000u) ? ~u : (u | 0x80000000u);
+    }
+
+    /// - same passes as the GPU version : per pass digit histogram, exclusive scan, stable scatter.  values may be empty
+    inline void RadixSortCPU(std::span<GLuint> keys, std::span<GLuint> values = {}, GLuint keyBits = 32u)
+    {
+        assert(values.empty() || values.size() >= keys.size());
+
+        const GLuint passes = (std::min(keyBits, 32u) + RadixBits - 1) / RadixBits;
+
+        std::vector<GLuint> keysOut(keys.size());
+        std::vector<GLuint> valuesOut(values.empty() ? 0u : keys.size());
+
+        for (GLuint pass = 0; pass < passes; pass++)
+        {
+            const GLuint shift = pass * RadixBits;
+
+            GLuint offsets[RadixDigits] = {};
+
+            for (GLuint k : keys)
+            {
+                offsets[(k >> shift) & (RadixDigits - 1)]++;
+            }
+
+            std::exclusive_scan(offsets, offsets + RadixDigits, offsets, GLuint(0));
+
+            for (std::size_t i = 0; i < keys.size(); i++)
+            {
+                const GLuint dst = offsets[(keys[i] >> shift) & (RadixDigits - 1)]++;
+
+                keysOut[dst] = keys[i];
+
+                if (!values.empty())
+                {
+                    valuesOut[dst] = values[i];
+                }
+            }
+
+            std::copy(keysOut.begin(), keysOut.end(), keys.begin());
+            std::copy(valuesOut.begin(), valuesOut.end(), values.begin());
+        }
+    }
+
+    /// - CPU version of RadixSortIndices
+    inline std::vector<GLuint> RadixSortIndicesCPU(std::span<const GLuint> keysIn, GLuint keyBits = 32u)
+    {
+        std::vector<GLuint> keys(keysIn.begin(), keysIn.end());
+        std::vector<GLuint> indices(keys.size());
+        std::iota(indices.begin(), indices.end(), GLuint(0));
+
+        RadixSortCPU(keys, indices, keyBits);
+
+        return indices;
+    }
+}
@@ -0,0 +1,346 @@
+#pragma once
+
+/// GPU prefix sum, reduction and stream compaction over GPUVector / GPUDeque buffers.
+/// Programs are built by the client from Shaders/StreamCompaction/ (see StreamCompactionPrograms).
+/// CPU reference versions of each operation with identical semantics are at the bottom, for verification.
+
+#include <deque>
+#include <span>
+#include <vector>
+#include <numeric>
+
+#include "GL_Containers/GPUVector.h"
+#include "GL_Containers/GPUDeque.h"
+#include "GL_Containers/GPUPingPongVector.h"
+
+namespace glSugar
+{
+    /// must match local_size_x in Shaders/StreamCompaction
+    constexpr GLuint ScanBlockSize = 256;
+
+    struct StreamCompactionPrograms
+    {
+        gl::Program scanBlocks;     // ScanBlocks.glsl
+        gl::Program addBlockSums;   // ScanAddBlockSums.glsl
+        gl::Program reduce;         // Reduce.glsl
+        gl::Program compact;        // Compact.glsl
+    };
+
+    /// Temporary GPU storage for the scan passes.  Keep one around and reuse it to avoid reallocating every frame
+    struct ScanScratch
+    {
+        std::deque<gl::Buffer> blockSums;           // one per scan level.  A deque so growing it from a nested level doesn't move the outer levels' buffers
+        std::vector<std::size_t> blockSumCapacity;
+
+        gl::Buffer offsets;                         // scanned flags for compaction
+        std::size_t offsetsCapacity = 0;
+
+        gl::Buffer& levelBuffer(std::size_t level, std::size_t count)
+        {
+            if (level >= blockSums.size())
+            {
+                blockSums.resize(level + 1);
+                blockSumCapacity.resize(level + 1, 0u);
+            }
+
+            if (blockSumCapacity[level] < count)
+            {
+                blockSums[level] = gl::Buffer();
+                blockSums[level].Storage(count * sizeof(GLuint), nullptr, 0);
+                blockSumCapacity[level] = count;
+            }
+
+            return blockSums[level];
+        }
+
+        gl::Buffer& offsetBuffer(std::size_t count)
+        {
+            if (offsetsCapacity < count)
+            {
+                offsets = gl::Buffer();
+                offsets.Storage(count * sizeof(GLuint), nullptr, 0);
+                offsetsCapacity = count;
+            }
+
+            return offsets;
+        }
+    };
+
+    inline GLuint scanBlockCount(std::size_t count)
+    {
+        return GLuint((count + ScanBlockSize - 1) / ScanBlockSize);
+    }
+
+    /// index of v[0] in v.storage(), which is not 0 for vectors allocated from a GPUBufferHeap
+    template <bool Mapped>
+    GLuint storageElement(const GPUVector<GLuint, Mapped>& v)
+    {
+        return GLuint(v.StorageOffset() / sizeof(GLuint));
+    }
+
+    /// zero a single uint on the server
+    inline void clearUint(gl::Buffer& buffer, GLuint index)
+    {
+        glClearNamedBufferSubData(buffer.name(), GL_R32UI, index * sizeof(GLuint), sizeof(GLuint), GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+
+    /// - prefix sum of count uints from in (starting at element inOffset) to out (starting at element outOffset).  in and out may be the same buffer
+    /// - countNonZero sums (in[i] != 0) instead of in[i], eg. for the offsets of a compaction
+    inline void Scan(StreamCompactionPrograms& progs,
+        gl::Buffer& in, GLuint inOffset,
+        gl::Buffer& out, GLuint outOffset,
+        std::size_t count,
+        bool inclusive,
+        ScanScratch& scratch,
+        bool countNonZero = false,
+        std::size_t level = 0)
+    {
+        if (!count) return;
+
+        const GLuint blocks = scanBlockCount(count);
+
+        gl::Buffer& sums = scratch.levelBuffer(level, blocks);
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, in.name());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, out.name());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, sums.name());
+
+        progs.scanBlocks.Use();
+        progs.scanBlocks.Uniform1<GLuint>("count", GLuint(count));
+        progs.scanBlocks.Uniform1<GLuint>("inOffset", inOffset);
+        progs.scanBlocks.Uniform1<GLuint>("outOffset", outOffset);
+        progs.scanBlocks.Uniform1<GLint>("inclusive", inclusive ? 1 : 0);
+        progs.scanBlocks.Uniform1<GLint>("countNonZero", countNonZero ? 1 : 0);
+
+        glDispatchCompute(blocks, 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        if (blocks > 1)
+        {
+            // -- scan the block totals in place, then add them back to every block
+            Scan(progs, sums, 0u, sums, 0u, blocks, false, scratch, false, level + 1);
+
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, out.name());
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, sums.name());
+
+            progs.addBlockSums.Use();
+            progs.addBlockSums.Uniform1<GLuint>("count", GLuint(count));
+            progs.addBlockSums.Uniform1<GLuint>("outOffset", outOffset);
+
+            glDispatchCompute(blocks, 1, 1);
+            glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+        }
+    }
+
+    template <bool InMapped, bool OutMapped>
+    void ExclusiveScan(StreamCompactionPrograms& progs, GPUVector<GLuint, InMapped>& in, GPUVector<GLuint, OutMapped>& out, ScanScratch& scratch)
+    {
+        glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, "Exclusive Scan");
+        out.resize(in.Size());
+        Scan(progs, in.storage(), storageElement(in), out.storage(), storageElement(out), in.Size(), false, scratch);
+        glPopDebugGroup();
+    }
+
+    template <bool InMapped, bool OutMapped>
+    void InclusiveScan(StreamCompactionPrograms& progs, GPUVector<GLuint, InMapped>& in, GPUVector<GLuint, OutMapped>& out, ScanScratch& scratch)
+    {
+        glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, "Inclusive Scan");
+        out.resize(in.Size());
+        Scan(progs, in.storage(), storageElement(in), out.storage(), storageElement(out), in.Size(), true, scratch);
+        glPopDebugGroup();
+    }
+
+    /// - sum of count uints from in, written to result[resultIndex].  result may be any buffer, eg. a field of an indirect command
+    inline void Reduce(StreamCompactionPrograms& progs, gl::Buffer& in, GLuint inOffset, std::size_t count, gl::Buffer& result, GLuint resultIndex, bool accumulate = false)
+    {
+        if (!accumulate)
+        {
+            clearUint(result, resultIndex);
+        }
+
+        if (!count) return;
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, in.name());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, result.name());
+
+        progs.reduce.Use();
+        progs.reduce.Uniform1<GLuint>("count", GLuint(count));
+        progs.reduce.Uniform1<GLuint>("inOffset", inOffset);
+        progs.reduce.Uniform1<GLuint>("outOffset", resultIndex);
+
+        glDispatchCompute(scanBlockCount(count), 1, 1);
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    }
+
+    template <bool Mapped>
+    void Reduce(StreamCompactionPrograms& progs, GPUVector<GLuint, Mapped>& in, gl::Buffer& result, GLuint resultIndex)
+    {
+        glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, "Reduce");
+        Reduce(progs, in.storage(), storageElement(in), in.Size(), result, resultIndex);
+        glPopDebugGroup();
+    }
+
+    /// - one dispatch per page, all accumulating into result[resultIndex]
+    template <bool Mapped, std::size_t MinPageSize>
+    void Reduce(StreamCompactionPrograms& progs, GPUDeque<GLuint, Mapped, MinPageSize>& in, gl::Buffer& result, GLuint resultIndex)
+    {
+        glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, "Reduce Deque");
+
+        clearUint(result, resultIndex);
+
+        for (auto range : in.ranges())
+        {
+            Reduce(progs, range.buffer, GLuint(range.firstElement()), range.count, result, resultIndex, true);
+        }
+
+        glPopDebugGroup();
+    }
+
+    namespace detail
+    {
+        /// source bound to binding 0 by the caller
+        template <typename T>
+        void compactDispatch(StreamCompactionPrograms& progs, GLuint srcStart, std::size_t count, GLuint flagStart, std::size_t totalCount)
+        {
+            progs.compact.Uniform1<GLuint>("count", GLuint(count));
+            progs.compact.Uniform1<GLuint>("srcStart", srcStart);
+            progs.compact.Uniform1<GLuint>("flagStart", flagStart);
+            progs.compact.Uniform1<GLuint>("totalCount", GLuint(totalCount));
+            progs.compact.Uniform1<GLuint>("elementWords", GLuint(sizeof(T) / sizeof(GLuint)));
+
+            glDispatchCompute(scanBlockCount(count), 1, 1);
+        }
+
+        /// scan the flags and bind everything except the source.  dst holds count elements already
+        template <typename T, bool DstMapped>
+        void compactSetup(StreamCompactionPrograms& progs, GPUVector<GLuint, false>& flags, std::size_t count, const GPUVector<T, DstMapped>& dst, gl::Buffer& counter, GLuint counterIndex, ScanScratch& scratch)
+        {
+            static_assert(sizeof(T) % sizeof(GLuint) == 0, "compacted element size must be a multiple of 4 bytes");
+            assert(flags.Size() >= count);
+            assert(dst.Capacity() >= count);
+
+            gl::Buffer& offsets = scratch.offsetBuffer(count);
+
+            Scan(progs, flags.storage(), storageElement(flags), offsets, 0u, count, false, scratch, true);
+
+            // -- count == 0 never dispatches the thread that writes the counter
+            clearUint(counter, counterIndex);
+
+            dst.bind(GL_SHADER_STORAGE_BUFFER, 1);
+            flags.bind(GL_SHADER_STORAGE_BUFFER, 2);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, offsets.name());
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, counter.name());
+
+            progs.compact.Use();
+            progs.compact.Uniform1<GLuint>("counterIndex", counterIndex);
+        }
+    }
+
+    /// - copy the elements of src whose flag (one uint per element, written by a predicate pass) is non zero into dst, preserving order.
+    /// - the surviving count is written on the GPU to counter[counterIndex] : point it at the instanceCount of an indirect draw, or readAsync() it and resize() dst once it lands.
+    /// - dst is grown to hold src.Size() elements but its client side size is left alone
+    template <typename T, bool SrcMapped, bool DstMapped>
+    void Compact(StreamCompactionPrograms& progs, GPUVector<T, SrcMapped>& src, GPUVector<GLuint, false>& flags, GPUVector<T, DstMapped>& dst,
+        gl::Buffer& counter, GLuint counterIndex, ScanScratch& scratch)
+    {
+        glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, "Stream Compaction");
+
+        dst.reserve(src.Size());
+        detail::compactSetup(progs, flags, src.Size(), dst, counter, counterIndex, scratch);
+
+        if (src.Size())
+        {
+            src.bind(GL_SHADER_STORAGE_BUFFER, 0);
+            detail::compactDispatch<T>(progs, 0u, src.Size(), 0u, src.Size());
+        }
+
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+
+        glPopDebugGroup();
+    }
+
+    /// - as above, over every page of a deque.  flags is indexed by logical deque element
+    template <typename T, bool SrcMapped, std::size_t MinPageSize, bool DstMapped>
+    void Compact(StreamCompactionPrograms& progs, GPUDeque<T, SrcMapped, MinPageSize>& src, GPUVector<GLuint, false>& flags, GPUVector<T, DstMapped>& dst,
+        gl::Buffer& counter, GLuint counterIndex, ScanScratch& scratch)
+    {
+        glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, "Stream Compaction Deque");
+
+        const std::size_t total = src.Size();
+
+        dst.reserve(total);
+        detail::compactSetup(progs, flags, total, dst, counter, counterIndex, scratch);
+
+        std::size_t logical = 0;
+
+        for (auto range : src.ranges())
+        {
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, range.buffer.name());
+            detail::compactDispatch<T>(progs, GLuint(range.firstElement()), range.count, GLuint(logical), total);
+            logical += range.count;
+        }
+
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+
+        glPopDebugGroup();
+    }
+
+    /// - as above from v.front() into v.back(), the count going to v's back counter : a compaction step of a GPUPingPongVector.
+    ///   Call v.beginStep() first and v.swap() after, front then holds the survivors and Size() stays an upper bound of them
+    template <typename T>
+    void Compact(StreamCompactionPrograms& progs, GPUPingPongVector<T>& v, GPUVector<GLuint, false>& flags, ScanScratch& scratch)
+    {
+        glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, "Stream Compaction Ping Pong");
+
+        const std::size_t count = v.front().Size();
+
+        detail::compactSetup(progs, flags, count, v.back(), v.Counters(), v.BackCounterIndex(), scratch);
+
+        if (count)
+        {
+            v.front().bind(GL_SHADER_STORAGE_BUFFER, 0);
+            detail::compactDispatch<T>(progs, 0u, count, 0u, count);
+        }
+
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+
+        glPopDebugGroup();
+    }
+
+    /*** CPU reference implementations ***/
+
+    inline std::vector<GLuint> ExclusiveScanCPU(std::span<const GLuint> in)
+    {
+        std::vector<GLuint> rval(in.size());
+        std::exclusive_scan(in.begin(), in.end(), rval.begin(), GLuint(0));
+        return rval;
+    }
+
+    inline std::vector<GLuint> InclusiveScanCPU(std::span<const GLuint> in)
+    {
+        std::vector<GLuint> rval(in.size());
+        std::inclusive_scan(in.begin(), in.end(), rval.begin());
+        return rval;
+    }
+
+    inline GLuint ReduceCPU(std::span<const GLuint> in)
+    {
+        return std::accumulate(in.begin(), in.end(), GLuint(0));
+    }
+
+    template <typename T>
+    std::vector<T> CompactCPU(std::span<const T> in, std::span<const GLuint> flags)
+    {
+        assert(flags.size() >= in.size());
+
+        std::vector<T> rval;
+
+        for (std::size_t i = 0; i < in.size(); i++)
+        {
+            if (flags[i]) rval.push_back(in[i]);
+        }
+
+        return rval;
+    }
+}
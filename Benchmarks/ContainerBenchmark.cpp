@@ -0,0 +1,384 @@
+/// Micro benchmarks for the GPU containers, run against a headless EGL context (eg. Mesa llvmpipe on a CI box).
+///
+/// usage : GLSugarContainerBenchmark [--elements N] [--reps R] [--container name] [--software] [--out results.json]
+///
+/// Every workload is templated over the GPUContainer concept.  Each reports ops/sec, bytes moved and the number of driver calls it made as JSON.
+
+#include <glad/gl.h>
+#include <glhpp/OpenGL.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "GL_Containers/GPUContainers.h"
+#include "Benchmarks/GLCallCounter.h"
+#include "Benchmarks/HeadlessContext.h"
+
+namespace glSugar::bench
+{
+    struct Particle
+    {
+        float position[4];
+        float velocity[4];
+    };
+
+    inline Particle makeParticle(std::size_t i)
+    {
+        const float f = float(i);
+        return { { f, f, f, 1.0f }, { 0.0f, -1.0f, 0.0f, 0.0f } };
+    }
+
+    struct Options
+    {
+        std::size_t elements = 1u << 16;
+        std::size_t reps = 5u;
+        bool software = false;
+        std::string container;  // only run containers whose name contains this
+        std::string out;        // write the json here instead of stdout
+    };
+
+    /// what one timed run of a workload did
+    struct Sample
+    {
+        std::size_t ops = 0;
+        std::size_t bytes = 0;
+    };
+
+    struct Result
+    {
+        std::string container;
+        std::string workload;
+        Sample sample;
+        double seconds = 0.0;    // median over the reps
+        std::size_t driverCalls = 0;
+        std::vector<GLCallCounter::Count> entryPoints;
+    };
+
+    struct Benchmark
+    {
+        Options options;
+        GLCallCounter counter;
+        std::vector<Result> results;
+
+        /// - prepare(c) sets up untimed, work(c) is timed up to a glFinish and returns what it did
+        template <typename Make, typename Prepare, typename Work>
+        void measure(const std::string& container, const char* workload, Make&& make, Prepare&& prepare, Work&& work)
+        {
+            Result r;
+            r.container = container;
+            r.workload = workload;
+
+            std::vector<double> times;
+
+            for (std::size_t rep = 0; rep < options.reps; rep++)
+            {
+                auto c = make();
+                prepare(*c);
+                glFinish();
+
+                counter.reset();
+
+                auto t0 = std::chrono::steady_clock::now();
+                r.sample = work(*c);
+                glFinish();
+                auto t1 = std::chrono::steady_clock::now();
+
+                times.push_back(std::chrono::duration<double>(t1 - t0).count());
+
+                // -- deterministic, so every rep makes the same calls
+                r.driverCalls = counter.total();
+                r.entryPoints = counter.counts();
+            }
+
+            std::sort(times.begin(), times.end());
+            r.seconds = times[times.size() / 2];
+
+            results.push_back(std::move(r));
+        }
+
+        /// - every workload over container type C.  Mapped containers are read through operator[] instead of GetSubData
+        template <GPUContainer C, bool Mapped, typename Make>
+        void run(const std::string& name, Make&& make)
+        {
+            if (!options.container.empty() && name.find(options.container) == std::string::npos)
+            {
+                return;
+            }
+
+            using T = typename C::value_type;
+
+            const std::size_t n = options.elements;
+            const std::size_t removals = n / 2;
+
+            constexpr bool contiguous = requires(C& c) { c.storage(); };
+
+            auto nothing = [](C&) {};
+
+            auto fill = [n](C& c)
+            {
+                c.reserve(n);
+
+                for (std::size_t i = 0; i < n; i++)
+                {
+                    c.push_back(makeParticle(i));
+                }
+            };
+
+            measure(name, "push_back", make, [n](C& c) { c.reserve(n); }, [n](C& c)
+            {
+                for (std::size_t i = 0; i < n; i++)
+                {
+                    c.push_back(makeParticle(i));
+                }
+
+                return Sample{ n, n * sizeof(T) };
+            });
+
+            measure(name, "growth", make, nothing, [n, contiguous](C& c)
+            {
+                Sample s = { n, n * sizeof(T) };
+
+                for (std::size_t i = 0; i < n; i++)
+                {
+                    const std::size_t cap = c.Capacity();
+
+                    c.push_back(makeParticle(i));
+
+                    // -- a contiguous container copies its contents when it reallocates
+                    if (contiguous && c.Capacity() != cap)
+                    {
+                        s.bytes += i * sizeof(T);
+                    }
+                }
+
+                return s;
+            });
+
+            measure(name, "reserve", make, [n](C& c)
+            {
+                for (std::size_t i = 0; i < n / 2; i++)
+                {
+                    c.push_back(makeParticle(i));
+                }
+            },
+            [n, contiguous](C& c)
+            {
+                const std::size_t bytes = contiguous ? c.SizeBytes() : 0u;
+                c.reserve(2 * n);
+                return Sample{ 1u, bytes };
+            });
+
+            // -- same pseudo random removal sequence for every container
+            std::mt19937 rng(1234u);
+            std::vector<std::size_t> sequential(removals);
+            std::vector<std::size_t> distinct(n);
+
+            for (std::size_t k = 0; k < removals; k++)
+            {
+                sequential[k] = std::uniform_int_distribution<std::size_t>(0u, n - k - 1)(rng);
+            }
+
+            for (std::size_t i = 0; i < n; i++)
+            {
+                distinct[i] = i;
+            }
+
+            std::shuffle(distinct.begin(), distinct.end(), rng);
+            distinct.resize(removals);
+
+            measure(name, "removeUnordered", make, fill, [&](C& c)
+            {
+                for (std::size_t index : sequential)
+                {
+                    c.removeUnordered(index);
+                }
+
+                return Sample{ removals, removals * sizeof(T) };
+            });
+
+            if constexpr (requires(C& c, std::span<const std::size_t> s) { c.removeUnordered(s); })
+            {
+                measure(name, "removeUnordered_batch", make, fill, [&](C& c)
+                {
+                    c.removeUnordered(std::span<const std::size_t>(distinct));
+                    return Sample{ removals, removals * sizeof(T) };
+                });
+            }
+
+            if constexpr (requires(C& c) { c.readAsync(0u, 0u); })
+            {
+                measure(name, "readAsync", make, fill, [n](C& c)
+                {
+                    auto readback = c.readAsync(0u, n);
+                    volatile float sink = readback.data()[n - 1].position[0];
+                    (void)sink;
+                    return Sample{ n, n * sizeof(T) };
+                });
+            }
+
+            if constexpr (requires(C& c, std::vector<T>& v) { c.copyTo(v); })
+            {
+                measure(name, "copyTo", make, fill, [n](C& c)
+                {
+                    std::vector<T> out;
+                    c.copyTo(out);
+                    return Sample{ n, n * sizeof(T) };
+                });
+            }
+
+            // -- client side pass over every element.  Non mapped containers have to read the data back first
+            measure(name, "iterate", make, fill, [n](C& c)
+            {
+                float sum = 0.0f;
+
+                if constexpr (Mapped)
+                {
+                    const C& cc = c;
+
+                    for (std::size_t i = 0; i < n; i++)
+                    {
+                        sum += cc[i].position[0];
+                    }
+                }
+                else
+                {
+                    std::vector<T> out;
+                    c.copyTo(out);
+
+                    for (const T& t : out)
+                    {
+                        sum += t.position[0];
+                    }
+                }
+
+                volatile float sink = sum;
+                (void)sink;
+
+                return Sample{ n, n * sizeof(T) };
+            });
+        }
+
+        void writeJson(std::ostream& os, const std::string& renderer, const std::string& version) const
+        {
+            os << "{\n";
+            os << "  \"renderer\": \"" << renderer << "\",\n";
+            os << "  \"version\": \"" << version << "\",\n";
+            os << "  \"elements\": " << options.elements << ",\n";
+            os << "  \"reps\": " << options.reps << ",\n";
+            os << "  \"element_bytes\": " << sizeof(Particle) << ",\n";
+            os << "  \"results\": [\n";
+
+            for (std::size_t i = 0; i < results.size(); i++)
+            {
+                const Result& r = results[i];
+                const double seconds = std::max(r.seconds, 1e-9);
+
+                os << "    {\n";
+                os << "      \"container\": \"" << r.container << "\",\n";
+                os << "      \"workload\": \"" << r.workload << "\",\n";
+                os << "      \"ops\": " << r.sample.ops << ",\n";
+                os << "      \"seconds\": " << r.seconds << ",\n";
+                os << "      \"ops_per_sec\": " << r.sample.ops / seconds << ",\n";
+                os << "      \"bytes\": " << r.sample.bytes << ",\n";
+                os << "      \"bytes_per_sec\": " << r.sample.bytes / seconds << ",\n";
+                os << "      \"driver_calls\": " << r.driverCalls << ",\n";
+                os << "      \"driver_calls_per_op\": " << double(r.driverCalls) / std::max<std::size_t>(r.sample.ops, 1u) << ",\n";
+                os << "      \"entry_points\": {";
+
+                for (std::size_t e = 0; e < r.entryPoints.size(); e++)
+                {
+                    os << (e ? ", " : " ") << "\"" << r.entryPoints[e].name << "\": " << r.entryPoints[e].calls;
+                }
+
+                os << (r.entryPoints.empty() ? "}\n" : " }\n");
+                os << "    }" << (i + 1 < results.size() ? "," : "") << "\n";
+            }
+
+            os << "  ]\n";
+            os << "}\n";
+        }
+    };
+
+    inline bool parseArgs(int argc, char** argv, Options& options)
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            const std::string arg = argv[i];
+            const bool hasValue = i + 1 < argc;
+
+            if (arg == "--elements" && hasValue) options.elements = std::max<std::size_t>(std::strtoull(argv[++i], nullptr, 10), 2u);
+            else if (arg == "--reps" && hasValue) options.reps = std::max<std::size_t>(std::strtoull(argv[++i], nullptr, 10), 1u);
+            else if (arg == "--container" && hasValue) options.container = argv[++i];
+            else if (arg == "--out" && hasValue) options.out = argv[++i];
+            else if (arg == "--software") options.software = true;
+            else
+            {
+                std::cerr << "usage : " << argv[0] << " [--elements N] [--reps R] [--container name] [--software] [--out results.json]\n";
+                return false;
+            }
+        }
+
+        return true;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    using namespace glSugar::bench;
+
+    Benchmark bench;
+
+    if (!parseArgs(argc, argv, bench.options))
+    {
+        return 1;
+    }
+
+    HeadlessContext context;
+
+    if (!context.create(bench.options.software))
+    {
+        return 1;
+    }
+
+    const std::string renderer = (const char*)glGetString(GL_RENDERER);
+    const std::string version = (const char*)glGetString(GL_VERSION);
+
+    bench.counter.install();
+
+    bench.run<GPUVector<Particle>, false>("GPUVector", [] { return std::make_unique<GPUVector<Particle>>(); });
+
+    bench.run<GPUSharedVector<Particle>, true>("GPUSharedVector", [] { return std::make_unique<GPUSharedVector<Particle>>(); });
+
+    bench.run<GPUMirroredVector<Particle>, true>("GPUMirroredVector", [] { return std::make_unique<GPUMirroredVector<Particle>>(); });
+
+    bench.run<GPUDeque<Particle>, false>("GPUDeque", [] { return std::make_unique<GPUDeque<Particle>>(); });
+
+    bench.run<GPUDeque<Particle, true>, true>("GPUDeque.mapped", []
+    {
+        auto d = std::make_unique<GPUDeque<Particle, true>>();
+        d->map();
+        return d;
+    });
+
+    if (bench.options.out.empty())
+    {
+        bench.writeJson(std::cout, renderer, version);
+    }
+    else
+    {
+        std::ofstream file(bench.options.out);
+        bench.writeJson(file, renderer, version);
+    }
+
+    return 0;
+}
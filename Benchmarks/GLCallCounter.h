@@ -0,0 +1,138 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+/// - counts calls into the driver by swapping glad's function pointers for counting trampolines.
+/// - call install() once after gladLoadGL.  Only the entry points listed below are counted; they cover everything the containers use.
+namespace glSugar::bench
+{
+    template <auto* Slot, typename Fn = std::remove_reference_t<decltype(*Slot)>>
+    struct CountedEntryPoint;
+
+    template <auto* Slot, typename R, typename... Args>
+    struct CountedEntryPoint<Slot, R(GLAD_API_PTR*)(Args...)>
+    {
+        static inline R(GLAD_API_PTR* original)(Args...) = nullptr;
+        static inline std::size_t calls = 0;
+
+        static R GLAD_API_PTR call(Args... args)
+        {
+            calls++;
+            return original(args...);
+        }
+
+        static void install()
+        {
+            // -- entry points the driver doesn't expose stay null
+            if (*Slot && *Slot != &call)
+            {
+                original = *Slot;
+                *Slot = &call;
+            }
+        }
+    };
+
+    struct GLCallCounter
+    {
+        struct Entry
+        {
+            const char* name;
+            std::size_t* calls;
+            void (*install)();
+        };
+
+        /// - name / call count pair, for reports
+        struct Count
+        {
+            std::string name;
+            std::size_t calls;
+        };
+
+        GLCallCounter()
+        {
+#define GLSUGAR_COUNT_ENTRY_POINT(fn) entries.push_back({ #fn, &CountedEntryPoint<&glad_##fn>::calls, &CountedEntryPoint<&glad_##fn>::install });
+            GLSUGAR_COUNT_ENTRY_POINT(glCreateBuffers)
+            GLSUGAR_COUNT_ENTRY_POINT(glGenBuffers)
+            GLSUGAR_COUNT_ENTRY_POINT(glDeleteBuffers)
+            GLSUGAR_COUNT_ENTRY_POINT(glBindBuffer)
+            GLSUGAR_COUNT_ENTRY_POINT(glBindBufferBase)
+            GLSUGAR_COUNT_ENTRY_POINT(glBindBufferRange)
+            GLSUGAR_COUNT_ENTRY_POINT(glBufferStorage)
+            GLSUGAR_COUNT_ENTRY_POINT(glNamedBufferStorage)
+            GLSUGAR_COUNT_ENTRY_POINT(glBufferData)
+            GLSUGAR_COUNT_ENTRY_POINT(glNamedBufferData)
+            GLSUGAR_COUNT_ENTRY_POINT(glBufferSubData)
+            GLSUGAR_COUNT_ENTRY_POINT(glNamedBufferSubData)
+            GLSUGAR_COUNT_ENTRY_POINT(glGetBufferSubData)
+            GLSUGAR_COUNT_ENTRY_POINT(glGetNamedBufferSubData)
+            GLSUGAR_COUNT_ENTRY_POINT(glCopyBufferSubData)
+            GLSUGAR_COUNT_ENTRY_POINT(glCopyNamedBufferSubData)
+            GLSUGAR_COUNT_ENTRY_POINT(glClearNamedBufferSubData)
+            GLSUGAR_COUNT_ENTRY_POINT(glMapBufferRange)
+            GLSUGAR_COUNT_ENTRY_POINT(glMapNamedBufferRange)
+            GLSUGAR_COUNT_ENTRY_POINT(glUnmapBuffer)
+            GLSUGAR_COUNT_ENTRY_POINT(glUnmapNamedBuffer)
+            GLSUGAR_COUNT_ENTRY_POINT(glFlushMappedBufferRange)
+            GLSUGAR_COUNT_ENTRY_POINT(glFlushMappedNamedBufferRange)
+            GLSUGAR_COUNT_ENTRY_POINT(glFenceSync)
+            GLSUGAR_COUNT_ENTRY_POINT(glClientWaitSync)
+            GLSUGAR_COUNT_ENTRY_POINT(glDeleteSync)
+            GLSUGAR_COUNT_ENTRY_POINT(glMemoryBarrier)
+            GLSUGAR_COUNT_ENTRY_POINT(glDispatchCompute)
+            GLSUGAR_COUNT_ENTRY_POINT(glMultiDrawArraysIndirect)
+            GLSUGAR_COUNT_ENTRY_POINT(glMultiDrawElementsIndirect)
+#undef GLSUGAR_COUNT_ENTRY_POINT
+        }
+
+        void install()
+        {
+            for (Entry& e : entries)
+            {
+                e.install();
+            }
+        }
+
+        std::size_t total() const
+        {
+            std::size_t rval = 0;
+
+            for (const Entry& e : entries)
+            {
+                rval += *e.calls;
+            }
+
+            return rval;
+        }
+
+        /// - per entry point counts, skipping entry points that were never called
+        std::vector<Count> counts() const
+        {
+            std::vector<Count> rval;
+
+            for (const Entry& e : entries)
+            {
+                if (*e.calls)
+                {
+                    rval.push_back({ e.name, *e.calls });
+                }
+            }
+
+            return rval;
+        }
+
+        void reset()
+        {
+            for (Entry& e : entries)
+            {
+                *e.calls = 0;
+            }
+        }
+
+    private:
+
+        std::vector<Entry> entries;
+    };
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include <cstdlib>
+#include <iostream>
+
+/// - headless GL context shared by the benchmarks and the tests (Tests/TestHarness.h)
+namespace glSugar::bench
+{
+    /// - GL 4.5 core context with no surface.  --software forces llvmpipe
+    struct HeadlessContext
+    {
+        EGLDisplay display = EGL_NO_DISPLAY;
+        EGLContext context = EGL_NO_CONTEXT;
+
+        bool create(bool software)
+        {
+            if (software)
+            {
+#if defined(_WIN32)
+                _putenv_s("LIBGL_ALWAYS_SOFTWARE", "1");
+#else
+                setenv("LIBGL_ALWAYS_SOFTWARE", "1", 1);
+#endif
+            }
+
+            // -- prefer Mesa's surfaceless platform, so no X / wayland server is needed
+            auto getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+
+            if (getPlatformDisplay)
+            {
+                display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+            }
+
+            if (display == EGL_NO_DISPLAY)
+            {
+                display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+            }
+
+            EGLint major = 0, minor = 0;
+
+            if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+            {
+                std::cerr << "GLSugar : could not initialize EGL\n";
+                return false;
+            }
+
+            eglBindAPI(EGL_OPENGL_API);
+
+            const EGLint contextAttribs[] =
+            {
+                EGL_CONTEXT_MAJOR_VERSION, 4,
+                EGL_CONTEXT_MINOR_VERSION, 5,
+                EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+                EGL_NONE
+            };
+
+            // -- EGL_KHR_no_config_context + EGL_KHR_surfaceless_context
+            context = eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, contextAttribs);
+
+            if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+            {
+                std::cerr << "GLSugar : could not create a surfaceless GL 4.5 context\n";
+                return false;
+            }
+
+            if (!gladLoadGL((GLADloadfunc)eglGetProcAddress))
+            {
+                std::cerr << "GLSugar : could not load GL\n";
+                return false;
+            }
+
+            return true;
+        }
+
+        ~HeadlessContext()
+        {
+            if (display != EGL_NO_DISPLAY)
+            {
+                eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+
+                if (context != EGL_NO_CONTEXT)
+                {
+                    eglDestroyContext(display, context);
+                }
+
+                eglTerminate(display);
+            }
+        }
+    };
+}
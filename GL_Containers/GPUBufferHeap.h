@@ -0,0 +1,587 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <numeric>
+#include <set>
+#include <vector>
+
+#include "GPUTelemetry.h"
+#include "GPUUploadManager.h"
+
+/// - buddy allocator that sub-allocates ranges out of a few large immutable buffers ("blocks"), so many containers share one gl::Buffer.
+/// - containers hold a GPUHeapRange and look up (buffer, offset) through it every time, which lets defragment() move their data around.
+/// - every allocation is a power of two multiple of minAllocation and aligned to its own size, so offsets are valid for glBindBufferRange as long as
+///   minAllocation is a multiple of GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT / GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT (256 covers every implementation I know of)
+/// - pinned allocations never move, for users that keep raw offsets (eg. GPUPagePool arenas).  A block holding one is never evacuated
+/// - elementBytes makes offset() a multiple of lcm(elementBytes, minAllocation), for users that index the block in elements (offset / sizeof(T), eg.
+///   baseInstance or a shader's start element).  Sizes that aren't a power of two (12, 48) pay up to that lcm - minAllocation bytes of padding
+struct GPUBufferHeap
+{
+    using Handle = std::uint32_t;
+
+    constexpr static Handle InvalidHandle = ~Handle(0);
+
+    const static inline std::size_t DefaultBlockBytes = 16u << 20;
+    const static inline std::size_t DefaultMinAllocation = 256u;
+
+    const std::size_t blockBytes;
+    const GLenum usage;
+    const std::size_t minAllocation;
+
+    /// - blockBytes and minAllocation must be powers of two.  Allocations bigger than blockBytes get a block of their own
+    GPUBufferHeap(std::size_t blockBytesIn = DefaultBlockBytes, GLenum usageIn = GL_DYNAMIC_STORAGE_BIT, std::size_t minAllocationIn = DefaultMinAllocation) :
+        blockBytes(blockBytesIn),
+        usage(usageIn),
+        minAllocation(minAllocationIn)
+    {
+        assert(isPow2(blockBytes) && isPow2(minAllocation) && minAllocation <= blockBytes);
+    }
+
+    GPUBufferHeap(const GPUBufferHeap&) = delete;
+    GPUBufferHeap& operator=(const GPUBufferHeap&) = delete;
+
+    /// - contents are undefined
+    Handle allocate(std::size_t bytes, bool pinned = false, std::size_t elementBytes = 1u)
+    {
+        const std::size_t alignment = std::lcm(elementBytes, minAllocation);
+        const unsigned order = orderFor(bytes + alignment - minAllocation);
+
+        Location loc;
+
+        if (!findFree(order, loc, blocks.size()))
+        {
+            loc = { addBlock(order), 0u };
+            loc.offset = takeFree(loc.block, order);
+        }
+
+        Handle h;
+
+        if (freeHandles.empty())
+        {
+            h = Handle(entries.size());
+            entries.emplace_back();
+        }
+        else
+        {
+            h = freeHandles.back();
+            freeHandles.pop_back();
+        }
+
+        entries[h] = { loc.block, loc.offset, bytes, alignment, order, pinned, true };
+        blocks[loc.block].usedBytes += orderBytes(order);
+
+        return h;
+    }
+
+    void free(Handle h)
+    {
+        Entry& e = entry(h);
+
+        blocks[e.block].usedBytes -= orderBytes(e.order);
+        giveFree(e.block, e.offset, e.order);
+
+        e.live = false;
+        freeHandles.push_back(h);
+    }
+
+    /// - grow or shrink h to bytes, keeping the first copyBytes of its contents.  The handle stays the same but the data may move
+    void reallocate(Handle h, std::size_t bytes, std::size_t copyBytes)
+    {
+        Entry& e = entry(h);
+
+        assert(copyBytes <= std::min(bytes, e.size));
+
+        const unsigned order = orderFor(bytes + e.alignment - minAllocation);
+
+        if (order == e.order)
+        {
+            e.size = bytes;
+            return;
+        }
+
+        const Handle temp = allocate(bytes, e.pinned, e.alignment);
+
+        // -- allocate may have grown entries
+        Entry& from = entries[h];
+        Entry& to = entries[temp];
+
+        if (copyBytes)
+        {
+            blockBuffer(from.block).CopySubData(blockBuffer(to.block), alignedOffset(from), alignedOffset(to), copyBytes);
+            stats.copy(copyBytes);
+        }
+
+        std::swap(from.block, to.block);
+        std::swap(from.offset, to.offset);
+        std::swap(from.order, to.order);
+        std::swap(from.size, to.size);
+
+        free(temp);
+    }
+
+    gl::Buffer& buffer(Handle h)
+    {
+        return blockBuffer(entry(h).block);
+    }
+
+    /// - a multiple of the lcm of minAllocation and the elementBytes h was allocated with
+    std::size_t offset(Handle h) const
+    {
+        return alignedOffset(entry(h));
+    }
+
+    std::size_t size(Handle h) const
+    {
+        return entry(h).size;
+    }
+
+    /// - the uploader the containers allocating from the heap write through (see GPUVector::setUploader), nullptr if they use SubData.
+    ///   Its copies are recorded against (buffer, offset) pairs that defragment() and trim() invalidate, so those submit it first
+    void setUploader(GPUUploadManager* uploaderIn)
+    {
+        submitUploads();
+        uploader = uploaderIn;
+    }
+
+    GPUUploadManager* Uploader() const
+    {
+        return uploader;
+    }
+
+    /// - move allocations out of the emptiest blocks into the free space of the others, and delete blocks that end up empty.  Returns the bytes copied
+    /// - only GPU side copies, so it's cheap to call eg. once every few seconds.  Contents of every live allocation are preserved
+    std::size_t defragment()
+    {
+        // -- pending uploads still aim at the current locations
+        submitUploads();
+
+        std::size_t bytesMoved = 0;
+
+        for (bool progress = true; progress;)
+        {
+            progress = false;
+
+            std::vector<std::size_t> candidates;
+
+            for (std::size_t b = 0; b < blocks.size(); b++)
+            {
+                if (blocks[b].buffer) candidates.push_back(b);
+            }
+
+            std::stable_sort(candidates.begin(), candidates.end(), [this](std::size_t a, std::size_t b) { return blocks[a].usedBytes < blocks[b].usedBytes; });
+
+            for (std::size_t b : candidates)
+            {
+                if (blocks[b].usedBytes == 0)
+                {
+                    removeBlock(b);
+                    progress = true;
+                    break;
+                }
+
+                std::size_t moved = 0;
+
+                if (evacuate(b, moved))
+                {
+                    bytesMoved += moved;
+                    removeBlock(b);
+                    progress = true;
+                    break;
+                }
+            }
+        }
+
+        return bytesMoved;
+    }
+
+    /// - delete blocks with no live allocations
+    void trim()
+    {
+        submitUploads();
+
+        for (std::size_t b = 0; b < blocks.size(); b++)
+        {
+            if (blocks[b].buffer && blocks[b].usedBytes == 0)
+            {
+                removeBlock(b);
+            }
+        }
+    }
+
+    std::size_t BlockCount() const
+    {
+        return std::count_if(blocks.begin(), blocks.end(), [](const Block& b) { return b.buffer != nullptr; });
+    }
+
+    std::size_t AllocationCount() const
+    {
+        return entries.size() - freeHandles.size();
+    }
+
+    /// - bytes handed out, including the rounding up to powers of two
+    std::size_t UsedBytes() const
+    {
+        std::size_t rval = 0;
+
+        for (const Block& b : blocks)
+        {
+            rval += b.usedBytes;
+        }
+
+        return rval;
+    }
+
+    std::size_t CapacityBytes() const
+    {
+        std::size_t rval = 0;
+
+        for (const Block& b : blocks)
+        {
+            if (b.buffer) rval += orderBytes(b.order);
+        }
+
+        return rval;
+    }
+
+    /// - blocks are counted as device bytes, the containers allocating from the heap count their own capacity.  See GPUTelemetry.h
+    GPUStats& Stats()
+    {
+        return stats;
+    }
+
+    const GPUStats& Stats() const
+    {
+        return stats;
+    }
+
+private:
+
+    struct Entry
+    {
+        std::size_t block = 0;
+        std::size_t offset = 0;         // of the buddy range, the data starts at alignedOffset()
+        std::size_t size = 0;
+        std::size_t alignment = 0;
+        unsigned order = 0;
+        bool pinned = false;
+        bool live = false;
+    };
+
+    struct Block
+    {
+        std::unique_ptr<gl::Buffer> buffer;             // heap allocated so references handed out survive blocks growing
+        unsigned order = 0;                             // the whole block is one allocation of this order
+        std::vector<std::set<std::size_t>> freeLists;   // free offsets per order
+        std::size_t usedBytes = 0;
+    };
+
+    struct Location
+    {
+        std::size_t block;
+        std::size_t offset;
+    };
+
+    std::vector<Block> blocks;              // removed blocks stay as empty entries so block indices are stable
+    std::vector<Entry> entries;
+    std::vector<Handle> freeHandles;
+
+    GPUUploadManager* uploader = nullptr;
+
+    GLSUGAR_NO_UNIQUE_ADDRESS GPUStats stats;
+
+    void submitUploads()
+    {
+        if (uploader && uploader->PendingCount())
+        {
+            uploader->submit();
+        }
+    }
+
+    static bool isPow2(std::size_t x)
+    {
+        return x && !(x & (x - 1));
+    }
+
+    std::size_t orderBytes(unsigned order) const
+    {
+        return minAllocation << order;
+    }
+
+    unsigned orderFor(std::size_t bytes) const
+    {
+        unsigned order = 0;
+
+        while (orderBytes(order) < bytes)
+        {
+            order++;
+        }
+
+        return order;
+    }
+
+    /// - first multiple of e.alignment in its range.  The range is a multiple of minAllocation, so this adds at most alignment - minAllocation
+    static std::size_t alignedOffset(const Entry& e)
+    {
+        return (e.offset + e.alignment - 1) / e.alignment * e.alignment;
+    }
+
+    Entry& entry(Handle h)
+    {
+        assert(h < entries.size() && entries[h].live);
+        return entries[h];
+    }
+
+    const Entry& entry(Handle h) const
+    {
+        assert(h < entries.size() && entries[h].live);
+        return entries[h];
+    }
+
+    gl::Buffer& blockBuffer(std::size_t b)
+    {
+        return *blocks[b].buffer;
+    }
+
+    /// - lowest block (other than exclude) with a free range of at least order
+    bool findFree(unsigned order, Location& loc, std::size_t exclude)
+    {
+        for (std::size_t b = 0; b < blocks.size(); b++)
+        {
+            if (b == exclude || !blocks[b].buffer || blocks[b].order < order) continue;
+
+            for (unsigned o = order; o <= blocks[b].order; o++)
+            {
+                if (!blocks[b].freeLists[o].empty())
+                {
+                    loc = { b, takeFree(b, order) };
+                    return true;
+                }
+            }
+        }
+
+        return false;
+    }
+
+    /// - take the lowest free range of order from block b, splitting a bigger one if needed.  Caller checked there is one
+    std::size_t takeFree(std::size_t b, unsigned order)
+    {
+        Block& block = blocks[b];
+
+        unsigned o = order;
+
+        while (block.freeLists[o].empty())
+        {
+            o++;
+            assert(o <= block.order);
+        }
+
+        std::size_t offset = *block.freeLists[o].begin();
+        block.freeLists[o].erase(block.freeLists[o].begin());
+
+        // -- split, keeping the low half and freeing the high half at each level
+        while (o > order)
+        {
+            o--;
+            block.freeLists[o].insert(offset + orderBytes(o));
+        }
+
+        return offset;
+    }
+
+    void giveFree(std::size_t b, std::size_t offset, unsigned order)
+    {
+        Block& block = blocks[b];
+
+        // -- merge with the buddy for as long as it's free too
+        while (order < block.order)
+        {
+            const std::size_t buddy = offset ^ orderBytes(order);
+            auto it = block.freeLists[order].find(buddy);
+
+            if (it == block.freeLists[order].end()) break;
+
+            block.freeLists[order].erase(it);
+            offset = std::min(offset, buddy);
+            order++;
+        }
+
+        block.freeLists[order].insert(offset);
+    }
+
+    std::size_t addBlock(unsigned minOrder)
+    {
+        auto it = std::find_if(blocks.begin(), blocks.end(), [](const Block& b) { return b.buffer == nullptr; });
+
+        if (it == blocks.end())
+        {
+            it = blocks.insert(blocks.end(), Block());
+        }
+
+        it->order = std::max(orderFor(blockBytes), minOrder);
+        it->buffer = std::make_unique<gl::Buffer>();
+        it->buffer->Storage(orderBytes(it->order), nullptr, usage);
+
+        stats.allocation();
+        stats.setDeviceBytes(CapacityBytes());
+        it->freeLists.assign(it->order + 1, {});
+        it->freeLists[it->order].insert(0u);
+        it->usedBytes = 0;
+
+        return it - blocks.begin();
+    }
+
+    void removeBlock(std::size_t b)
+    {
+        assert(blocks[b].usedBytes == 0);
+        blocks[b] = Block();
+
+        stats.setDeviceBytes(CapacityBytes());
+    }
+
+    /// - move every allocation of block b into the other blocks, all or nothing
+    bool evacuate(std::size_t b, std::size_t& bytesMoved)
+    {
+        std::vector<Handle> live;
+
+        for (Handle h = 0; h < entries.size(); h++)
+        {
+            if (entries[h].live && entries[h].block == b)
+            {
+                if (entries[h].pinned) return false;
+                live.push_back(h);
+            }
+        }
+
+        // -- biggest first packs best
+        std::sort(live.begin(), live.end(), [this](Handle x, Handle y) { return entries[x].order > entries[y].order; });
+
+        std::vector<Location> targets;
+
+        for (Handle h : live)
+        {
+            Location loc;
+
+            if (!findFree(entries[h].order, loc, b))
+            {
+                // -- roll back
+                for (std::size_t i = 0; i < targets.size(); i++)
+                {
+                    giveFree(targets[i].block, targets[i].offset, entries[live[i]].order);
+                }
+
+                return false;
+            }
+
+            targets.push_back(loc);
+        }
+
+        for (std::size_t i = 0; i < live.size(); i++)
+        {
+            Entry& e = entries[live[i]];
+            const std::size_t bytes = orderBytes(e.order);
+
+            const std::size_t from = alignedOffset(e);
+
+            e.block = targets[i].block;
+            e.offset = targets[i].offset;
+
+            blockBuffer(b).CopySubData(blockBuffer(e.block), from, alignedOffset(e), e.size);
+            stats.copy(e.size);
+            bytesMoved += e.size;
+
+            blocks[b].usedBytes -= bytes;
+            blocks[e.block].usedBytes += bytes;
+        }
+
+        return true;
+    }
+};
+
+/// - owning handle to one allocation of a GPUBufferHeap.  Move only, frees the allocation when destroyed
+struct GPUHeapRange
+{
+    GPUHeapRange() = default;
+
+    /// - elementBytes : see GPUBufferHeap::allocate, pass sizeof(T) when offset() gets divided by it
+    GPUHeapRange(std::shared_ptr<GPUBufferHeap> heapIn, std::size_t bytes, bool pinned = false, std::size_t elementBytes = 1u) :
+        heap(std::move(heapIn)),
+        handle(heap->allocate(bytes, pinned, elementBytes))
+    {
+    }
+
+    GPUHeapRange(const GPUHeapRange&) = delete;
+    GPUHeapRange& operator=(const GPUHeapRange&) = delete;
+
+    GPUHeapRange(GPUHeapRange&& other) : heap(std::move(other.heap)), handle(other.handle)
+    {
+        other.handle = GPUBufferHeap::InvalidHandle;
+    }
+
+    GPUHeapRange& operator=(GPUHeapRange&& other)
+    {
+        if (this != &other)
+        {
+            reset();
+            heap = std::move(other.heap);
+            handle = other.handle;
+            other.handle = GPUBufferHeap::InvalidHandle;
+        }
+
+        return *this;
+    }
+
+    ~GPUHeapRange()
+    {
+        reset();
+    }
+
+    void reset()
+    {
+        if (heap && handle != GPUBufferHeap::InvalidHandle)
+        {
+            heap->free(handle);
+        }
+
+        heap = nullptr;
+        handle = GPUBufferHeap::InvalidHandle;
+    }
+
+    explicit operator bool() const
+    {
+        return heap != nullptr;
+    }
+
+    /// - buffer and offset may change after reallocate() or GPUBufferHeap::defragment(), so look them up at every use
+    gl::Buffer& buffer() const
+    {
+        return heap->buffer(handle);
+    }
+
+    std::size_t offset() const
+    {
+        return heap->offset(handle);
+    }
+
+    std::size_t size() const
+    {
+        return heap->size(handle);
+    }
+
+    void reallocate(std::size_t bytes, std::size_t copyBytes)
+    {
+        heap->reallocate(handle, bytes, copyBytes);
+    }
+
+    GPUBufferHeap& Heap() const
+    {
+        return *heap;
+    }
+
+private:
+
+    std::shared_ptr<GPUBufferHeap> heap;
+    GPUBufferHeap::Handle handle = GPUBufferHeap::InvalidHandle;
+};
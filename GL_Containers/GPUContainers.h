@@ -1,6 +1,17 @@
 #pragma once
 
 #include "GPUContainer.h"
+#include "GPUTelemetry.h"
+#include "GPUBufferHeap.h"
+#include "GPUReadback.h"
+#include "GPUUploadManager.h"
 #include "GPUVector.h"
 #include "GPUSharedVector.h"
 #include "GPUDeque.h"
+#include "GPURingBuffer.h"
+#include "IndirectDraw.h"
+#include "GPUSoAVector.h"
+#include "GPUPingPongVector.h"
+#include "GPUHashMap.h"
+#include "GPUSlotMap.h"
+#include "GPUWorkQueue.h"
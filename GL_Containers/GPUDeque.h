@@ -1,34 +1,121 @@
 #pragma once
 
+#include <algorithm>
+#include <cassert>
+#include <compare>
+#include <deque>
+#include <iterator>
+#include <memory>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+#include "GPUPagePool.h"
+#include "GPUReadback.h"
+#include "GPUTelemetry.h"
+#include "GPUUploadManager.h"
+#include "RemoveUnorderedPlan.h"
+
 template<typename T, bool MappedInterface = false, std::size_t MinPageSize = 0x10000>
 struct GPUDeque
 {
     using value_type = T;
 
-    constexpr static std::size_t PageSizeBytes = std::max<std::size_t>(MinPageSize, sizeof(T));
-    constexpr static std::size_t CountPerPage = PageSizeBytes / sizeof(T);
+    // -- a whole number of elements per page, so pages carved out of a shared buffer stay element aligned
+    constexpr static std::size_t CountPerPage = std::max<std::size_t>(MinPageSize, sizeof(T)) / sizeof(T);
+    constexpr static std::size_t PageSizeBytes = CountPerPage * sizeof(T);
 
     // use coherent map bit by default so the user doesn't have to think about explicit sync.  This may be slower!
     constexpr static GLenum PersistentMappingDefaultFlags = GL_MAP_READ_BIT | GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
 
+    // -- mapped deques map whole arenas, 1MB of them with the default page size
+    constexpr static std::size_t DefaultPagesPerArena = MappedInterface ? 16u : 1u;
+
     const GLenum usage;
 
-    using PageIndex = std::pair<std::size_t, std::size_t>;
+    /// (page, element within page) pair.  Kept normalized so that second < CountPerPage
+    struct PageIndex
+    {
+        std::size_t first = 0;
+        std::size_t second = 0;
+
+        std::size_t linear() const
+        {
+            return first * CountPerPage + second;
+        }
+
+        static PageIndex fromLinear(const std::size_t linear)
+        {
+            return { linear / CountPerPage, linear % CountPerPage };
+        }
+
+        PageIndex& operator+=(const std::size_t n)
+        {
+            return *this = fromLinear(linear() + n);
+        }
+
+        PageIndex& operator-=(const std::size_t n)
+        {
+            assert(linear() >= n);
+            return *this = fromLinear(linear() - n);
+        }
+
+        PageIndex operator+(const std::size_t n) const
+        {
+            PageIndex rval = *this;
+            return rval += n;
+        }
+
+        PageIndex operator-(const std::size_t n) const
+        {
+            PageIndex rval = *this;
+            return rval -= n;
+        }
+
+        std::ptrdiff_t operator-(const PageIndex& rhs) const
+        {
+            return std::ptrdiff_t(linear()) - std::ptrdiff_t(rhs.linear());
+        }
 
+        // prefix
+        PageIndex& operator++() { return *this += 1; }
+        PageIndex& operator--() { return *this -= 1; }
+
+        // postfix
+        PageIndex operator++(int) { PageIndex temp = *this; ++(*this); return temp; }
+        PageIndex operator--(int) { PageIndex temp = *this; --(*this); return temp; }
+
+        bool operator==(const PageIndex& rhs) const = default;
+    };
+
+    /// - count elements starting at element start of a page.  The page begins pageOffset bytes into buffer
     struct ContiguousRange
     {
         std::size_t start;
         std::size_t count;
         gl::Buffer& buffer;
+        std::size_t pageOffset;
+
+        ContiguousRange(std::size_t s, std::size_t c, gl::Buffer& b, std::size_t po = 0u)
+            : start(s), count(c), buffer(b), pageOffset(po)
+        {
+        }
+
+        /// - index of the first element counted from the start of buffer, eg. for a draw's first vertex
+        std::size_t firstElement() const
+        {
+            assert(pageOffset % sizeof(T) == 0);
+            return pageOffset / sizeof(T) + start;
+        }
 
-        ContiguousRange(std::size_t s, std::size_t c, gl::Buffer& b)
-            : start(s), count(c), buffer(b)
+        /// - byte offset of the first element from the start of buffer, eg. for glBindBufferRange
+        std::size_t offsetBytes() const
         {
+            return pageOffset + start * sizeof(T);
         }
     };
 
 
-    template <typename T, bool MappedInterface>
     struct ContiguousRangeIterator
     {
         GPUDeque& parent;
@@ -37,7 +124,7 @@ struct GPUDeque
 
         ContiguousRange operator*()
         {
-            return ContiguousRange(startIndex(), count(), buffer());
+            return ContiguousRange(startIndex(), count(), buffer(), parent.pageVector[currentPage].slot.offset);
         }
 
         ContiguousRangeIterator begin()
@@ -54,12 +141,12 @@ struct GPUDeque
 
         ContiguousRangeIterator(GPUDeque& p) :parent(p)
         {
-            currentPage = parent.begin.first;
+            currentPage = parent.head.first;
         }
 
         gl::Buffer& buffer()
         {
-            return parent.pageVector[currentPage].buffer;
+            return parent.pageVector[currentPage].buffer();
         }
 
         std::size_t count() const
@@ -77,6 +164,11 @@ struct GPUDeque
             return (currentPage < parent.pageVector.size()) && parent.countForPage(currentPage);
         }
 
+        bool operator!=(const ContiguousRangeIterator& other) const
+        {
+            return currentPage != other.currentPage;
+        }
+
         ContiguousRangeIterator& operator++()
         {
             currentPage++;
@@ -91,9 +183,10 @@ struct GPUDeque
         }
     };
 
-    using RangeIterator = ContiguousRangeIterator<T, MappedInterface>;
+    using RangeIterator = ContiguousRangeIterator;
 
-    PageIndex end()
+    /// - one past the last element the allocated pages can hold
+    PageIndex capacityEnd() const
     {
         return { pageVector.size(),0u };
     }
@@ -103,9 +196,232 @@ struct GPUDeque
         return RangeIterator(*this);
     }
 
+    /// Random access iterator of a mapped deque.  Caches the current page's mapped pointer, so ++ / -- / * only look up the page table when crossing a page.
+    /// - a mutable iterator marks each page it enters as written (the live part of it), so explicit flush mappings flush it.  Use cbegin() / cend() to only read
+    /// - invalidated by push_back / push_front / shrink_to_fit, like std::deque's
+    template <bool Const>
+    struct MappedIterator
+    {
+        using iterator_concept = std::random_access_iterator_tag;
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = std::conditional_t<Const, const T*, T*>;
+        using reference = std::conditional_t<Const, const T&, T&>;
+        using Parent = std::conditional_t<Const, const GPUDeque, GPUDeque>;
+
+        Parent* parent = nullptr;
+        PageIndex index;
+        pointer page = nullptr;     // mapped pointer of page index.first
+
+        MappedIterator() = default;
+
+        MappedIterator(Parent* p, const PageIndex& i) : parent(p), index(i)
+        {
+            loadPage();
+        }
+
+        // -- iterator -> const_iterator
+        template <bool C = Const, typename = std::enable_if_t<C>>
+        MappedIterator(const MappedIterator<false>& other) : parent(other.parent), index(other.index), page(other.page)
+        {
+        }
+
+        reference operator*() const
+        {
+            assert(page != nullptr);
+            return page[index.second];
+        }
+
+        pointer operator->() const
+        {
+            return &**this;
+        }
+
+        reference operator[](const difference_type n) const
+        {
+            return *(*this + n);
+        }
+
+        MappedIterator& operator++()
+        {
+            if (++index.second == CountPerPage)
+            {
+                index.first++;
+                index.second = 0;
+                loadPage();
+            }
+
+            return *this;
+        }
+
+        MappedIterator& operator--()
+        {
+            if (index.second == 0)
+            {
+                index.first--;
+                index.second = CountPerPage - 1;
+                loadPage();
+            }
+            else
+            {
+                index.second--;
+            }
+
+            return *this;
+        }
+
+        MappedIterator operator++(int) { MappedIterator temp = *this; ++(*this); return temp; }
+        MappedIterator operator--(int) { MappedIterator temp = *this; --(*this); return temp; }
+
+        MappedIterator& operator+=(const difference_type n)
+        {
+            const std::size_t oldPage = index.first;
+
+            index = PageIndex::fromLinear(std::size_t(difference_type(index.linear()) + n));
+
+            if (index.first != oldPage)
+            {
+                loadPage();
+            }
+
+            return *this;
+        }
+
+        MappedIterator& operator-=(const difference_type n)
+        {
+            return *this += -n;
+        }
+
+        MappedIterator operator+(const difference_type n) const
+        {
+            MappedIterator rval = *this;
+            return rval += n;
+        }
+
+        MappedIterator operator-(const difference_type n) const
+        {
+            MappedIterator rval = *this;
+            return rval -= n;
+        }
+
+        friend MappedIterator operator+(const difference_type n, const MappedIterator& it)
+        {
+            return it + n;
+        }
+
+        difference_type operator-(const MappedIterator& rhs) const
+        {
+            return index - rhs.index;
+        }
+
+        bool operator==(const MappedIterator& rhs) const
+        {
+            return index == rhs.index;
+        }
+
+        auto operator<=>(const MappedIterator& rhs) const
+        {
+            return index.linear() <=> rhs.index.linear();
+        }
+
+    private:
+
+        void loadPage()
+        {
+            if (index.first >= parent->pageVector.size())
+            {
+                // -- one past the end
+                page = nullptr;
+                return;
+            }
+
+            if constexpr (Const)
+            {
+                page = parent->pageVector[index.first].mappedPtr;
+            }
+            else
+            {
+                const std::size_t first = parent->startForPage(index.first);
+                page = parent->pageVector[index.first].markWritten(first, first + parent->countForPage(index.first));
+            }
+        }
+    };
+
+    using iterator = MappedIterator<false>;
+    using const_iterator = MappedIterator<true>;
+
+    iterator begin() requires MappedInterface
+    {
+        assert(mapped);
+        return iterator(this, head);
+    }
+
+    iterator end() requires MappedInterface
+    {
+        return iterator(this, cursor);
+    }
+
+    const_iterator begin() const requires MappedInterface
+    {
+        assert(mapped);
+        return const_iterator(this, head);
+    }
+
+    const_iterator end() const requires MappedInterface
+    {
+        return const_iterator(this, cursor);
+    }
+
+    const_iterator cbegin() const requires MappedInterface
+    {
+        return begin();
+    }
+
+    const_iterator cend() const requires MappedInterface
+    {
+        return end();
+    }
+
+    /// - [first, first + count) of a mapped deque as one contiguous span per page, front to back.  Run SIMD / std::execution loops over each span,
+    ///   or hand the spans to different threads.  The mutable version marks the spans as written.  Invalidated like the iterators
+    std::vector<std::span<T>> spans(const std::size_t first = 0u, std::size_t count = std::dynamic_extent) requires MappedInterface
+    {
+        assert(mapped);
+        assert(first <= Size());
+        count = std::min(count, Size() - first);
+
+        std::vector<std::span<T>> rval;
+        rval.reserve(count / CountPerPage + 2);
+
+        forEachPageSegment(first, count, [&](Page& page, std::size_t pageOffset, std::size_t n, std::size_t)
+        {
+            rval.emplace_back(page.markWritten(pageOffset, pageOffset + n) + pageOffset, n);
+        });
+
+        return rval;
+    }
+
+    std::vector<std::span<const T>> spans(const std::size_t first = 0u, std::size_t count = std::dynamic_extent) const requires MappedInterface
+    {
+        assert(mapped);
+        assert(first <= Size());
+        count = std::min(count, Size() - first);
+
+        std::vector<std::span<const T>> rval;
+        rval.reserve(count / CountPerPage + 2);
+
+        forEachPageSegment(first, count, [&](const Page& page, std::size_t pageOffset, std::size_t n, std::size_t)
+        {
+            rval.emplace_back(page.mappedPtr + pageOffset, n);
+        });
+
+        return rval;
+    }
+
     std::size_t Size() const
     {
-        return cursor - begin;
+        return std::size_t(cursor - head);
     }
 
     std::size_t SizeBytes() const
@@ -123,53 +439,119 @@ struct GPUDeque
         return PageSizeBytes * pageVector.size();
     }
 
-#if 0
-    /// Flush client writes on any dirty pages.  They will be seen by the server eventually
-    template<typename = std::enable_if_t<MappedInterface>>
-    void flushWrites()
+    /// - route writes (push_back / push_front / write) through uploader : they are copied into its staging ring and reach the pages when it submits.
+    /// - server side operations on the deque submit it first; anything else reading the pages (draws, Algorithms) needs flushUploads() or uploader->submit().
+    /// - uploader has to outlive the deque, or be detached with setUploader(nullptr).  Non mapped deques only
+    void setUploader(GPUUploadManager* uploaderIn)
     {
-        for (Page& p : pageVector)
+        assert(!MappedInterface || !uploaderIn);
+
+        flushUploads();
+        uploader = uploaderIn;
+    }
+
+    GPUUploadManager* Uploader() const
+    {
+        return uploader;
+    }
+
+    /// - submit the uploader if it holds writes into this deque
+    void flushUploads() const
+    {
+        if (uploadsPending)
         {
-            if (p.dirtyBit)
-            {
-                p.flush();
-            }
+            uploader->submit();
+            uploadsPending = false;
         }
     }
-#endif
 
-    template<typename = std::enable_if_t<MappedInterface>>
-    void map(GLenum flags)
+    /// - Flush client writes on any dirty pages.  They will be seen by the server eventually
+    /// - only the touched interval of each page is flushed.  Returns the number of bytes flushed
+    /// - no-op for coherent mappings
+    std::size_t flushWrites() requires MappedInterface
     {
-        mapped = true;
-
-        mapFlags = flags;
+        std::size_t bytes = 0;
 
         for (Page& p : pageVector)
         {
-            p.mappedPtr = (T*)p.buffer.MapRange(0, PageSizeBytes, flags);
+            const std::size_t pageBytes = p.flush();
+
+            stats.upload(pageBytes, pageBytes ? 1u : 0u);
+            bytes += pageBytes;
         }
+
+        return bytes;
+    }
+
+    /// - pages of a mapped deque are slices of the pool's persistently mapped arenas, so they are mapped from the start and map() / unmap() make no driver calls.
+    /// - the mapping flags come from the storage flags (usage), see GPUPagePool::persistentMapFlags.  Non coherent storage gets an explicit flush mapping; call flushWrites() before the GPU reads
+    void map() requires MappedInterface
+    {
+        mapped = true;
     }
 
-    template<typename = std::enable_if_t<MappedInterface>>
-    void unmap()
+    /// - flushes writes, and the client may not touch the pages until map()
+    void unmap() requires MappedInterface
     {
+        flushWrites();
+
         mapped = false;
-        mapFlags = 0;
+    }
 
-        for each (Page & p in pageVector)
-        {
-            p.mappedPtr = nullptr;
-            p.buffer.Unmap();
-        }
+    bool isMapped() const
+    {
+        return mapped;
     }
 
-    GPUDeque(GLenum usageIn = defaultUsage()) : usage(usageIn)
+    /// - pages come from poolIn if given (it must match our page size and usage), otherwise from a pool private to this deque
+    GPUDeque(GLenum usageIn = defaultUsage(), std::shared_ptr<GPUPagePool> poolIn = nullptr) :
+        usage(usageIn),
+        pool(poolIn ? std::move(poolIn) : makePagePool(usageIn))
     {
+        assert(pool->pageBytes == PageSizeBytes);
+        assert(pool->usage == usage);
+
+        // -- mapped deques take their pages' pointers from the pool's arena mappings
+        assert(MappedInterface == (pool->mapFlags != 0));
+
         pageVector.push_back(allocatePage());
         clear();
     }
 
+    explicit GPUDeque(std::shared_ptr<GPUPagePool> poolIn) : GPUDeque(poolIn->usage, poolIn)
+    {
+    }
+
+    GPUDeque(GPUDeque&&) = default;
+
+    ~GPUDeque()
+    {
+        while (!pageVector.empty())
+        {
+            releasePage(std::move(pageVector.back()));
+            pageVector.pop_back();
+        }
+    }
+
+    /// - a page pool that can be shared between deques of this type
+    /// - pagesPerArena > 1 packs that many pages into each backing buffer, see IndirectDraw.h.  For mapped deques each arena is also one persistent mapping,
+    ///   so a new page is a slice of an existing mapping rather than a buffer + MapRange
+    static std::shared_ptr<GPUPagePool> makePagePool(GLenum usageIn = defaultUsage(), std::size_t highWaterMark = GPUPagePool::DefaultHighWaterMark, std::size_t pagesPerArena = DefaultPagesPerArena)
+    {
+        return std::make_shared<GPUPagePool>(PageSizeBytes, usageIn, highWaterMark, pagesPerArena, MappedInterface ? GPUPagePool::persistentMapFlags(usageIn) : 0);
+    }
+
+    /// - a page pool whose arenas are carved out of heap, so the pages share buffers with anything else allocated from it.  Non mapped deques only
+    static std::shared_ptr<GPUPagePool> makePagePool(std::shared_ptr<GPUBufferHeap> heap, std::size_t highWaterMark = GPUPagePool::DefaultHighWaterMark, std::size_t pagesPerArena = 1u)
+    {
+        return std::make_shared<GPUPagePool>(std::move(heap), PageSizeBytes, highWaterMark, pagesPerArena, sizeof(T));
+    }
+
+    GPUPagePool& pagePool()
+    {
+        return *pool;
+    }
+
     void reserve(std::size_t elements)
     {
         std::size_t cap = Capacity();
@@ -189,45 +571,79 @@ struct GPUDeque
     void push_front(const T& t)
     {
         constexpr PageIndex nullCursor = { 0u, 0u };
-        if (cursor == nullCursor)
+        if (head == nullCursor)
         {
-            pageVector.push_front(allocatePage());
+            // -- ring : reuse a spare page past the back before allocating
+            if (pageVector.size() > cursor.first + 1)
+            {
+                Page p = std::move(pageVector.back());
+                pageVector.pop_back();
+                pageVector.push_front(std::move(p));
+            }
+            else
+            {
+                pageVector.push_front(allocatePage());
+            }
+
             cursor.first++;
-            begin.first++;
+            head.first++;
         }
 
-        setData(t, cursor);
+        head--;
 
-        cursor--;
+        setData(t, head);
+
+        stats.setLiveBytes(SizeBytes());
     }
 
     void push_back(const T& t)
     {
-        if (cursor == end())
+        if (cursor == capacityEnd())
         {
-            pageVector.push_back(allocatePage() );
+            // -- ring : a FIFO pops pages off the front as fast as it fills them at the back, so recycle those first
+            if (head.first > 0)
+            {
+                Page p = std::move(pageVector.front());
+                pageVector.pop_front();
+                pageVector.push_back(std::move(p));
+
+                cursor.first--;
+                head.first--;
+            }
+            else
+            {
+                pageVector.push_back(allocatePage());
+            }
         }
 
         setData(t, cursor);
 
         cursor++;
+
+        stats.setLiveBytes(SizeBytes());
     }
 
     void pop_front()
     {
         assert(Size() != 0);
-        begin++;
+        head++;
+
+        stats.setLiveBytes(SizeBytes());
     }
 
     void pop_back()
     {
         assert(Size() != 0);
         cursor--;
+
+        stats.setLiveBytes(SizeBytes());
     }
 
     void clear()
     {
-        cursor = begin = { 0u,0u };
+        cursor = head = { 0u,0u };
+
+        stats.setLiveBytes(0u);
     }
 
     void shrink_to_fit()
@@ -238,50 +654,97 @@ struct GPUDeque
 
     std::size_t extraPageBytes() const
     {
-        std::size_t extraPagesBack = pageVector.size() - (cursor + 1);
-        std::size_t extraPagesFront = begin.first;
+        std::size_t extraPagesBack = pageVector.size() - std::min(pageVector.size(), cursor.first + 1);
+        std::size_t extraPagesFront = head.first;
         return (extraPagesFront + extraPagesBack) * PageSizeBytes;
     }
 
-    template<typename = std::enable_if_t<MappedInterface == true>>
-    T& operator[](const std::size_t& i)
+    T& operator[](const std::size_t& i) requires MappedInterface
     {
         static_assert(MappedInterface == true);
+        assert(mapped);
         assert(i < Size());
 
-        PageIndex c = begin + i;
+        PageIndex c = head + i;
         return pageVector[c.first][c.second];
     }
 
 
-    template<typename = std::enable_if_t<MappedInterface == false>>
-    T operator[](const std::size_t& i) const
+    T operator[](const std::size_t& i) const requires (!MappedInterface)
     {
         static_assert(MappedInterface == false);
         assert(i < Size());
 
-        PageIndex c = begin + i;
+        PageIndex c = head + i;
 
         return getData(c);
     }
 
-    template<typename = std::enable_if_t<MappedInterface == true>>
-    const T& operator[](const std::size_t& i) const
+    const T& operator[](const std::size_t& i) const requires MappedInterface
     {
         static_assert(MappedInterface == true);
+        assert(mapped);
         assert(i < Size());
 
-        PageIndex c = begin + i;
+        PageIndex c = head + i;
         return pageVector[c.first][c.second];
     }
 
-    template<typename = std::enable_if_t<MappedInterface == false>>
-    void write(const T& value, const std::size_t& i)
+    /// - asynchronous readback of [first, first + count) : one server side copy per page touched into a readback buffer plus a fence.  Never stalls
+    GPUReadback<T> readAsync(const std::size_t first, const std::size_t count)
+    {
+        assert(first + count <= Size());
+
+        if constexpr (MappedInterface)
+        {
+            // -- the copies happen on the server, so they have to see client writes
+            flushWrites();
+        }
+
+        flushUploads();
+
+        GPUReadback<T> rval = readbacks.acquire<T>(count);
+
+        forEachPageSegment(first, count, [&](Page& page, std::size_t pageOffset, std::size_t n, std::size_t dstOffset)
+        {
+            page.buffer().CopySubData(rval.buffer(), page.byteOffset(pageOffset), dstOffset * sizeof(T), n * sizeof(T));
+            stats.readback(n * sizeof(T));
+        });
+
+        rval.submit();
+
+        return rval;
+    }
+
+    /// - synchronous readback of the whole deque with one GetSubData per page
+    void copyTo(std::vector<T>& out)
+    {
+        out.resize(Size());
+
+        flushUploads();
+
+        forEachPageSegment(0u, Size(), [&](Page& page, std::size_t pageOffset, std::size_t n, std::size_t dstOffset)
+        {
+            if constexpr (MappedInterface)
+            {
+                const Page& p = page;
+                std::copy(&p[pageOffset], &p[pageOffset] + n, out.begin() + dstOffset);
+                stats.readback(n * sizeof(T), 0u);
+            }
+            else
+            {
+                page.buffer().GetSubData(page.byteOffset(pageOffset), n * sizeof(T), &out[dstOffset]);
+                stats.readback(n * sizeof(T));
+            }
+        });
+    }
+
+    void write(const T& value, const std::size_t& i) requires (!MappedInterface)
     {
         static_assert(MappedInterface == false);
         assert(i < Size());
 
-        PageIndex c = begin + i;
+        PageIndex c = head + i;
 
         setData(value, c);
     }
@@ -291,6 +754,52 @@ struct GPUDeque
         removeSwapBack(index);
     }
 
+    /// - remove many elements at once, see removeUnorderedPlan()
+    /// - adjacent moves are merged, and only split where a run crosses a page boundary on either side
+    void removeUnordered(std::span<const std::size_t> indices)
+    {
+        std::size_t newSize = Size();
+        std::vector<CopyRun> runs = removeUnorderedPlan(indices, Size(), newSize);
+
+        if constexpr (MappedInterface)
+        {
+            // -- the copies below happen on the server, so they have to see client writes
+            if (!runs.empty())
+            {
+                flushWrites();
+            }
+        }
+
+        flushUploads();
+
+        for (const CopyRun& r : runs)
+        {
+            PageIndex from = head + r.src;
+            PageIndex to = head + r.dst;
+            std::size_t remaining = r.count;
+
+            while (remaining)
+            {
+                const std::size_t n = std::min({ remaining, CountPerPage - from.second, CountPerPage - to.second });
+
+                pageVector[from.first].buffer().CopySubData(pageVector[to.first].buffer(),
+                    pageVector[from.first].byteOffset(from.second),
+                    pageVector[to.first].byteOffset(to.second),
+                    n * sizeof(T));
+
+                stats.copy(n * sizeof(T));
+
+                from += n;
+                to += n;
+                remaining -= n;
+            }
+        }
+
+        cursor = head + newSize;
+
+        stats.setLiveBytes(SizeBytes());
+    }
+
     /// - remove element at index, swapping with last element to keep data tightly packed
     /// - side effect : order of the elements is changed
     void removeSwapBack(const std::size_t index)
@@ -300,35 +809,66 @@ struct GPUDeque
 
         PageIndex last = cursor - 1;
 
-        PageIndex removeIndex = begin + index;
+        PageIndex removeIndex = head + index;
 
         if (removeIndex != last)
         {
+            if constexpr (MappedInterface)
+            {
+                // -- the copy below happens on the server, so it has to see client writes to the source element, and no later
+                // -- flush of the destination page may send its stale client copy over the result
+                pageVector[last.first].flush();
+                pageVector[removeIndex.first].flush();
+            }
+
+            flushUploads();
+
             // since we're a deque the src and dst might be in a different memory page
-            gl::Buffer& fromBuffer = pageVector[last.first].buffer;
-            gl::Buffer& toBuffer = pageVector[removeIndex.first].buffer;
+            const Page& fromPage = pageVector[last.first];
+            const Page& toPage = pageVector[removeIndex.first];
 
             // -- small buffer-buffer copy on gpu / server
-            fromBuffer.CopySubData(toBuffer,
-                last.second * sizeof(T),        // read last element
-                removeIndex.second * sizeof(T), // write last element data TO remove index
+            fromPage.buffer().CopySubData(toPage.buffer(),
+                fromPage.byteOffset(last.second),       // read last element
+                toPage.byteOffset(removeIndex.second),  // write last element data TO remove index
                 sizeof(T));
+
+            stats.copy(sizeof(T));
         }
 
         cursor--;
+
+        stats.setLiveBytes(SizeBytes());
+    }
+
+    /// - memory / traffic counters of this deque, see GPUTelemetry.h.  Pages are the pool's device memory, so only capacity / live bytes are counted here
+    GPUStats& Stats()
+    {
+        return stats;
+    }
+
+    const GPUStats& Stats() const
+    {
+        return stats;
     }
 
 private:
 
-    GLenum mapFlags = 0; // valid state is for these to be zero whenever the deque is not mapped
-    bool mapped = false;
+    bool mapped = MappedInterface; // client may access the pages of a mapped deque
+
+    GPUUploadManager* uploader = nullptr;
+    mutable bool uploadsPending = false; // uploader holds copies into our pages
+
+    GPUReadbackRing readbacks;           // buffers of readAsync()
+
+    GLSUGAR_NO_UNIQUE_ADDRESS mutable GPUStats stats;  // mutable : reads count as traffic
 
     PageIndex cursor = { 0u,0u }; // one past the end
-    PageIndex begin = { 0u,0u };
+    PageIndex head = { 0u,0u };
 
     std::size_t startForPage(const std::size_t& p) const
     {
-        return (p == begin.first) ? begin.second : 0u;
+        return (p == head.first) ? head.second : 0u;
     }
 
     std::size_t countForPage(const std::size_t& p) const
@@ -345,23 +885,49 @@ private:
        return PersistentMappingDefaultFlags;
     }
 
-    template<typename T, bool MappedInterface>
-    struct PageType
+    /// - where a page lives : PageSizeBytes at slot.offset in a buffer owned by the pool
+    struct PageBase
     {
-        gl::Buffer buffer;
+        GPUPageSlot slot;
+
+        PageBase(const GPUPageSlot& s) : slot(s)
+        {
+        }
+
+        gl::Buffer& buffer() const
+        {
+            return *slot.buffer;
+        }
+
+        /// byte offset of element idx of this page from the start of buffer()
+        std::size_t byteOffset(const std::size_t idx) const
+        {
+            return slot.offset + idx * sizeof(T);
+        }
+    };
 
-        PageType(GLenum usage, GLenum x)
+    template<typename ElemType, bool Mapped>
+    struct PageType : PageBase
+    {
+        PageType(const GPUPageSlot& s, GLenum x) : PageBase(s)
         {
-            buffer.Storage(PageSizeBytes, nullptr, usage);
         }
     };
 
-    template <typename T>
-    struct PageType<T, true>
+    template <typename ElemType>
+    struct PageType<ElemType, true> : PageBase
     {
-        gl::Buffer buffer;
+        using PageBase::buffer;
+        using PageBase::slot;
+        using PageBase::byteOffset;
+
         T* mappedPtr = nullptr;
         bool dirtyBit = false;
+        bool explicitFlush = false;
+
+        // -- touched interval of the page in elements, [dirtyBegin, dirtyEnd).  Only tracked for explicit flush mappings
+        std::size_t dirtyBegin = CountPerPage;
+        std::size_t dirtyEnd = 0;
 
 #if _DEBUG
         std::size_t bytesWritten = 0;
@@ -370,59 +936,69 @@ private:
         const T& operator[](const std::size_t idx) const
         {
             assert(mappedPtr != nullptr);
-            return *mappedPtr[idx];
+            return mappedPtr[idx];
         }
 
         T& operator[](const std::size_t idx)
         {
-            assert(mappedPtr != nullptr);
-            dirtyBit = true;
-
-#if _DEBUG
-            bytesWritten += sizeof(T);
-#endif
-
-            return *mappedPtr[idx];
+            return markWritten(idx, idx + 1)[idx];
         }
 
-        PageType(GLenum usage, GLenum mapFlags = 0)
+        /// - elements [first, last) are about to be written through the returned pointer (the start of the page)
+        T* markWritten(const std::size_t first, const std::size_t last)
         {
-            buffer.Storage(PageSizeBytes, nullptr, usage);
+            assert(mappedPtr != nullptr);
 
-            if (mapFlags != 0)
+            if (first < last)
             {
-                map(mapFlags);
+                dirtyBit = true;
+
+                if (explicitFlush)
+                {
+                    dirtyBegin = std::min(dirtyBegin, first);
+                    dirtyEnd = std::max(dirtyEnd, last);
+                }
+
+#if _DEBUG
+                bytesWritten += (last - first) * sizeof(T);
+#endif
             }
+
+            return mappedPtr;
         }
 
-        void map(GLenum mapFlags)
+        /// - s lives in an arena the pool mapped with mapFlags
+        PageType(const GPUPageSlot& s, GLenum mapFlags) : PageBase(s)
         {
-            assert(mappedPtr == nullptr);
-            mappedPtr = (T*)buffer.MapRange(0, PageSizeBytes, mapFlags);
+            mappedPtr = (T*)s.mapped;
             assert(mappedPtr != nullptr);
-            dirtyBit = false;
-#if _DEBUG
-            bytesWritten = 0;
-#endif
+            explicitFlush = mapFlags & GL_MAP_FLUSH_EXPLICIT_BIT;
         }
 
-        void unmap()
+        /// flush the touched interval of the page, returns bytes flushed
+        std::size_t flush()
         {
-            assert(mappedPtr != nullptr);
-            mappedPtr = nullptr;
-            buffer.Unmap();
-            dirtyBit = false;
-#if _DEBUG
-            bytesWritten = 0;
-#endif
+            if (!explicitFlush || dirtyEnd <= dirtyBegin)
+            {
+                return 0u;
+            }
+
+            const std::size_t bytes = (dirtyEnd - dirtyBegin) * sizeof(T);
+
+            // -- relative to the start of the mapping, which is the whole arena buffer
+            buffer().FlushMappedRange(byteOffset(dirtyBegin), bytes);
+
+            resetDirty();
+
+            return bytes;
         }
 
-#if 0
-        void flush()
+        void resetDirty()
         {
-            buffer.FlushMappedRange(0, PageSizeBytes);
+            dirtyBit = false;
+            dirtyBegin = CountPerPage;
+            dirtyEnd = 0;
         }
-#endif
     };
 
 
@@ -430,138 +1006,121 @@ private:
 
     std::deque<Page> pageVector;
 
+    std::shared_ptr<GPUPagePool> pool;
+
     Page allocatePage()
     {
-        return Page(usage, mapFlags);
+        // -- not in pageVector yet
+        stats.setCapacityBytes(CapacityBytes() + PageSizeBytes);
+
+        return Page(pool->acquire(), pool->mapFlags);
+    }
+
+    void releasePage(Page&& p)
+    {
+        // -- the pool may delete the page's buffer
+        flushUploads();
+
+        // -- still in pageVector
+        stats.setCapacityBytes(CapacityBytes() - PageSizeBytes);
+
+        pool->release(p.slot);
     }
 
 
-    template<typename = std::enable_if_t<MappedInterface == false>>
     void setData(const T& dat, const PageIndex& idx)
     {
-        static_assert(MappedInterface == false);
+        if constexpr (MappedInterface)
+        {
+            pageVector[idx.first][idx.second] = dat;
+        }
+        else
+        {
+            const Page& p = pageVector[idx.first];
 
-        gl::Buffer& b = pageVector[idx.first].buffer;
-        b.SubData(idx.second * sizeof(T), sizeof(T), &dat);
+            if (uploader)
+            {
+                uploadsPending |= uploader->stageBuffer(p.buffer(), p.byteOffset(idx.second), &dat, sizeof(T));
+                stats.upload(sizeof(T), 0u);
+            }
+            else
+            {
+                p.buffer().SubData(p.byteOffset(idx.second), sizeof(T), &dat);
+                stats.upload(sizeof(T));
+            }
+        }
     }
 
-    template<typename = std::enable_if_t<MappedInterface == false>>
-    T getData(const PageIndex& idx)
+    T getData(const PageIndex& idx) const requires (!MappedInterface)
     {
         static_assert(MappedInterface == false);
 
+        flushUploads();
+
         T rval;
-        gl::Buffer& b = pageVector[idx.first].buffer;
-        b.GetSubData(idx.second * sizeof(T), sizeof(T), &rval);
+        const Page& p = pageVector[idx.first];
+        p.buffer().GetSubData(p.byteOffset(idx.second), sizeof(T), &rval);
+        stats.readback(sizeof(T));
         return rval;
     }
 
+    /// - visit [first, first + count) as contiguous per page runs : f(page, offset in page, element count, offset from first)
+    template <typename Func>
+    void forEachPageSegment(const std::size_t first, const std::size_t count, Func&& f)
+    {
+        PageIndex c = head + first;
+        std::size_t done = 0;
+
+        while (done < count)
+        {
+            const std::size_t n = std::min(count - done, CountPerPage - c.second);
+
+            f(pageVector[c.first], c.second, n, done);
+
+            c += n;
+            done += n;
+        }
+    }
+
+    template <typename Func>
+    void forEachPageSegment(const std::size_t first, const std::size_t count, Func&& f) const
+    {
+        PageIndex c = head + first;
+        std::size_t done = 0;
+
+        while (done < count)
+        {
+            const std::size_t n = std::min(count - done, CountPerPage - c.second);
+
+            f(pageVector[c.first], c.second, n, done);
+
+            c += n;
+            done += n;
+        }
+    }
+
     void shrinkBack()
     {
-        std::size_t extraPages = pageVector.size() - (cursor + 1);
+        std::size_t extraPages = pageVector.size() - std::min(pageVector.size(), cursor.first + 1);
 
         for (int i = 0; i < extraPages; i++)
         {
+            releasePage(std::move(pageVector.back()));
             pageVector.pop_back();
         }
     }
 
     void shrinkFront()
     {
-        std::size_t extraPagesFront = begin.first;
+        std::size_t extraPagesFront = head.first;
 
         for (int i = 0; i < extraPagesFront; i++)
         {
+            releasePage(std::move(pageVector.front()));
             pageVector.pop_front();
         }
 
         cursor.first -= extraPagesFront;
-        begin.first -= extraPagesFront;
+        head.first -= extraPagesFront;
     }
 };
-
-template<typename T, bool MappedInterface, std::size_t MinPageSize>
-typename GPUDeque<T, MappedInterface, MinPageSize>::PageIndex& operator-=(typename GPUDeque<T, MappedInterface, MinPageSize>::PageIndex& index, const std::size_t& n)
-{
-    constexpr std::size_t CountPerPage = GPUDeque<T, MinPageSize>::CountPerPage;
-
-    std::size_t linear = index.first * CountPerPage + index.second;
-
-    assert(linear >= n);
-
-    linear -= n;
-
-    index.first = linear / CountPerPage;
-    index.second = linear % CountPerPage;
-
-    return index;
-}
-
-
-template<typename T, bool MappedInterface, std::size_t MinPageSize>
-typename GPUDeque<T, MappedInterface, MinPageSize>::PageIndex& operator+=(typename GPUDeque<T, MappedInterface, MinPageSize>::PageIndex& index, const std::size_t& n)
-{
-    constexpr std::size_t CountPerPage = GPUDeque<T, MinPageSize>::CountPerPage;
-
-    index.second += n;
-
-    int divisibleCount = index.second / CountPerPage;
-
-    index.first += divisibleCount;
-    index.second -= CountPerPage * divisibleCount;
-
-    return index;
-}
-
-template<typename T, bool MappedInterface, std::size_t MinPageSize>
-typename GPUDeque<T, MappedInterface, MinPageSize>::PageIndex operator+(typename GPUDeque<T, MappedInterface, MinPageSize>::PageIndex index, const std::size_t& n)
-{
-    index += n;
-    return index;
-}
-
-template<typename T, bool MappedInterface, std::size_t MinPageSize>
-typename GPUDeque<T, MappedInterface, MinPageSize>::PageIndex operator-(typename GPUDeque<T, MappedInterface, MinPageSize>::PageIndex index, const std::size_t& n)
-{
-    index -= n;
-    return index;
-}
-
-// postfix
-template<typename T, bool MappedInterface, std::size_t MinPageSize>
-typename GPUDeque<T, MappedInterface, MinPageSize>::PageIndex operator++(typename GPUDeque<T, MappedInterface, MinPageSize>::PageIndex& index, int)
-{
-    typename GPUDeque<T, MinPageSize>::PageIndex temp = index;
-    ++index;
-    return temp;
-}
-
-template<typename T, bool MappedInterface, std::size_t MinPageSize>
-typename GPUDeque<T, MappedInterface, MinPageSize>::PageIndex operator--(typename GPUDeque<T, MappedInterface, MinPageSize>::PageIndex& index, int)
-{
-    typename GPUDeque<T, MinPageSize>::PageIndex temp = index;
-    --index;
-    return temp;
-}
-
-// prefix
-template<typename T, bool MappedInterface, std::size_t MinPageSize>
-typename GPUDeque<T, MappedInterface, MinPageSize>::PageIndex& operator++(typename GPUDeque<T, MappedInterface, MinPageSize>::PageIndex& index)
-{
-    index += 1;
-    return index;
-}
-
-template<typename T, bool MappedInterface, std::size_t MinPageSize>
-typename GPUDeque<T, MappedInterface, MinPageSize>::PageIndex& operator--(typename GPUDeque<T, MappedInterface, MinPageSize>::PageIndex& index)
-{
-    index -= 1;
-    return index;
-}
-
-template<typename T, bool MappedInterface, std::size_t MinPageSize>
-typename GPUDeque<T, MappedInterface, MinPageSize>::std::ptrdiff_t operator-(const typename GPUDeque<T, MappedInterface, MinPageSize>::PageIndex& lhs, const typename GPUDeque<T, MinPageSize>::PageIndex& rhs)
-{
-    constexpr std::size_t CountPerPage = GPUDeque<T, MinPageSize>::CountPerPage;
-    return (lhs.first * CountPerPage + lhs.second) - (rhs.first * CountPerPage + rhs.second);
-}
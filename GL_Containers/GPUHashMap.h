@@ -0,0 +1,402 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <optional>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+#include "GPUTelemetry.h"
+#include "GPUVector.h"
+
+/// - open addressing hash table living in one buffer, for lookups from shaders : spatial hashes, sparse occupancy, id -> slot tables.
+/// - keys and values are 4 byte PODs (uint, int, float, enums), seen by the shaders as uints.  The key bit patterns 0xFFFFFFFF and 0xFFFFFFFE are reserved.
+/// - shaders insert / look up / erase with the functions of Shaders/HashMap/HashMap.glsl, against the table bound with bind().  build() fills it from the
+///   client with one upload, insert() / lookup() / erase() run a batch from GPUVectors with the programs below.
+/// - the table never grows by itself : inserting past SlotCount() fails, and past Capacity() probe chains get long.  reserve() and rehash() go through
+///   the client and stall, call them outside the frame loop.  GPUHashMapCPU is the reference, with the same hash and probing
+
+/// - built by the client from Shaders/HashMap/HashMapInsert.glsl, HashMapLookup.glsl, HashMapErase.glsl, each with HashMap.glsl
+struct GPUHashMapPrograms
+{
+    gl::Program insert;
+    gl::Program lookup;
+    gl::Program erase;
+};
+
+/// - must match local_size_x in Shaders/HashMap
+constexpr GLuint HashMapGroupSize = 256;
+
+/// - one (key, value) pair, as in the buffer
+struct GPUHashMapSlot
+{
+    GLuint key;
+    GLuint value;
+};
+
+/*** CPU reference implementation ***/
+
+/// - same layout and probing as HashMap.glsl : inserting the same keys in the same order gives the same slots
+template <typename Key, typename Value>
+struct GPUHashMapCPU
+{
+    static_assert(sizeof(Key) == sizeof(GLuint) && std::is_trivially_copyable_v<Key>, "hash map keys are 4 byte PODs");
+    static_assert(sizeof(Value) == sizeof(GLuint) && std::is_trivially_copyable_v<Value>, "hash map values are 4 byte PODs");
+
+    constexpr static GLuint Empty = 0xFFFFFFFFu;
+    constexpr static GLuint Tombstone = 0xFFFFFFFEu;
+
+    /// - slotCount is rounded up to a power of two
+    explicit GPUHashMapCPU(std::size_t slotCount = 2u) :
+        slots(std::bit_ceil(std::max<std::size_t>(slotCount, 2u)), GPUHashMapSlot{ Empty, Empty })
+    {
+    }
+
+    /// - must match hashMapHash() in HashMap.glsl
+    static GLuint hash(GLuint key)
+    {
+        key ^= key >> 16;
+        key *= 0x7feb352du;
+        key ^= key >> 15;
+        key *= 0x846ca68bu;
+        key ^= key >> 16;
+        return key;
+    }
+
+    /// - insert key or overwrite its value.  false when every slot is taken
+    bool insert(const Key& key, const Value& value)
+    {
+        const GLuint k = bits(key);
+        assert(k != Empty && k != Tombstone);
+
+        for (std::size_t probe = 0, slot = hash(k) & mask(); probe < slots.size(); probe++, slot = (slot + 1) & mask())
+        {
+            if (slots[slot].key == Empty || slots[slot].key == k)
+            {
+                size += slots[slot].key == Empty ? 1u : 0u;
+                slots[slot] = { k, bits(value) };
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    std::optional<Value> find(const Key& key) const
+    {
+        const std::size_t slot = findSlot(bits(key));
+
+        if (slot == slots.size()) return std::nullopt;
+
+        return std::bit_cast<Value>(slots[slot].value);
+    }
+
+    /// - leaves a tombstone, like hashMapErase().  false when key isn't in the table
+    bool erase(const Key& key)
+    {
+        const std::size_t slot = findSlot(bits(key));
+
+        if (slot == slots.size()) return false;
+
+        slots[slot].key = Tombstone;
+        size--;
+        return true;
+    }
+
+    /// - calls f(key, value) for each live entry, in slot order
+    template <typename F>
+    void forEach(F&& f) const
+    {
+        for (const GPUHashMapSlot& s : slots)
+        {
+            if (s.key != Empty && s.key != Tombstone)
+            {
+                f(std::bit_cast<Key>(s.key), std::bit_cast<Value>(s.value));
+            }
+        }
+    }
+
+    std::size_t Size() const
+    {
+        return size;
+    }
+
+    std::size_t SlotCount() const
+    {
+        return slots.size();
+    }
+
+    std::span<const GPUHashMapSlot> Slots() const
+    {
+        return slots;
+    }
+
+private:
+
+    template <typename GPUKey, typename GPUValue>
+    friend struct GPUHashMap;
+
+    std::vector<GPUHashMapSlot> slots;
+    std::size_t size = 0;
+
+    std::size_t mask() const
+    {
+        return slots.size() - 1;
+    }
+
+    template <typename U>
+    static GLuint bits(const U& u)
+    {
+        return std::bit_cast<GLuint>(u);
+    }
+
+    std::size_t findSlot(const GLuint k) const
+    {
+        for (std::size_t probe = 0, slot = hash(k) & mask(); probe < slots.size(); probe++, slot = (slot + 1) & mask())
+        {
+            if (slots[slot].key == k) return slot;
+            if (slots[slot].key == Empty) break;
+        }
+
+        return slots.size();
+    }
+};
+
+template <typename Key, typename Value>
+struct GPUHashMap
+{
+    gl::Buffer buffer;
+
+    using key_type = Key;
+    using mapped_type = Value;
+    using CPUMap = GPUHashMapCPU<Key, Value>;
+
+    const static inline std::size_t DefaultCapacity = 1024u;
+
+    /// - what hashMapLookup() writes for missing keys.  Values may have these bits too, lookup() with found tells them apart
+    constexpr static GLuint NotFound = 0xFFFFFFFFu;
+
+    /// - room for capacityIn entries at a load factor of 1/2
+    explicit GPUHashMap(std::size_t capacityIn = DefaultCapacity)
+    {
+        allocate(slotCountFor(capacityIn));
+        clear();
+    }
+
+    /// - as the table binding of HashMap.glsl (HASH_MAP_BINDING, 0 by default)
+    void bind(GLuint binding = 0)
+    {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, buffer.name());
+    }
+
+    /// - empty every slot on the server
+    void clear()
+    {
+        const GLuint empty = CPUMap::Empty;
+        glClearNamedBufferData(buffer.name(), GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &empty);
+        stats.driverCalls(1u);
+    }
+
+    /// - replace the contents with keys[i] -> values[i], hashed on the client and uploaded with one SubData.  Grows to fit keys
+    void build(std::span<const Key> keys, std::span<const Value> values)
+    {
+        assert(keys.size() == values.size());
+
+        CPUMap map(std::max(slotCount, slotCountFor(keys.size())));
+
+        for (std::size_t i = 0; i < keys.size(); i++)
+        {
+            map.insert(keys[i], values[i]);
+        }
+
+        upload(map);
+    }
+
+    /// - same, from a client side table
+    void build(const CPUMap& map)
+    {
+        upload(map);
+    }
+
+    /// - insert keys[i] -> values[i] on the server.  The table must have room for them, see reserve()
+    template <bool KeysMapped, bool ValuesMapped>
+    void insert(GPUHashMapPrograms& progs, GPUVector<Key, KeysMapped>& keys, GPUVector<Value, ValuesMapped>& values)
+    {
+        assert(keys.Size() == values.Size());
+
+        glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, "Hash Map Insert");
+        values.flush();
+        values.bind(GL_SHADER_STORAGE_BUFFER, 2);
+        progs.insert.Use();
+        dispatch(progs.insert, keys);
+        glPopDebugGroup();
+    }
+
+    /// - results[i] = value of keys[i] on the server, NotFound bits for missing keys.  results is resized to keys
+    template <bool KeysMapped, bool ResultsMapped>
+    void lookup(GPUHashMapPrograms& progs, GPUVector<Key, KeysMapped>& keys, GPUVector<Value, ResultsMapped>& results)
+    {
+        // -- the found block is always active, results stand in for it
+        results.resize(keys.Size());
+        results.bind(GL_SHADER_STORAGE_BUFFER, 3);
+        lookupDispatch(progs, keys, results, false);
+    }
+
+    /// - same, and found[i] = 1 if keys[i] is in the table, 0 if not : for values that can have the NotFound bits (eg. int -1).  found is resized to keys
+    template <bool KeysMapped, bool ResultsMapped, bool FoundMapped>
+    void lookup(GPUHashMapPrograms& progs, GPUVector<Key, KeysMapped>& keys, GPUVector<Value, ResultsMapped>& results, GPUVector<GLuint, FoundMapped>& found)
+    {
+        found.resize(keys.Size());
+        found.bind(GL_SHADER_STORAGE_BUFFER, 3);
+        lookupDispatch(progs, keys, results, true);
+    }
+
+    /// - erase keys on the server.  Erased slots stay tombstones until rehash()
+    template <bool KeysMapped>
+    void erase(GPUHashMapPrograms& progs, GPUVector<Key, KeysMapped>& keys)
+    {
+        glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, "Hash Map Erase");
+        progs.erase.Use();
+        dispatch(progs.erase, keys);
+        glPopDebugGroup();
+    }
+
+    /// - grow to hold capacityIn entries, rehashing the current ones on the client.  Stalls
+    void reserve(std::size_t capacityIn)
+    {
+        if (capacityIn > Capacity())
+        {
+            rebuild(slotCountFor(capacityIn));
+        }
+    }
+
+    /// - rehash the current entries on the client, dropping tombstones.  Stalls
+    void rehash()
+    {
+        rebuild(slotCount);
+    }
+
+    /// - synchronous copy of the table into a client side one, eg. to verify against GPUHashMapCPU.  Stalls
+    CPUMap download() const
+    {
+        CPUMap rval(slotCount);
+        buffer.GetSubData(0u, SlotCountBytes(), rval.slots.data());
+        stats.readback(SlotCountBytes());
+
+        rval.size = (std::size_t)std::count_if(rval.slots.begin(), rval.slots.end(),
+            [](const GPUHashMapSlot& s) { return s.key != CPUMap::Empty && s.key != CPUMap::Tombstone; });
+
+        return rval;
+    }
+
+    /// - entries that fit at a load factor of 1/2
+    std::size_t Capacity() const
+    {
+        return slotCount / 2u;
+    }
+
+    std::size_t SlotCount() const
+    {
+        return slotCount;
+    }
+
+    std::size_t SlotCountBytes() const
+    {
+        return slotCount * sizeof(GPUHashMapSlot);
+    }
+
+    /// - memory / traffic counters of this map, see GPUTelemetry.h.  Empty unless GLSUGAR_TELEMETRY is defined
+    GPUStats& Stats()
+    {
+        return stats;
+    }
+
+    const GPUStats& Stats() const
+    {
+        return stats;
+    }
+
+private:
+
+    std::size_t slotCount = 0;
+
+    GLSUGAR_NO_UNIQUE_ADDRESS mutable GPUStats stats;  // mutable : reads count as traffic
+
+    static std::size_t slotCountFor(std::size_t capacity)
+    {
+        return std::bit_ceil(std::max<std::size_t>(capacity * 2u, 2u));
+    }
+
+    void allocate(std::size_t slotCountIn)
+    {
+        gl::Buffer b;
+        b.Storage(slotCountIn * sizeof(GPUHashMapSlot), nullptr, GL_DYNAMIC_STORAGE_BIT);
+        buffer = std::move(b);
+
+        if (slotCount)
+        {
+            stats.reallocation();
+        }
+
+        slotCount = slotCountIn;
+
+        stats.allocation();
+        stats.setDeviceBytes(SlotCountBytes());
+        stats.setCapacityBytes(SlotCountBytes());
+    }
+
+    void upload(const CPUMap& map)
+    {
+        if (map.SlotCount() != slotCount)
+        {
+            allocate(map.SlotCount());
+        }
+
+        buffer.SubData(0u, SlotCountBytes(), map.slots.data());
+        stats.upload(SlotCountBytes());
+        stats.setLiveBytes(map.Size() * sizeof(GPUHashMapSlot));
+    }
+
+    void rebuild(std::size_t slotCountIn)
+    {
+        CPUMap map(slotCountIn);
+        download().forEach([&map](const Key& k, const Value& v) { map.insert(k, v); });
+        upload(map);
+    }
+
+    /// - found is bound by the caller
+    template <bool KeysMapped, bool ResultsMapped>
+    void lookupDispatch(GPUHashMapPrograms& progs, GPUVector<Key, KeysMapped>& keys, GPUVector<Value, ResultsMapped>& results, bool hasFound)
+    {
+        results.resize(keys.Size());
+
+        glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, "Hash Map Lookup");
+        results.bind(GL_SHADER_STORAGE_BUFFER, 2);
+        progs.lookup.Use();
+        progs.lookup.Uniform1<GLint>("hasFound", hasFound ? 1 : 0);
+        dispatch(progs.lookup, keys);
+        glPopDebugGroup();
+    }
+
+    template <bool KeysMapped>
+    void dispatch(gl::Program& p, GPUVector<Key, KeysMapped>& keys)
+    {
+        // -- the pass runs on the server, so it has to see staged / unflushed writes
+        keys.flush();
+
+        // -- bind() starts heap backed vectors at their first element, so the shaders index every vector from 0
+        bind(0);
+        keys.bind(GL_SHADER_STORAGE_BUFFER, 1);
+
+        p.Uniform1<GLuint>("count", GLuint(keys.Size()));
+
+        if (keys.Size())
+        {
+            glDispatchCompute(GLuint((keys.Size() + HashMapGroupSize - 1) / HashMapGroupSize), 1, 1);
+        }
+
+        // -- the table and results are read next by shaders, or copied / read back
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+    }
+};
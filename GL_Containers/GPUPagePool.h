@@ -0,0 +1,317 @@
+#pragma once
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "GPUBufferHeap.h"
+
+/// A page handed out by GPUPagePool : PageBytes of storage at offset in buffer
+struct GPUPageSlot
+{
+    gl::Buffer* buffer = nullptr;
+    std::size_t offset = 0;     // bytes from the start of buffer
+    std::size_t arena = 0;      // which backing buffer of the pool the slot lives in
+    void* mapped = nullptr;     // client pointer to the slot when the pool maps its arenas
+    GLsync fence = nullptr;     // while free in a mapped pool : signalled once the commands issued before release() are done with the page
+};
+
+/// - free list of equally sized pages of immutable buffer storage.
+/// - GPUDeque takes pages from here instead of creating buffers, and gives them back when it shrinks or is destroyed.
+/// - share one pool (via shared_ptr) between deques with the same page size and storage flags so a burst of spawns reuses storage released by another.
+/// - pagesPerArena > 1 carves pages out of larger backing buffers, so the pages of a deque share one buffer at different offsets (eg. for a single multi draw indirect call).
+///   Slots are always handed out lowest arena first, to keep live pages packed into as few buffers as possible.
+/// - with a GPUBufferHeap, arenas are pinned ranges of the heap's blocks instead of buffers of their own
+/// - with mapFlags, every arena is persistently mapped as a whole when it's created and stays mapped until it's deleted.  Slots carry their client pointer,
+///   so handing out a page makes no driver call and all the pages of an arena share one mapping (mapped GPUDeque).
+///   Nothing syncs at map time then, so release() fences the slot and acquire() only hands it out again once the GPU is done with its previous owner's draws
+struct GPUPagePool
+{
+    const static inline std::size_t DefaultHighWaterMark = 16u;
+
+    const std::size_t pageBytes;
+    const std::size_t elementBytes;
+    const GLenum usage;
+    const std::size_t pagesPerArena;
+    const GLenum mapFlags;
+
+    /// max number of free pages kept around.  Past this, backing buffers whose pages are all free are deleted
+    std::size_t highWaterMark;
+
+    /// - mapFlags non zero maps every arena, see persistentMapFlags().  usage needs GL_MAP_PERSISTENT_BIT and the access bits of mapFlags
+    GPUPagePool(std::size_t pageBytesIn, GLenum usageIn, std::size_t highWaterMarkIn = DefaultHighWaterMark, std::size_t pagesPerArenaIn = 1u, GLenum mapFlagsIn = 0) :
+        pageBytes(pageBytesIn),
+        elementBytes(1u),
+        usage(usageIn),
+        pagesPerArena(std::max<std::size_t>(pagesPerArenaIn, 1u)),
+        mapFlags(mapFlagsIn),
+        highWaterMark(highWaterMarkIn)
+    {
+        assert(!mapFlags || ((usage & GL_MAP_PERSISTENT_BIT) && (mapFlags & GL_MAP_PERSISTENT_BIT)));
+    }
+
+    /// - elementBytes : size of the elements stored in the pages.  Arenas start at a multiple of it, so page offsets divide into element indices
+    GPUPagePool(std::shared_ptr<GPUBufferHeap> heapIn, std::size_t pageBytesIn, std::size_t highWaterMarkIn = DefaultHighWaterMark, std::size_t pagesPerArenaIn = 1u, std::size_t elementBytesIn = 1u) :
+        pageBytes(pageBytesIn),
+        elementBytes(elementBytesIn),
+        usage(heapIn->usage),
+        pagesPerArena(std::max<std::size_t>(pagesPerArenaIn, 1u)),
+        mapFlags(0),
+        highWaterMark(highWaterMarkIn),
+        heap(std::move(heapIn))
+    {
+        assert(pageBytes % elementBytes == 0);
+    }
+
+    GPUPagePool(const GPUPagePool&) = delete;
+    GPUPagePool& operator=(const GPUPagePool&) = delete;
+
+    ~GPUPagePool()
+    {
+        for (GPUPageSlot& s : freeSlots)
+        {
+            deleteFence(s);
+        }
+    }
+
+    /// - the lowest free slot the GPU is done with.  When every free slot of a mapped pool is still in use, waits for the lowest one
+    GPUPageSlot acquire()
+    {
+        if (freeSlots.empty())
+        {
+            addArena();
+        }
+
+        // -- kept sorted descending, so the lowest arena / offset is at the back
+        auto it = std::find_if(freeSlots.rbegin(), freeSlots.rend(), [](const GPUPageSlot& s) { return !s.fence || glClientWaitSync(s.fence, 0, 0) != GL_TIMEOUT_EXPIRED; });
+
+        if (it == freeSlots.rend())
+        {
+            it = freeSlots.rbegin();
+            waitFence(*it);
+        }
+
+        GPUPageSlot rval = *it;
+        freeSlots.erase(std::next(it).base());
+
+        deleteFence(rval);
+        arenas[rval.arena].freeCount--;
+
+        return rval;
+    }
+
+    /// - slot must have come from this pool.  Mapped slots stay mapped, the client just stops using the pointer : the slot is fenced so the next
+    ///   owner doesn't write through it while commands issued before this call still read it
+    void release(const GPUPageSlot& slotIn)
+    {
+        assert(slotIn.buffer == &arenas[slotIn.arena].buffer());
+
+        GPUPageSlot slot = slotIn;
+
+        if (slot.mapped)
+        {
+            slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        }
+
+        auto pos = std::lower_bound(freeSlots.begin(), freeSlots.end(), slot, slotGreater);
+        freeSlots.insert(pos, slot);
+
+        arenas[slot.arena].freeCount++;
+
+        if (freeSlots.size() > highWaterMark)
+        {
+            trim(highWaterMark);
+        }
+    }
+
+    /// - delete backing buffers whose pages are all free, highest arena first, until at most keep free pages remain
+    void trim(std::size_t keep = 0)
+    {
+        for (std::size_t a = arenas.size(); a-- > 0 && freeSlots.size() > keep;)
+        {
+            if (arenas[a].live() && arenas[a].freeCount == pagesPerArena)
+            {
+                // -- the driver defers deleting the buffer until the GPU is done with it, the fences aren't needed
+                for (GPUPageSlot& s : freeSlots)
+                {
+                    if (s.arena == a) deleteFence(s);
+                }
+
+                std::erase_if(freeSlots, [a](const GPUPageSlot& s) { return s.arena == a; });
+                arenas[a] = Arena();
+                stats.setDeviceBytes(ownedArenaBytes());
+            }
+        }
+    }
+
+    /// - flags to map storage created with storageFlags persistently : its access / coherent bits, and explicit flushing for writable non coherent storage
+    static GLenum persistentMapFlags(GLenum storageFlags)
+    {
+        GLenum rval = storageFlags & (GL_MAP_READ_BIT | GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT);
+
+        if ((rval & GL_MAP_WRITE_BIT) && !(rval & GL_MAP_COHERENT_BIT))
+        {
+            rval |= GL_MAP_FLUSH_EXPLICIT_BIT;
+        }
+
+        return rval;
+    }
+
+    /// - create pages ahead of time, eg. before a spawn burst
+    void prewarm(std::size_t pages)
+    {
+        while (freeSlots.size() < pages)
+        {
+            addArena();
+        }
+    }
+
+    std::size_t FreePages() const
+    {
+        return freeSlots.size();
+    }
+
+    std::size_t FreeBytes() const
+    {
+        return freeSlots.size() * pageBytes;
+    }
+
+    /// - total pages ever created by the pool.  Should stay flat in steady state
+    std::size_t PagesCreated() const
+    {
+        return pagesCreated;
+    }
+
+    /// - true when arenas come from a GPUBufferHeap
+    bool HeapBacked() const
+    {
+        return heap != nullptr;
+    }
+
+    /// - backing buffers currently alive
+    std::size_t ArenaCount() const
+    {
+        return std::count_if(arenas.begin(), arenas.end(), [](const Arena& a) { return a.live(); });
+    }
+
+    /// - arenas with a buffer of their own are counted as device bytes, heap backed ones are counted by the heap.  See GPUTelemetry.h
+    GPUStats& Stats()
+    {
+        return stats;
+    }
+
+    const GPUStats& Stats() const
+    {
+        return stats;
+    }
+
+private:
+
+    struct Arena
+    {
+        std::unique_ptr<gl::Buffer> ownBuffer;  // heap allocated so slots can point at it while arenas grows
+        GPUHeapRange range;                     // or a pinned range of a GPUBufferHeap
+        char* mappedPtr = nullptr;              // whole arena, with mapFlags.  Deleting the buffer unmaps it
+        std::size_t freeCount = 0;
+
+        bool live() const
+        {
+            return ownBuffer || range;
+        }
+
+        gl::Buffer& buffer() const
+        {
+            return ownBuffer ? *ownBuffer : range.buffer();
+        }
+
+        std::size_t offset() const
+        {
+            return ownBuffer ? 0u : range.offset();
+        }
+    };
+
+    std::shared_ptr<GPUBufferHeap> heap;
+
+    std::vector<Arena> arenas;              // deleted arenas stay as empty entries so arena indices are stable
+    std::vector<GPUPageSlot> freeSlots;     // sorted descending by (arena, offset)
+    std::size_t pagesCreated = 0;
+
+    GLSUGAR_NO_UNIQUE_ADDRESS GPUStats stats;
+
+    std::size_t ownedArenaBytes() const
+    {
+        return pageBytes * pagesPerArena * std::count_if(arenas.begin(), arenas.end(), [](const Arena& a) { return a.ownBuffer != nullptr; });
+    }
+
+    static bool slotGreater(const GPUPageSlot& a, const GPUPageSlot& b)
+    {
+        return (a.arena != b.arena) ? a.arena > b.arena : a.offset > b.offset;
+    }
+
+    static void waitFence(const GPUPageSlot& s)
+    {
+        GLenum result = glClientWaitSync(s.fence, 0, 0);
+
+        while (result == GL_TIMEOUT_EXPIRED)
+        {
+            result = glClientWaitSync(s.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); // 1ms
+        }
+
+        assert(result != GL_WAIT_FAILED);
+    }
+
+    static void deleteFence(GPUPageSlot& s)
+    {
+        if (s.fence)
+        {
+            glDeleteSync(s.fence);
+            s.fence = nullptr;
+        }
+    }
+
+    void addArena()
+    {
+        // -- reuse the lowest deleted entry so new storage lands as low as possible
+        auto it = std::find_if(arenas.begin(), arenas.end(), [](const Arena& a) { return !a.live(); });
+
+        if (it == arenas.end())
+        {
+            it = arenas.insert(arenas.end(), Arena());
+        }
+
+        const std::size_t index = it - arenas.begin();
+
+        // -- a heap block is shared with other allocations, and a buffer can only be mapped once
+        assert(!heap || !mapFlags);
+
+        if (heap)
+        {
+            // -- pinned : slots hold raw offsets, so the heap must never move an arena
+            it->range = GPUHeapRange(heap, pageBytes * pagesPerArena, true, elementBytes);
+        }
+        else
+        {
+            it->ownBuffer = std::make_unique<gl::Buffer>();
+            it->ownBuffer->Storage(pageBytes * pagesPerArena, nullptr, usage);
+
+            if (mapFlags)
+            {
+                it->mappedPtr = (char*)it->ownBuffer->MapRange(0, pageBytes * pagesPerArena, mapFlags);
+                assert(it->mappedPtr != nullptr);
+            }
+
+            stats.allocation(mapFlags ? 2u : 1u);
+            stats.setDeviceBytes(ownedArenaBytes());
+        }
+
+        it->freeCount = pagesPerArena;
+
+        for (std::size_t i = 0; i < pagesPerArena; i++)
+        {
+            GPUPageSlot slot = { &it->buffer(), it->offset() + i * pageBytes, index, it->mappedPtr ? it->mappedPtr + i * pageBytes : nullptr };
+            freeSlots.insert(std::lower_bound(freeSlots.begin(), freeSlots.end(), slot, slotGreater), slot);
+        }
+
+        pagesCreated += pagesPerArena;
+    }
+};
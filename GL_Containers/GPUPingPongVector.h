@@ -0,0 +1,236 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <utility>
+
+#include "GPUReadback.h"
+#include "GPUVector.h"
+
+/// - double buffered GPUVector for compute simulation : a pass reads state N from front() and writes state N + 1 to back(), then swap() flips them in O(1).
+/// - both buffers always have the same capacity, so whatever fits in front fits in back.  front() and back() are const for that reason : grow them with
+///   reserve() / beginStep() / resize(), write them from shaders, and set front's contents from the client with assign().
+/// - the live count of each buffer is a uint on the GPU (Counters(), index FrontCounterIndex() / BackCounterIndex()).  beginStep() zeroes the back count so
+///   the pass can atomicAdd its way through back(), compacting dead elements while it simulates.  The same (buffer, index) pair works as the counter of
+///   glSugar::Compact(progs, v, flags, scratch), which compacts front into back.
+/// - client side Size() of front / back is an upper bound of the GPU count (the maxCount given to beginStep()).  copyCountTo() puts the real count into an
+///   indirect command, readCountAsync() brings it back without stalling, and syncSize() stalls to make Size() exact
+template <typename T>
+struct GPUPingPongVector
+{
+    using value_type = T;
+
+    GPUPingPongVector(std::size_t capacityIn = GPUVector<T>::DefaultCapacity, GLenum usageIn = GPUVector<T>::NonMappedCreationFlagsDefault) :
+        buffers{ GPUVector<T>(capacityIn, usageIn), GPUVector<T>(capacityIn, usageIn) }
+    {
+        createCounters();
+    }
+
+    /// - both buffers sub-allocated from heap
+    GPUPingPongVector(std::shared_ptr<GPUBufferHeap> heap, std::size_t capacityIn = GPUVector<T>::DefaultCapacity) :
+        buffers{ GPUVector<T>(heap, capacityIn), GPUVector<T>(heap, capacityIn) }
+    {
+        createCounters();
+    }
+
+    /// - state N, read by the step
+    const GPUVector<T>& front() const
+    {
+        return buffers[frontIndex];
+    }
+
+    /// - state N + 1, written by the step
+    const GPUVector<T>& back() const
+    {
+        return buffers[frontIndex ^ 1u];
+    }
+
+    /// - two uints, the GPU side count of each buffer.  Bind it as an SSBO / atomic counter buffer and use the indices below
+    gl::Buffer& Counters()
+    {
+        return counters;
+    }
+
+    GLuint FrontCounterIndex() const
+    {
+        return frontIndex;
+    }
+
+    GLuint BackCounterIndex() const
+    {
+        return frontIndex ^ 1u;
+    }
+
+    std::size_t Size() const
+    {
+        return front().Size();
+    }
+
+    std::size_t Capacity() const
+    {
+        return front().Capacity();
+    }
+
+    /// - grows both buffers.  front keeps its contents, back's are about to be overwritten anyway
+    void reserve(std::size_t capacityIn)
+    {
+        frontBuffer().reserve(capacityIn);
+        backBuffer().reserve(capacityIn);
+    }
+
+    /// - set front's contents and GPU count from the client, eg. the initial state
+    void assign(std::span<const T> values)
+    {
+        reserve(values.size());
+        frontBuffer().assign(values);
+        frontBuffer().flush();
+        setCount(FrontCounterIndex(), GLuint(values.size()));
+    }
+
+    /// - set front's client side size and its GPU count, eg. after appending emitted elements to it on the client
+    void resize(std::size_t sizeIn)
+    {
+        reserve(sizeIn);
+        frontBuffer().resize(sizeIn);
+        setCount(FrontCounterIndex(), GLuint(sizeIn));
+    }
+
+    /// - lower front's client side size to bound, leaving the GPU count alone : eg. a count from readCountAsync() plus what was emitted since
+    void setSizeBound(std::size_t bound)
+    {
+        frontBuffer().resize(std::min(bound, Size()));
+    }
+
+    /// - call before dispatching a step : zeroes the GPU count of back and sizes back to maxCount, the most elements the step can write
+    ///   (eg. front().Size() + emitted for a step that kills and spawns).  Both buffers grow to hold maxCount
+    void beginStep(std::size_t maxCount)
+    {
+        reserve(maxCount);
+        backBuffer().resize(maxCount);
+        setCount(BackCounterIndex(), 0u);
+    }
+
+    void beginStep()
+    {
+        beginStep(front().Size());
+    }
+
+    /// - back becomes front.  barriers make the step's writes visible to whatever reads front next : another step, a draw from it, an indirect command
+    ///   built from its count.  0 skips the barrier, eg. when the caller issues its own
+    void swap(GLbitfield barriers = GL_SHADER_STORAGE_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_COMMAND_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT)
+    {
+        frontIndex ^= 1u;
+
+        if (barriers)
+        {
+            glMemoryBarrier(barriers);
+        }
+    }
+
+    /// - front as SSBO frontBinding and back as backBinding, over their whole capacity
+    void bind(GLuint frontBinding, GLuint backBinding, GLenum target = GL_SHADER_STORAGE_BUFFER)
+    {
+        front().bind(target, frontBinding);
+        back().bind(target, backBinding);
+    }
+
+    /// - both GPU counts as counterBinding, eg. GL_ATOMIC_COUNTER_BUFFER or an SSBO indexed with Front / BackCounterIndex()
+    void bindCounters(GLuint counterBinding, GLenum target = GL_SHADER_STORAGE_BUFFER)
+    {
+        glBindBufferBase(target, counterBinding, counters.name());
+    }
+
+    /// - front as vertex buffer binding of vao, eg. to draw the particles of the last step.  Rebind after every swap()
+    template <typename VaoType>
+    void bindVertexBuffer(VaoType& vao, int binding = 0)
+    {
+        vao.vertexBuffer(frontBuffer().storage(), binding, int(sizeof(T)), int(front().StorageOffset()));
+    }
+
+    /// - server side copy of front's GPU count to dst at dstOffset bytes, eg. the count / instanceCount of an indirect draw or num_groups_x of a dispatch
+    void copyCountTo(gl::Buffer& dst, std::size_t dstOffset)
+    {
+        counters.CopySubData(dst, FrontCounterIndex() * sizeof(GLuint), dstOffset, sizeof(GLuint));
+        stats.copy(sizeof(GLuint));
+    }
+
+    /// - asynchronous readback of [first, first + count) of front, see GPUVector::readAsync
+    GPUReadback<T> readAsync(std::size_t first, std::size_t count)
+    {
+        return frontBuffer().readAsync(first, count);
+    }
+
+    /// - synchronous readback of front.  Stalls
+    void copyTo(std::vector<T>& out)
+    {
+        frontBuffer().copyTo(out);
+    }
+
+    /// - asynchronous readback of front's GPU count
+    GPUReadback<GLuint> readCountAsync()
+    {
+        GPUReadback<GLuint> rval = readbacks.acquire<GLuint>(1u);
+        counters.CopySubData(rval.buffer(), FrontCounterIndex() * sizeof(GLuint), 0u, sizeof(GLuint));
+        rval.submit();
+        stats.readback(sizeof(GLuint));
+        return rval;
+    }
+
+    /// - stalls until the GPU count of front is known and resizes front to it.  Returns the count
+    std::size_t syncSize()
+    {
+        GLuint count = 0;
+        counters.GetSubData(FrontCounterIndex() * sizeof(GLuint), sizeof(GLuint), &count);
+        stats.readback(sizeof(GLuint));
+
+        frontBuffer().resize(count);
+        return count;
+    }
+
+    /// - counts the counter traffic; each buffer has its own Stats()
+    GPUStats& Stats()
+    {
+        return stats;
+    }
+
+    const GPUStats& Stats() const
+    {
+        return stats;
+    }
+
+private:
+
+    std::array<GPUVector<T>, 2> buffers;
+    GLuint frontIndex = 0;
+
+    GPUVector<T>& frontBuffer()
+    {
+        return buffers[frontIndex];
+    }
+
+    GPUVector<T>& backBuffer()
+    {
+        return buffers[frontIndex ^ 1u];
+    }
+
+    gl::Buffer counters;
+    GPUReadbackRing readbacks;      // buffers of readCountAsync()
+
+    GLSUGAR_NO_UNIQUE_ADDRESS GPUStats stats;
+
+    void createCounters()
+    {
+        const GLuint zero[2] = { 0u, 0u };
+        counters.Storage(sizeof(zero), zero, GL_DYNAMIC_STORAGE_BIT);
+
+        stats.allocation();
+        stats.setDeviceBytes(sizeof(zero));
+    }
+
+    void setCount(GLuint index, GLuint count)
+    {
+        counters.SubData(index * sizeof(GLuint), sizeof(GLuint), &count);
+        stats.upload(sizeof(GLuint));
+    }
+};
@@ -0,0 +1,195 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <memory>
+#include <span>
+#include <vector>
+
+/// - persistently mapped buffer a GPUReadback copies into.  Owned by a GPUReadbackRing, or by a single handle
+struct GPUReadbackSlot
+{
+    constexpr static GLenum ReadbackFlags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+    gl::Buffer buffer;
+    std::size_t capacityBytes = 0;
+    const void* mappedPtr = nullptr;
+    GLsync fence = nullptr;     // the copies recorded into buffer, deleted once they land
+
+    explicit GPUReadbackSlot(std::size_t bytes) : capacityBytes(bytes)
+    {
+        buffer.Storage(bytes, nullptr, ReadbackFlags);
+        mappedPtr = buffer.MapRange(0, bytes, ReadbackFlags);
+        assert(mappedPtr != nullptr);
+    }
+
+    GPUReadbackSlot(const GPUReadbackSlot&) = delete;
+    GPUReadbackSlot& operator=(const GPUReadbackSlot&) = delete;
+
+    ~GPUReadbackSlot()
+    {
+        if (fence) glDeleteSync(fence);
+    }
+
+    /// - non blocking.  true once the copies have landed
+    bool ready()
+    {
+        if (!fence) return true;
+
+        GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+
+        if (result == GL_TIMEOUT_EXPIRED) return false;
+
+        assert(result != GL_WAIT_FAILED);
+
+        glDeleteSync(fence);
+        fence = nullptr;
+        return true;
+    }
+};
+
+/// - future-like handle for a GPU -> client copy
+/// - the container copies the requested elements into a persistently mapped readback buffer on the server and fences it.
+/// - poll ready() each frame, or wait(), then read data() without ever stalling on GetSubData.
+/// - the buffer comes from the container's GPUReadbackRing and goes back to it when the handle is destroyed, so keep handles short lived
+template <typename T>
+struct GPUReadback
+{
+    using value_type = T;
+
+    GPUReadback() = default;
+
+    /// - with a buffer of its own
+    explicit GPUReadback(std::size_t countIn) :
+        GPUReadback(countIn ? std::make_shared<GPUReadbackSlot>(countIn * sizeof(T)) : nullptr, countIn)
+    {
+    }
+
+    /// - in slot, which must hold countIn elements and have no fence.  See GPUReadbackRing
+    GPUReadback(std::shared_ptr<GPUReadbackSlot> slotIn, std::size_t countIn) :
+        slot(std::move(slotIn)),
+        count(countIn)
+    {
+        assert(!count || (slot && slot->capacityBytes >= count * sizeof(T) && !slot->fence));
+    }
+
+    GPUReadback(const GPUReadback&) = delete;
+    GPUReadback& operator=(const GPUReadback&) = delete;
+
+    GPUReadback(GPUReadback&&) = default;
+    GPUReadback& operator=(GPUReadback&&) = default;
+
+    /// - where the container records the copies, element 0 at offset 0
+    gl::Buffer& buffer()
+    {
+        assert(slot);
+        return slot->buffer;
+    }
+
+    /// - called by the container after recording the copies into buffer()
+    void submit()
+    {
+        if (slot)
+        {
+            assert(slot->fence == nullptr);
+            slot->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        }
+    }
+
+    /// - non blocking.  true once the copy has landed in the readback buffer
+    bool ready()
+    {
+        return !slot || slot->ready();
+    }
+
+    /// - block until the copy is complete
+    void wait()
+    {
+        while (!ready())
+        {
+            glClientWaitSync(slot->fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); // 1ms
+        }
+    }
+
+    /// - view of the data, valid as long as this handle lives.  Waits if the copy isn't finished yet
+    std::span<const T> data()
+    {
+        wait();
+        return { slot ? (const T*)slot->mappedPtr : nullptr, count };
+    }
+
+    /// - copy of the data.  Waits if the copy isn't finished yet
+    std::vector<T> get()
+    {
+        std::span<const T> d = data();
+        return std::vector<T>(d.begin(), d.end());
+    }
+
+    std::size_t Size() const
+    {
+        return count;
+    }
+
+private:
+
+    std::shared_ptr<GPUReadbackSlot> slot;
+    std::size_t count = 0;
+};
+
+/// - readback buffers a container reuses between its readAsync() calls, instead of creating and mapping a buffer per call.
+/// - a slot is free once no GPUReadback holds it and its fence has signalled.  The ring grows when every slot is busy, so it settles at the number
+///   of readbacks in flight (eg. 2 for a count read back every frame and replaced when it lands)
+struct GPUReadbackRing
+{
+    /// - smallest slot allocated, so small reads of different sizes share slots
+    const static inline std::size_t MinSlotBytes = 256u;
+
+    /// - handle for count elements in a free slot
+    template <typename T>
+    GPUReadback<T> acquire(std::size_t count)
+    {
+        if (!count) return GPUReadback<T>();
+
+        const std::size_t bytes = count * sizeof(T);
+
+        std::shared_ptr<GPUReadbackSlot>* free = nullptr;
+
+        for (std::shared_ptr<GPUReadbackSlot>& s : slots)
+        {
+            if (s.use_count() != 1 || !s->ready()) continue;
+
+            if (s->capacityBytes >= bytes) return GPUReadback<T>(s, count);
+
+            free = &s;
+        }
+
+        // -- replace a free slot that's too small rather than growing the ring
+        std::shared_ptr<GPUReadbackSlot> s = std::make_shared<GPUReadbackSlot>(std::max(std::bit_ceil(bytes), MinSlotBytes));
+
+        if (free)
+        {
+            *free = s;
+        }
+        else
+        {
+            slots.push_back(s);
+        }
+
+        return GPUReadback<T>(std::move(s), count);
+    }
+
+    std::size_t SlotCount() const
+    {
+        return slots.size();
+    }
+
+    /// - delete the slots no handle holds
+    void trim()
+    {
+        std::erase_if(slots, [](const std::shared_ptr<GPUReadbackSlot>& s) { return s.use_count() == 1; });
+    }
+
+private:
+
+    std::vector<std::shared_ptr<GPUReadbackSlot>> slots;
+};
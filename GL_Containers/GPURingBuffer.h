@@ -0,0 +1,213 @@
+#pragma once
+
+#include <array>
+#include <algorithm>
+
+#include "GPUTelemetry.h"
+
+/// - one persistently mapped buffer split into FramesInFlight regions for streaming per frame data
+/// - each region is guarded by a fence, so the client never overwrites data the GPU is still reading
+/// - usage : beginFrame(), allocate() as many times as needed and write through the returned pointer, endFrame() after the draws / dispatches that consume the data are submitted
+template <typename T, std::size_t FramesInFlight = 3>
+struct GPURingBuffer
+{
+    using value_type = T;
+
+    // use coherent map bit by default so the user doesn't have to think about explicit sync.
+    // without it, endFrame() flushes the used part of the region.
+    constexpr static GLenum PersistentMappingDefaultFlags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+    /// A chunk of the current frame's region
+    struct Allocation
+    {
+        T* ptr;                     // client write pointer into the mapping
+        std::size_t count;          // elements
+        std::size_t offsetBytes;    // offset from the start of buffer, for Vao::vertexBuffer or glBindBufferRange
+        gl::Buffer& buffer;
+
+        std::size_t SizeBytes() const
+        {
+            return count * sizeof(T);
+        }
+
+        operator bool() const
+        {
+            return ptr != nullptr;
+        }
+    };
+
+    gl::Buffer buffer;
+
+    /// - capacityPerFrame : max elements allocated between beginFrame() and endFrame()
+    /// - alignmentBytes : alignment of each allocation's offset.  0 queries GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT so allocations can be bound as SSBOs
+    GPURingBuffer(std::size_t capacityPerFrame, std::size_t alignmentBytes = 0, GLenum flags = PersistentMappingDefaultFlags) :
+        mapFlags(flags)
+    {
+        if (!alignmentBytes)
+        {
+            alignmentBytes = gl::Get<GLint>(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT);
+        }
+
+        alignment = std::max<std::size_t>(alignmentBytes, alignof(T));
+        regionBytes = alignUp(capacityPerFrame * sizeof(T));
+
+        if (!(mapFlags & GL_MAP_COHERENT_BIT))
+        {
+            mapFlags |= GL_MAP_FLUSH_EXPLICIT_BIT;
+        }
+
+        // -- storage flags can't contain the flush explicit bit
+        buffer.Storage(regionBytes * FramesInFlight, nullptr, mapFlags & ~GL_MAP_FLUSH_EXPLICIT_BIT);
+
+        mappedPtr = (unsigned char*)buffer.MapRange(0, regionBytes * FramesInFlight, mapFlags);
+        assert(mappedPtr != nullptr);
+
+        stats.allocation(2u);
+        stats.setDeviceBytes(CapacityBytes());
+
+        fences.fill(nullptr);
+    }
+
+    GPURingBuffer(const GPURingBuffer&) = delete;
+    GPURingBuffer& operator=(const GPURingBuffer&) = delete;
+
+    ~GPURingBuffer()
+    {
+        for (GLsync& f : fences)
+        {
+            if (f) glDeleteSync(f);
+        }
+
+        // -- deleting the buffer unmaps it
+    }
+
+    /// - wait until the GPU is done with the region we're about to reuse.  Returns true if we had to block
+    bool beginFrame()
+    {
+        assert(!inFrame);
+        inFrame = true;
+        cursor = 0;
+
+        return waitForRegion(region);
+    }
+
+    /// - hand out count elements from the current region.  Returns a null allocation if the region is full
+    Allocation allocate(std::size_t count)
+    {
+        assert(inFrame);
+
+        const std::size_t offset = alignUp(cursor);
+        const std::size_t bytes = count * sizeof(T);
+
+        if (offset + bytes > regionBytes)
+        {
+            return { nullptr, 0u, 0u, buffer };
+        }
+
+        cursor = offset + bytes;
+
+        // -- written through the mapping, no driver call
+        stats.upload(bytes, 0u);
+
+        const std::size_t bufferOffset = region * regionBytes + offset;
+
+        return { (T*)(mappedPtr + bufferOffset), count, bufferOffset, buffer };
+    }
+
+    /// - fence the current region and move on to the next one
+    void endFrame()
+    {
+        assert(inFrame);
+        inFrame = false;
+
+        if ((mapFlags & GL_MAP_FLUSH_EXPLICIT_BIT) && cursor)
+        {
+            buffer.FlushMappedRange(region * regionBytes, cursor);
+            stats.driverCalls(1u);
+        }
+
+        assert(fences[region] == nullptr);
+        fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+        region = (region + 1) % FramesInFlight;
+    }
+
+    /// - glBindBufferRange helper for SSBO / UBO consumption of an allocation
+    static void bindRange(GLenum target, GLuint index, const Allocation& a)
+    {
+        glBindBufferRange(target, index, a.buffer.name(), a.offsetBytes, a.SizeBytes());
+    }
+
+    std::size_t CapacityPerFrameBytes() const
+    {
+        return regionBytes;
+    }
+
+    std::size_t CapacityBytes() const
+    {
+        return regionBytes * FramesInFlight;
+    }
+
+    /// - bytes handed out so far in the current frame, including alignment padding
+    std::size_t FrameBytesUsed() const
+    {
+        return cursor;
+    }
+
+    /// - see GPUTelemetry.h
+    GPUStats& Stats()
+    {
+        return stats;
+    }
+
+    const GPUStats& Stats() const
+    {
+        return stats;
+    }
+
+private:
+
+    unsigned char* mappedPtr = nullptr;
+    GLenum mapFlags = 0;
+
+    std::size_t alignment = 1;
+    std::size_t regionBytes = 0;
+
+    std::size_t region = 0;
+    std::size_t cursor = 0; // bytes used in the current region
+    bool inFrame = false;
+
+    std::array<GLsync, FramesInFlight> fences;
+
+    GLSUGAR_NO_UNIQUE_ADDRESS GPUStats stats;
+
+    std::size_t alignUp(std::size_t bytes) const
+    {
+        return ((bytes + alignment - 1) / alignment) * alignment;
+    }
+
+    bool waitForRegion(std::size_t r)
+    {
+        GLsync& f = fences[r];
+
+        if (!f) return false;
+
+        bool blocked = false;
+
+        // -- first check is non blocking, if that doesn't succeed flush and wait
+        GLenum result = glClientWaitSync(f, 0, 0);
+
+        while (result == GL_TIMEOUT_EXPIRED)
+        {
+            blocked = true;
+            result = glClientWaitSync(f, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); // 1ms
+        }
+
+        assert(result != GL_WAIT_FAILED);
+
+        glDeleteSync(f);
+        f = nullptr;
+
+        return blocked;
+    }
+};
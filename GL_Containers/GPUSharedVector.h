@@ -1,5 +1,10 @@
 #pragma once
 
+#include <atomic>
+#include <span>
+#include <utility>
+#include <vector>
+
 #include "GPUVector.h"
 
 // default is coherent persistent rw shared buffer
@@ -10,10 +15,186 @@ class GPUMappedVector : public GPUVector<T, true>
 
 public:
 
+    /// non-coherent writable mappings need explicit flushes, see flushWrites()
+    constexpr static bool ExplicitFlush = (Flags & GL_MAP_WRITE_BIT) && !(Flags & GL_MAP_COHERENT_BIT);
+
+    /// non-coherent readable mappings need a barrier + fence before the client can see server writes, see fenceReads()
+    constexpr static bool ExplicitReadSync = (Flags & GL_MAP_READ_BIT) && !(Flags & GL_MAP_COHERENT_BIT);
+
     GPUMappedVector() : BaseClass(BaseClass::DefaultCapacity, Flags)
     {
-        BaseClass::map(Flags);
+        BaseClass::map(ExplicitFlush ? (Flags | GL_MAP_FLUSH_EXPLICIT_BIT) : Flags);
+    }
+
+    GPUMappedVector(const GPUMappedVector&) = delete;
+    GPUMappedVector& operator=(const GPUMappedVector&) = delete;
+
+    GPUMappedVector(GPUMappedVector&& other) : BaseClass(std::move(other)), readFence(other.readFence)
+    {
+        assert(!other.appending);
+        other.readFence = nullptr;
+    }
+
+    ~GPUMappedVector()
+    {
+        assert(!appending);
+        if (readFence) glDeleteSync(readFence);
+    }
+
+    /// - concurrent append : any number of threads call appendConcurrent() / pushConcurrent() between beginConcurrentAppend() and seal().
+    /// - each call reserves its range with one atomic fetch_add and the caller writes straight into the mapping (or the mirror), so reserve a batch per call
+    ///   rather than one element.  The order of the ranges is the order of the fetch_adds.
+    /// - expected elements are reserved up front, so the storage never moves while threads write.  Ranges that don't fit go to a client side overflow chunk
+    ///   instead, and seal() grows the storage once and copies them in place.
+    /// - nothing else may touch the vector until seal()
+    void beginConcurrentAppend(std::size_t expected = 0)
+    {
+        assert(!appending);
+
+        this->reserve(this->Size() + expected);
+
+        reserved.store(this->Size(), std::memory_order_relaxed);
+        appendBase = this->data();
+        appendCapacity = this->Capacity();
+        appending = true;
+    }
+
+    /// - thread safe.  Reserves count elements and returns them for writing, valid until seal()
+    std::span<T> appendConcurrent(std::size_t count)
+    {
+        assert(appending);
+
+        const std::size_t first = reserved.fetch_add(count, std::memory_order_relaxed);
+
+        if (first + count <= appendCapacity)
+        {
+            return { appendBase + first, count };
+        }
+
+        // -- lock free push onto the overflow list, seal() copies the chunk to [first, first + count)
+        OverflowChunk* chunk = new OverflowChunk{ first, std::vector<T>(count), overflow.load(std::memory_order_relaxed) };
+
+        while (!overflow.compare_exchange_weak(chunk->next, chunk, std::memory_order_release, std::memory_order_relaxed));
+
+        return chunk->values;
+    }
+
+    /// - thread safe
+    void appendConcurrent(std::span<const T> values)
+    {
+        std::span<T> dst = appendConcurrent(values.size());
+        std::copy(values.begin(), values.end(), dst.begin());
+    }
+
+    /// - thread safe
+    void pushConcurrent(const T& value)
+    {
+        appendConcurrent(1u)[0] = value;
+    }
+
+    /// - call once every appending thread is done (joined / waited on).  Publishes the appended elements to Size(), growing the storage if the reservation
+    ///   overflowed, and tracks them as written.  Explicit flush mappings still need flushWrites() before the GPU reads.  Returns the new size
+    std::size_t seal()
+    {
+        assert(appending);
+        appending = false;
+
+        const std::size_t oldSize = this->Size();
+        const std::size_t newSize = reserved.load(std::memory_order_relaxed);
+        const std::size_t inPlace = std::min(newSize, appendCapacity);
+
+        this->resize(inPlace);
+
+        if (inPlace > oldSize)
+        {
+            this->markWritten(oldSize, inPlace - oldSize);
+        }
+
+        OverflowChunk* chunk = overflow.exchange(nullptr, std::memory_order_acquire);
+
+        if (newSize > inPlace)
+        {
+            // -- one reallocation for the whole overflow.  The part of a chunk that straddles the old capacity is garbage until the copy below
+            this->reserve(std::max(appendCapacity * 2, newSize));
+            this->resize(newSize);
+        }
+
+        while (chunk)
+        {
+            std::copy(chunk->values.begin(), chunk->values.end(), this->data() + chunk->first);
+            this->markWritten(chunk->first, chunk->values.size());
+
+            delete std::exchange(chunk, chunk->next);
+        }
+
+        appendBase = nullptr;
+        return newSize;
+    }
+
+    bool isAppending() const
+    {
+        return appending;
+    }
+
+    /// - call after the GPU commands that write the buffer are submitted
+    /// - makes those writes visible to the mapping and fences them
+    void fenceReads()
+    {
+        if (readFence) glDeleteSync(readFence);
+
+        glMemoryBarrier(GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT);
+        readFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    /// - non blocking check of the fence from fenceReads()
+    bool readsReady()
+    {
+        if (!readFence) return true;
+
+        GLenum result = glClientWaitSync(readFence, 0, 0);
+
+        if (result == GL_TIMEOUT_EXPIRED) return false;
+
+        glDeleteSync(readFence);
+        readFence = nullptr;
+        return true;
+    }
+
+    /// - block until the fence from fenceReads() is signaled.  The mapped data is safe to read afterwards
+    void waitForReads()
+    {
+        if (!readFence) return;
+
+        GLenum result = glClientWaitSync(readFence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+
+        while (result == GL_TIMEOUT_EXPIRED)
+        {
+            result = glClientWaitSync(readFence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); // 1ms
+        }
+
+        assert(result != GL_WAIT_FAILED);
+
+        glDeleteSync(readFence);
+        readFence = nullptr;
     }
+
+private:
+
+    GLsync readFence = nullptr;
+
+    struct OverflowChunk
+    {
+        std::size_t first;
+        std::vector<T> values;
+        OverflowChunk* next;
+    };
+
+    // -- concurrent append, see beginConcurrentAppend()
+    bool appending = false;
+    T* appendBase = nullptr;                        // data() when the append began, stable until seal()
+    std::size_t appendCapacity = 0;
+    std::atomic<std::size_t> reserved = 0;          // end of the reserved ranges
+    std::atomic<OverflowChunk*> overflow = nullptr; // ranges past appendCapacity, in reverse reservation order
 };
 
 template <typename T>
@@ -26,10 +207,25 @@ template <typename T>
 using GPUSharedVectorReadable = GPUMappedVector<T, GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT>;
 
 // *** need to be manually flushed / synced ***
+// - writable : writes through push_back / append / write are tracked, writes through operator[] need markWritten().  flushWrites() before the GPU reads.
+// - readable : fenceReads() after the GPU writes, then waitForReads() / readsReady() before reading.
 template <typename T>
 using GPUPersistentVectorWritable = GPUMappedVector<T, GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT>;
 
 template <typename T>
 using GPUPersistentVectorReadable = GPUMappedVector<T, GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT>;
 
+// *** client side mirror, see GPUVector::setMirrored() ***
+// - reads and read-modify-write loops run on a cached std::vector, flush() once per frame streams the dirty blocks into a write only mapping
+template <typename T, GLenum Flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT>
+class GPUMirroredVector : public GPUMappedVector<T, Flags>
+{
+public:
+
+    GPUMirroredVector()
+    {
+        this->setMirrored(true);
+    }
+};
+
 
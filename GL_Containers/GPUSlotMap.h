@@ -0,0 +1,301 @@
+#pragma once
+
+#include <algorithm>
+#include <span>
+#include <vector>
+
+#include "GPUVector.h"
+#include "RemoveUnorderedPlan.h"
+
+/// - stable handle to an element of a GPUSlotMap.  8 bytes, so it can be stored in GPU buffers : uvec2(index, generation) in Shaders/SlotMap/SlotMap.glsl
+struct SlotMapHandle
+{
+    GLuint index = 0xFFFFFFFFu;
+    GLuint generation = 0;
+
+    bool operator==(const SlotMapHandle&) const = default;
+};
+
+/// - one entry of the indirection table, as in Slots()
+struct SlotMapSlot
+{
+    GLuint dense;           // index in Dense(), Invalid while the slot is free
+    GLuint generation;      // bumped when the element is erased, so its handles go stale
+};
+
+/// - elements packed in a GPUVector (Dense()) so they draw / dispatch as one range, addressed through handles that survive any removal.
+/// - Slots() maps handle.index to the element's current dense index and generation; a handle whose generation doesn't match is stale.
+///   DenseSlots() maps back from dense index to slot, FreeList() holds the unused slots.  All four are GPU buffers, so shaders can resolve handles
+///   with slotMapResolve() in Shaders/SlotMap/SlotMap.glsl.
+/// - erase() is O(1) : swap back in Dense() plus one slot update.  eraseDeferred() only invalidates the handle, and compact() removes every deferred
+///   element with one removeUnordered(), whose copies are merged into runs.  Deferred elements stay in Dense() (and get drawn) until compact().
+/// - the buffers are in staging mode (see GPUVector::setStaging) : call flush() once before the GPU reads them.  The client keeps its own copy of the
+///   tables, so lookups never read back
+template <typename T>
+struct GPUSlotMap
+{
+    using value_type = T;
+    using Handle = SlotMapHandle;
+
+    constexpr static GLuint Invalid = 0xFFFFFFFFu;
+
+    explicit GPUSlotMap(std::size_t capacityIn = GPUVector<T>::DefaultCapacity) :
+        dense(capacityIn),
+        slots(capacityIn),
+        denseSlots(capacityIn),
+        freeList(capacityIn)
+    {
+        dense.setStaging(true);
+        slots.setStaging(true);
+        denseSlots.setStaging(true);
+        freeList.setStaging(true);
+    }
+
+    Handle insert(const T& value)
+    {
+        GLuint slot;
+
+        if (freeSlots.empty())
+        {
+            slot = GLuint(slotTable.size());
+            slotTable.push_back({ Invalid, 0u });
+            slots.push_back(slotTable.back());
+        }
+        else
+        {
+            slot = freeSlots.back();
+            freeSlots.pop_back();
+            freeList.resize(freeSlots.size());
+        }
+
+        const GLuint d = GLuint(dense.Size());
+
+        dense.push_back(value);
+        denseToSlot.push_back(slot);
+        denseSlots.push_back(slot);
+        setDense(slot, d);
+
+        return { slot, slotTable[slot].generation };
+    }
+
+    bool contains(const Handle h) const
+    {
+        return h.index < slotTable.size() && slotTable[h.index].generation == h.generation && slotTable[h.index].dense != Invalid;
+    }
+
+    /// - current index of the element in Dense().  Changes when other elements are erased, the handle doesn't
+    std::size_t denseIndex(const Handle h) const
+    {
+        assert(contains(h));
+        return slotTable[h.index].dense;
+    }
+
+    void write(const Handle h, const T& value)
+    {
+        dense.write(value, denseIndex(h));
+    }
+
+    /// - swaps the last element into h's place.  false when h is stale
+    bool erase(const Handle h)
+    {
+        if (!contains(h)) return false;
+
+        const GLuint slot = h.index;
+        const GLuint d = slotTable[slot].dense;
+        const GLuint last = GLuint(dense.Size() - 1);
+
+        if (d != last)
+        {
+            const GLuint moved = denseToSlot[last];
+
+            denseToSlot[d] = moved;
+            denseSlots.write(moved, d);
+            setDense(moved, d);
+        }
+
+        dense.removeSwapBack(d);
+        denseToSlot.pop_back();
+        denseSlots.resize(denseToSlot.size());
+
+        invalidate(slot);
+        release(slot);
+        return true;
+    }
+
+    /// - h goes stale now, the element leaves Dense() at the next compact().  false when h is stale
+    bool eraseDeferred(const Handle h)
+    {
+        if (!contains(h)) return false;
+
+        invalidate(h.index);
+        pending.push_back(h.index);
+
+        return true;
+    }
+
+    /// - remove every eraseDeferred() element at once.  Returns how many were removed
+    std::size_t compact()
+    {
+        if (pending.empty()) return 0;
+
+        std::vector<std::size_t> indices;
+        indices.reserve(pending.size());
+
+        for (const GLuint slot : pending)
+        {
+            indices.push_back(slotTable[slot].dense);
+        }
+
+        // -- same plan Dense() and DenseSlots() follow, replayed on the client tables
+        std::size_t newSize = 0;
+
+        for (const CopyRun& r : removeUnorderedPlan(indices, denseToSlot.size(), newSize))
+        {
+            for (std::size_t i = 0; i < r.count; i++)
+            {
+                const GLuint moved = denseToSlot[r.src + i];
+
+                denseToSlot[r.dst + i] = moved;
+                setDense(moved, GLuint(r.dst + i));
+            }
+        }
+
+        dense.removeUnordered(indices);
+        denseSlots.removeUnordered(indices);
+        denseToSlot.resize(newSize);
+
+        for (const GLuint slot : pending)
+        {
+            release(slot);
+        }
+
+        const std::size_t removed = pending.size();
+        pending.clear();
+
+        return removed;
+    }
+
+    /// - erase everything, every handle goes stale.  Slots are kept for reuse
+    void clear()
+    {
+        compact();
+
+        for (const GLuint slot : denseToSlot)
+        {
+            invalidate(slot);
+            release(slot);
+        }
+
+        dense.clear();
+        denseToSlot.clear();
+        denseSlots.clear();
+    }
+
+    void reserve(std::size_t capacityIn)
+    {
+        dense.reserve(capacityIn);
+        denseSlots.reserve(capacityIn);
+        slots.reserve(capacityIn);
+        freeList.reserve(capacityIn);
+
+        slotTable.reserve(capacityIn);
+        denseToSlot.reserve(capacityIn);
+    }
+
+    /// - upload the staged changes of all four buffers
+    void flush()
+    {
+        dense.flush();
+        slots.flush();
+        denseSlots.flush();
+        freeList.flush();
+    }
+
+    /// - Dense() as denseBinding and Slots() as slotBinding, eg. for a shader that resolves handles.  flush() first
+    void bind(GLuint denseBinding, GLuint slotBinding, GLenum target = GL_SHADER_STORAGE_BUFFER)
+    {
+        dense.bind(target, denseBinding);
+        slots.bind(target, slotBinding);
+    }
+
+    /// - the elements, packed.  Includes eraseDeferred() ones until compact()
+    GPUVector<T>& Dense()
+    {
+        return dense;
+    }
+
+    /// - SlotMapSlot per handle index
+    GPUVector<SlotMapSlot>& Slots()
+    {
+        return slots;
+    }
+
+    /// - slot of each element of Dense(), eg. to build handles on the GPU
+    GPUVector<GLuint>& DenseSlots()
+    {
+        return denseSlots;
+    }
+
+    /// - unused slots, the next insert() takes the last one
+    GPUVector<GLuint>& FreeList()
+    {
+        return freeList;
+    }
+
+    /// - live elements, not counting eraseDeferred() ones
+    std::size_t Size() const
+    {
+        return denseToSlot.size() - pending.size();
+    }
+
+    std::size_t Capacity() const
+    {
+        return dense.Capacity();
+    }
+
+    std::size_t SlotCount() const
+    {
+        return slotTable.size();
+    }
+
+    std::size_t PendingErases() const
+    {
+        return pending.size();
+    }
+
+private:
+
+    GPUVector<T> dense;
+    GPUVector<SlotMapSlot> slots;
+    GPUVector<GLuint> denseSlots;
+    GPUVector<GLuint> freeList;
+
+    // -- client copies of slots / denseSlots / freeList
+    std::vector<SlotMapSlot> slotTable;
+    std::vector<GLuint> denseToSlot;
+    std::vector<GLuint> freeSlots;
+
+    std::vector<GLuint> pending;    // slots of eraseDeferred() elements
+
+    void setDense(const GLuint slot, const GLuint d)
+    {
+        slotTable[slot].dense = d;
+        slots.write(slotTable[slot], slot);
+    }
+
+    /// - handles of slot go stale
+    void invalidate(const GLuint slot)
+    {
+        slotTable[slot].generation++;
+        slots.write(slotTable[slot], slot);
+    }
+
+    /// - slot goes back to the free list
+    void release(const GLuint slot)
+    {
+        setDense(slot, Invalid);
+
+        freeSlots.push_back(slot);
+        freeList.push_back(slot);
+    }
+};
@@ -0,0 +1,217 @@
+#pragma once
+
+#include <span>
+#include <tuple>
+#include <utility>
+
+#include "GPUVector.h"
+
+/// - structure of arrays version of GPUVector : one buffer per field, so a pass that only touches eg. positions only reads positions.
+/// - element i is (field 0 [i], field 1 [i], ...).  Every operation is applied to all the fields, so they always stay the same size and in the same order
+/// - value_type is std::tuple<Fields...>, push_back(fields...) also works
+template <typename ...Fields>
+struct GPUSoAVector
+{
+    static_assert(sizeof...(Fields) > 0);
+
+    using value_type = std::tuple<Fields...>;
+
+    constexpr static std::size_t FieldCount = sizeof...(Fields);
+
+    template <std::size_t I>
+    using FieldType = std::tuple_element_t<I, value_type>;
+
+    GPUSoAVector(std::size_t capacityIn = GPUVector<FieldType<0>>::DefaultCapacity, GLenum usageIn = GL_DYNAMIC_STORAGE_BIT) :
+        fields(GPUVector<Fields>(capacityIn, usageIn)...)
+    {
+    }
+
+    /// - every field sub-allocated from heap, so all the fields can live in one buffer
+    GPUSoAVector(std::shared_ptr<GPUBufferHeap> heap, std::size_t capacityIn = GPUVector<FieldType<0>>::DefaultCapacity) :
+        fields(GPUVector<Fields>(heap, capacityIn)...)
+    {
+    }
+
+    /// - the container of field I, eg. for readAsync / append / ExclusiveScan on just that field
+    template <std::size_t I>
+    GPUVector<FieldType<I>>& field()
+    {
+        return std::get<I>(fields);
+    }
+
+    template <std::size_t I>
+    const GPUVector<FieldType<I>>& field() const
+    {
+        return std::get<I>(fields);
+    }
+
+    /// - buffer holding field I, starting at field<I>().StorageOffset()
+    template <std::size_t I>
+    gl::Buffer& buffer()
+    {
+        return field<I>().storage();
+    }
+
+    std::size_t Size() const
+    {
+        return field<0>().Size();
+    }
+
+    /// - total over all the fields
+    std::size_t SizeBytes() const
+    {
+        return std::apply([](const auto&... f) { return (f.SizeBytes() + ...); }, fields);
+    }
+
+    std::size_t Capacity() const
+    {
+        return field<0>().Capacity();
+    }
+
+    std::size_t CapacityBytes() const
+    {
+        return std::apply([](const auto&... f) { return (f.CapacityBytes() + ...); }, fields);
+    }
+
+    void clear()
+    {
+        forEachField([](auto& f) { f.clear(); });
+    }
+
+    void reserve(std::size_t capacityIn)
+    {
+        forEachField([capacityIn](auto& f) { f.reserve(capacityIn); });
+    }
+
+    void resize(std::size_t sizeIn)
+    {
+        forEachField([sizeIn](auto& f) { f.resize(sizeIn); });
+    }
+
+    void shrink_to_fit()
+    {
+        forEachField([](auto& f) { f.shrink_to_fit(); });
+    }
+
+    void push_back(const value_type& v)
+    {
+        pushBack(v, std::index_sequence_for<Fields...>());
+    }
+
+    void push_back(const Fields&... v)
+    {
+        push_back(value_type(v...));
+    }
+
+    /// - one SubData per field
+    void append(std::span<const Fields>... values)
+    {
+        assert(((values.size() == std::get<0>(std::tie(values...)).size()) && ...));
+        appendFields(std::index_sequence_for<Fields...>(), values...);
+    }
+
+    void write(const value_type& v, const std::size_t i)
+    {
+        writeFields(v, i, std::index_sequence_for<Fields...>());
+    }
+
+    /// - synchronous read of every field of element i.  Stalls, see readAsync on the individual fields
+    value_type get(const std::size_t i) const
+    {
+        return readFields(i, std::index_sequence_for<Fields...>());
+    }
+
+    void removeUnordered(const std::size_t index)
+    {
+        removeSwapBack(index);
+    }
+
+    /// - see removeUnorderedPlan().  The plan only depends on the indices and the size, so every field moves the same elements
+    void removeUnordered(std::span<const std::size_t> indices)
+    {
+        forEachField([indices](auto& f) { f.removeUnordered(indices); });
+    }
+
+    void removeSwapBack(const std::size_t index)
+    {
+        forEachField([index](auto& f) { f.removeSwapBack(index); });
+    }
+
+    /// - every field writes through uploader, see GPUVector::setUploader
+    void setUploader(GPUUploadManager* uploader)
+    {
+        forEachField([uploader](auto& f) { f.setUploader(uploader); });
+    }
+
+    /// - GPUVector::flush on every field : staged writes and uploader copies reach the buffers
+    void flush()
+    {
+        forEachField([](auto& f) { f.flush(); });
+    }
+
+    /// - bind field I to an indexed buffer binding, eg. an SSBO of a compute pass
+    template <std::size_t I>
+    void bindField(GLuint binding, GLenum target = GL_SHADER_STORAGE_BUFFER)
+    {
+        field<I>().bind(target, binding);
+    }
+
+    /// - bind field i to binding firstBinding + i, for all fields
+    void bindFields(GLuint firstBinding, GLenum target = GL_SHADER_STORAGE_BUFFER)
+    {
+        GLuint binding = firstBinding;
+        forEachField([&](auto& f) { f.bind(target, binding++); });
+    }
+
+    /// - field i becomes vertex buffer binding firstBinding + i of vao, eg. a glSugar::Vao<Fields...> where each field declares its attributes with VAO_INIT.
+    /// - instanced sets a divisor of 1 on those bindings
+    template <typename VaoType>
+    void bindVertexBuffers(VaoType& vao, bool instanced = false, int firstBinding = 0)
+    {
+        int binding = firstBinding;
+
+        forEachField([&](auto& f)
+        {
+            using FieldVector = std::remove_reference_t<decltype(f)>;
+
+            vao.vertexBuffer(f.storage(), binding, int(sizeof(typename FieldVector::value_type)), int(f.StorageOffset()));
+            vao.Get().BindingDivisor(binding, instanced ? 1 : 0);
+
+            binding++;
+        });
+    }
+
+private:
+
+    std::tuple<GPUVector<Fields>...> fields;
+
+    template <typename Func>
+    void forEachField(Func&& f)
+    {
+        std::apply([&](auto&... field) { (f(field), ...); }, fields);
+    }
+
+    template <std::size_t ...I>
+    void pushBack(const value_type& v, std::index_sequence<I...>)
+    {
+        (std::get<I>(fields).push_back(std::get<I>(v)), ...);
+    }
+
+    template <std::size_t ...I, typename ...Spans>
+    void appendFields(std::index_sequence<I...>, Spans... values)
+    {
+        (std::get<I>(fields).append(values), ...);
+    }
+
+    template <std::size_t ...I>
+    void writeFields(const value_type& v, const std::size_t i, std::index_sequence<I...>)
+    {
+        (std::get<I>(fields).write(std::get<I>(v), i), ...);
+    }
+
+    template <std::size_t ...I>
+    value_type readFields(const std::size_t i, std::index_sequence<I...>) const
+    {
+        return value_type(std::get<I>(fields)[i]...);
+    }
+};
@@ -0,0 +1,365 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/// - opt-in GPU memory / traffic statistics for the containers, GPUUploadManager and texture uploads.  Enabled by defining GLSUGAR_TELEMETRY
+///   (cmake -DGLSUGAR_TELEMETRY=ON).  Without it GPUStats is an empty member and every recording call is an empty inline function, so it compiles away.
+/// - every container has a GPUStats (container.Stats()) feeding the process wide totals in GPUTelemetry::get().
+/// - GPUTelemetry::get().endFrame() once per frame snapshots the totals into a history, see ImguiRenderState::drawTelemetryPanel()
+
+#if defined(_MSC_VER)
+#define GLSUGAR_NO_UNIQUE_ADDRESS [[msvc::no_unique_address]]
+#else
+#define GLSUGAR_NO_UNIQUE_ADDRESS [[no_unique_address]]
+#endif
+
+struct GPUCounters
+{
+    // -- gauges : current values
+    std::int64_t deviceBytes = 0;       // buffer storage created with the driver
+    std::int64_t capacityBytes = 0;     // storage reserved by containers, which may be sub-allocated from a pool / heap
+    std::int64_t liveBytes = 0;         // elements in use
+
+    // -- traffic : totals, or per frame in snapshots
+    std::uint64_t allocations = 0;      // buffers created
+    std::uint64_t reallocations = 0;    // container growth / shrink_to_fit moving the data
+    std::uint64_t uploadBytes = 0;      // client -> server (SubData, flushed mapped ranges, staged copies)
+    std::uint64_t readbackBytes = 0;    // server -> client (GetSubData, readAsync)
+    std::uint64_t copyBytes = 0;        // server side CopySubData
+    std::uint64_t driverCalls = 0;      // buffer creation / data / copy / map calls made on behalf of the container
+
+    /// - traffic since an earlier snapshot, with our gauges
+    GPUCounters trafficSince(const GPUCounters& earlier) const
+    {
+        GPUCounters rval = *this;
+
+        rval.allocations -= earlier.allocations;
+        rval.reallocations -= earlier.reallocations;
+        rval.uploadBytes -= earlier.uploadBytes;
+        rval.readbackBytes -= earlier.readbackBytes;
+        rval.copyBytes -= earlier.copyBytes;
+        rval.driverCalls -= earlier.driverCalls;
+
+        return rval;
+    }
+};
+
+#ifdef GLSUGAR_TELEMETRY
+
+struct GPUStats;
+
+/// Process wide totals and per frame history
+struct GPUTelemetry
+{
+    constexpr static bool Enabled = true;
+    constexpr static std::size_t HistoryFrames = 240;
+
+    static GPUTelemetry& get()
+    {
+        static GPUTelemetry telemetry;
+        return telemetry;
+    }
+
+    /// - snapshot this frame's traffic (and the current gauges) into the history
+    void endFrame()
+    {
+        history[historyHead] = total.trafficSince(frameStart);
+        historyHead = (historyHead + 1) % HistoryFrames;
+        historyCount = std::min(historyCount + 1, HistoryFrames);
+
+        frameStart = total;
+        frameIndex++;
+    }
+
+    /// - gauges now, traffic since startup
+    const GPUCounters& Total() const
+    {
+        return total;
+    }
+
+    /// - traffic of the frame in progress
+    GPUCounters CurrentFrame() const
+    {
+        return total.trafficSince(frameStart);
+    }
+
+    std::size_t HistorySize() const
+    {
+        return historyCount;
+    }
+
+    /// - framesAgo = 0 is the last completed frame
+    const GPUCounters& History(std::size_t framesAgo) const
+    {
+        assert(framesAgo < historyCount);
+        return history[(historyHead + HistoryFrames - 1 - framesAgo) % HistoryFrames];
+    }
+
+    std::uint64_t FrameIndex() const
+    {
+        return frameIndex;
+    }
+
+    /// - instances given a name with GPUStats::setName
+    const std::vector<GPUStats*>& NamedInstances() const
+    {
+        return named;
+    }
+
+private:
+
+    friend struct GPUStats;
+
+    GPUCounters total;
+    GPUCounters frameStart;
+
+    std::array<GPUCounters, HistoryFrames> history;
+    std::size_t historyHead = 0;
+    std::size_t historyCount = 0;
+
+    std::uint64_t frameIndex = 0;
+
+    std::vector<GPUStats*> named;
+};
+
+/// Counters of one container, also added to the GPUTelemetry totals.  Gauges are taken back out of the totals when the container goes away
+struct GPUStats
+{
+    constexpr static bool Enabled = true;
+
+    GPUStats() = default;
+
+    GPUStats(const GPUStats&) = delete;
+    GPUStats& operator=(const GPUStats&) = delete;
+
+    // -- containers are moved around, the moved from one stops counting
+    GPUStats(GPUStats&& other) : counters(other.counters), frameStart(other.frameStart), lastFrame(other.lastFrame), frameIndex(other.frameIndex), name(std::move(other.name))
+    {
+        other.counters = GPUCounters();
+
+        if (!name.empty())
+        {
+            std::replace(global().named.begin(), global().named.end(), &other, this);
+        }
+    }
+
+    GPUStats& operator=(GPUStats&& other)
+    {
+        if (this != &other)
+        {
+            release();
+
+            counters = other.counters;
+            frameStart = other.frameStart;
+            lastFrame = other.lastFrame;
+            frameIndex = other.frameIndex;
+            name = std::move(other.name);
+
+            other.counters = GPUCounters();
+
+            if (!name.empty())
+            {
+                std::replace(global().named.begin(), global().named.end(), &other, this);
+            }
+        }
+
+        return *this;
+    }
+
+    ~GPUStats()
+    {
+        release();
+    }
+
+    /// - list the instance in GPUTelemetry::NamedInstances(), eg. for the ImGui panel
+    void setName(const std::string& nameIn)
+    {
+        if (name.empty() && !nameIn.empty())
+        {
+            global().named.push_back(this);
+        }
+        else if (!name.empty() && nameIn.empty())
+        {
+            std::erase(global().named, this);
+        }
+
+        name = nameIn;
+    }
+
+    const std::string& Name() const
+    {
+        return name;
+    }
+
+    void setDeviceBytes(std::size_t bytes)
+    {
+        setGauge(&GPUCounters::deviceBytes, bytes);
+    }
+
+    void setCapacityBytes(std::size_t bytes)
+    {
+        setGauge(&GPUCounters::capacityBytes, bytes);
+    }
+
+    void setLiveBytes(std::size_t bytes)
+    {
+        setGauge(&GPUCounters::liveBytes, bytes);
+    }
+
+    void allocation(std::size_t calls = 1u)
+    {
+        add(&GPUCounters::allocations, 1u, calls);
+    }
+
+    void reallocation()
+    {
+        add(&GPUCounters::reallocations, 1u, 0u);
+    }
+
+    void upload(std::size_t bytes, std::size_t calls = 1u)
+    {
+        add(&GPUCounters::uploadBytes, bytes, calls);
+    }
+
+    void readback(std::size_t bytes, std::size_t calls = 1u)
+    {
+        add(&GPUCounters::readbackBytes, bytes, calls);
+    }
+
+    void copy(std::size_t bytes, std::size_t calls = 1u)
+    {
+        add(&GPUCounters::copyBytes, bytes, calls);
+    }
+
+    void driverCalls(std::size_t calls)
+    {
+        add(&GPUCounters::driverCalls, 0u, calls);
+    }
+
+    /// - gauges now, traffic since the container was created
+    const GPUCounters& Total() const
+    {
+        return counters;
+    }
+
+    /// - traffic of the last completed frame
+    GPUCounters LastFrame() const
+    {
+        const std::uint64_t current = global().frameIndex;
+
+        if (frameIndex == current)
+        {
+            return lastFrame;
+        }
+
+        // -- nothing was recorded since, so the last completed frame either is the one in progress at the last record, or had no traffic
+        GPUCounters rval = (frameIndex + 1 == current) ? counters.trafficSince(frameStart) : counters.trafficSince(counters);
+        return rval;
+    }
+
+private:
+
+    GPUCounters counters;
+    GPUCounters frameStart;         // counters at the start of frameIndex
+    GPUCounters lastFrame;          // traffic of frameIndex - 1
+    std::uint64_t frameIndex = 0;
+
+    std::string name;
+
+    static GPUTelemetry& global()
+    {
+        return GPUTelemetry::get();
+    }
+
+    /// - per instance frames roll over lazily, on the first record of a new frame
+    void rollFrame()
+    {
+        const std::uint64_t current = global().frameIndex;
+
+        if (frameIndex != current)
+        {
+            lastFrame = (frameIndex + 1 == current) ? counters.trafficSince(frameStart) : counters.trafficSince(counters);
+            frameStart = counters;
+            frameIndex = current;
+        }
+    }
+
+    void setGauge(std::int64_t GPUCounters::* gauge, std::size_t bytes)
+    {
+        global().total.*gauge += std::int64_t(bytes) - counters.*gauge;
+        counters.*gauge = std::int64_t(bytes);
+    }
+
+    void add(std::uint64_t GPUCounters::* counter, std::size_t amount, std::size_t calls)
+    {
+        rollFrame();
+
+        counters.*counter += amount;
+        counters.driverCalls += calls;
+
+        global().total.*counter += amount;
+        global().total.driverCalls += calls;
+    }
+
+    void release()
+    {
+        setDeviceBytes(0u);
+        setCapacityBytes(0u);
+        setLiveBytes(0u);
+
+        if (!name.empty())
+        {
+            std::erase(global().named, this);
+            name.clear();
+        }
+    }
+};
+
+#else
+
+/// - telemetry compiled out : same interface, records nothing
+struct GPUTelemetry
+{
+    constexpr static bool Enabled = false;
+
+    static GPUTelemetry& get()
+    {
+        static GPUTelemetry telemetry;
+        return telemetry;
+    }
+
+    void endFrame() { }
+
+    GPUCounters Total() const { return {}; }
+    GPUCounters CurrentFrame() const { return {}; }
+    std::size_t HistorySize() const { return 0u; }
+    std::uint64_t FrameIndex() const { return 0u; }
+};
+
+struct GPUStats
+{
+    constexpr static bool Enabled = false;
+
+    void setName(const std::string&) { }
+
+    void setDeviceBytes(std::size_t) { }
+    void setCapacityBytes(std::size_t) { }
+    void setLiveBytes(std::size_t) { }
+
+    void allocation(std::size_t = 1u) { }
+    void reallocation() { }
+    void upload(std::size_t, std::size_t = 1u) { }
+    void readback(std::size_t, std::size_t = 1u) { }
+    void copy(std::size_t, std::size_t = 1u) { }
+    void driverCalls(std::size_t) { }
+
+    GPUCounters Total() const { return {}; }
+    GPUCounters LastFrame() const { return {}; }
+};
+
+#endif
@@ -0,0 +1,445 @@
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "GPUTelemetry.h"
+
+/// - one place for client -> server uploads.  Data is copied into a persistently mapped staging ring, and the copies into the
+///   destination buffers / textures are recorded and issued together by submit(), instead of the driver copying each SubData / SubImage call.
+/// - the ring is split into framesInFlight regions guarded by fences, like GPURingBuffer.  endFrame() submits and fences the current region.
+/// - an upload that doesn't fit the current region falls back to a direct SubData / SubImage, after submitting what is pending so writes stay in order.
+/// - destinations have to stay alive until the next submit().  Containers using a manager (setUploader()) submit it themselves before any
+///   server side copy / read of their storage; draws and dispatches reading them need a submit() first.
+struct GPUUploadManager
+{
+    constexpr static std::size_t DefaultBytesPerFrame = 8u << 20u;
+    constexpr static std::size_t DefaultFramesInFlight = 3u;
+
+    // use coherent map bit by default, without it submit() flushes the staged part of the region
+    constexpr static GLenum PersistentMappingDefaultFlags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+    // -- staging offsets of buffer copies, a multiple of every texel size for texture uploads
+    constexpr static std::size_t BufferAlignment = 4u;
+    constexpr static std::size_t TextureAlignment = 16u;
+
+    gl::Buffer buffer;
+
+    GPUUploadManager(std::size_t bytesPerFrame = DefaultBytesPerFrame, std::size_t framesInFlightIn = DefaultFramesInFlight, GLenum flags = PersistentMappingDefaultFlags) :
+        framesInFlight(framesInFlightIn),
+        regionBytes(alignUp(bytesPerFrame, TextureAlignment)),
+        mapFlags(flags),
+        fences(framesInFlightIn, nullptr)
+    {
+        assert(framesInFlight > 0);
+
+        if (!(mapFlags & GL_MAP_COHERENT_BIT))
+        {
+            mapFlags |= GL_MAP_FLUSH_EXPLICIT_BIT;
+        }
+
+        // -- storage flags can't contain the flush explicit bit
+        buffer.Storage(regionBytes * framesInFlight, nullptr, mapFlags & ~GL_MAP_FLUSH_EXPLICIT_BIT);
+
+        mappedPtr = (unsigned char*)buffer.MapRange(0, regionBytes * framesInFlight, mapFlags);
+        assert(mappedPtr != nullptr);
+
+        stats.allocation(2u);
+        stats.setDeviceBytes(CapacityBytes());
+    }
+
+    GPUUploadManager(const GPUUploadManager&) = delete;
+    GPUUploadManager& operator=(const GPUUploadManager&) = delete;
+
+    ~GPUUploadManager()
+    {
+        // -- copies still pending are dropped, their destinations may already be gone
+        for (GLsync& f : fences)
+        {
+            if (f) glDeleteSync(f);
+        }
+    }
+
+    /// - write bytes of data at dstOffset in dst.  Returns false if it didn't fit the ring and was written directly
+    bool stageBuffer(gl::Buffer& dst, std::size_t dstOffset, const void* data, std::size_t bytes)
+    {
+        if (!bytes) return true;
+
+        const std::size_t src = allocate(bytes, BufferAlignment);
+
+        if (src == NoSpace)
+        {
+            submit();
+            dst.SubData(dstOffset, bytes, data);
+            directBytes += bytes;
+
+            // -- the bytes are counted by the caller
+            stats.driverCalls(1u);
+            return false;
+        }
+
+        std::memcpy(mappedPtr + src, data, bytes);
+
+        // -- sequential writes into the same buffer (push_back, append, staged dirty ranges) become a single copy
+        if (!commands.empty())
+        {
+            Command& last = commands.back();
+
+            if (last.kind == Kind::Buffer && last.dst == dst.name() && last.srcOffset + last.bytes == src && last.dstOffset + last.bytes == dstOffset)
+            {
+                last.bytes += bytes;
+                return true;
+            }
+        }
+
+        Command c;
+        c.kind = Kind::Buffer;
+        c.dst = dst.name();
+        c.srcOffset = src;
+        c.dstOffset = dstOffset;
+        c.bytes = bytes;
+
+        commands.push_back(c);
+
+        return true;
+    }
+
+    /// - TextureSubImage2D through the ring, from a pixel unpack buffer.  pixels are laid out with rows aligned to unpackAlignment
+    bool stageTexture2D(gl::Texture& tex, GLint level, GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, const void* pixels, GLint unpackAlignment = 4)
+    {
+        return stageTexture(Kind::Texture2D, tex, level, x, y, 0, width, height, 1, format, type, pixels, unpackAlignment);
+    }
+
+    /// - TextureSubImage3D through the ring, eg. layers of an array texture or faces of a cube map (z = face)
+    bool stageTexture3D(gl::Texture& tex, GLint level, GLint x, GLint y, GLint z, GLsizei width, GLsizei height, GLsizei depth, GLenum format, GLenum type, const void* pixels, GLint unpackAlignment = 4)
+    {
+        return stageTexture(Kind::Texture3D, tex, level, x, y, z, width, height, depth, format, type, pixels, unpackAlignment);
+    }
+
+    /// - issue every recorded copy.  Call before the draws / dispatches that read the destinations.  Returns the number of copies issued
+    std::size_t submit()
+    {
+        if (commands.empty()) return 0u;
+
+        if ((mapFlags & GL_MAP_FLUSH_EXPLICIT_BIT) && cursor > flushedCursor)
+        {
+            buffer.FlushMappedRange(region * regionBytes + flushedCursor, cursor - flushedCursor);
+        }
+
+        flushedCursor = cursor;
+
+        GLint restoreAlignment = 0;
+        GLint currentAlignment = 0;
+
+        for (const Command& c : commands)
+        {
+            // -- the bytes were counted as uploads by the caller, this is the ring -> destination copy
+            stats.copy(c.bytes);
+
+            if (c.kind == Kind::Buffer)
+            {
+                glCopyNamedBufferSubData(buffer.name(), c.dst, GLintptr(c.srcOffset), GLintptr(c.dstOffset), GLsizeiptr(c.bytes));
+                continue;
+            }
+
+            // -- unpack state is only touched if there are texture uploads, and restored afterwards
+            if (!restoreAlignment)
+            {
+                restoreAlignment = gl::Get<GLint>(GL_UNPACK_ALIGNMENT);
+                currentAlignment = restoreAlignment;
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer.name());
+            }
+
+            if (c.unpackAlignment != currentAlignment)
+            {
+                glPixelStorei(GL_UNPACK_ALIGNMENT, c.unpackAlignment);
+                currentAlignment = c.unpackAlignment;
+            }
+
+            if (c.kind == Kind::Texture2D)
+            {
+                glTextureSubImage2D(c.dst, c.level, c.x, c.y, c.width, c.height, c.format, c.type, (const void*)c.srcOffset);
+            }
+            else
+            {
+                glTextureSubImage3D(c.dst, c.level, c.x, c.y, c.z, c.width, c.height, c.depth, c.format, c.type, (const void*)c.srcOffset);
+            }
+        }
+
+        if (restoreAlignment)
+        {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, restoreAlignment);
+        }
+
+        const std::size_t rval = commands.size();
+        submittedCommands += rval;
+        commands.clear();
+
+        return rval;
+    }
+
+    /// - submit, fence the current region and move on to the next one.  The next region is waited on when it is first written to
+    void endFrame()
+    {
+        submit();
+
+        if (regionReady)
+        {
+            assert(fences[region] == nullptr);
+            fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+            region = (region + 1) % framesInFlight;
+        }
+
+        regionReady = false;
+        cursor = 0;
+        flushedCursor = 0;
+    }
+
+    /// - bytes per pixel of client data in format / type, 0 for combinations the manager doesn't know (those are uploaded directly)
+    static std::size_t texelBytes(GLenum format, GLenum type)
+    {
+        std::size_t components = 0;
+
+        switch (format)
+        {
+        case GL_RED: case GL_GREEN: case GL_BLUE: case GL_RED_INTEGER: case GL_DEPTH_COMPONENT: case GL_STENCIL_INDEX:
+            components = 1; break;
+        case GL_RG: case GL_RG_INTEGER: case GL_DEPTH_STENCIL:
+            components = 2; break;
+        case GL_RGB: case GL_BGR: case GL_RGB_INTEGER: case GL_BGR_INTEGER:
+            components = 3; break;
+        case GL_RGBA: case GL_BGRA: case GL_RGBA_INTEGER: case GL_BGRA_INTEGER:
+            components = 4; break;
+        default:
+            return 0u;
+        }
+
+        switch (type)
+        {
+        case GL_UNSIGNED_BYTE: case GL_BYTE:
+            return components;
+        case GL_UNSIGNED_SHORT: case GL_SHORT: case GL_HALF_FLOAT:
+            return 2u * components;
+        case GL_UNSIGNED_INT: case GL_INT: case GL_FLOAT:
+            return 4u * components;
+
+        // -- packed types hold the whole pixel
+        case GL_UNSIGNED_BYTE_3_3_2: case GL_UNSIGNED_BYTE_2_3_3_REV:
+            return 1u;
+        case GL_UNSIGNED_SHORT_5_6_5: case GL_UNSIGNED_SHORT_5_6_5_REV: case GL_UNSIGNED_SHORT_4_4_4_4: case GL_UNSIGNED_SHORT_4_4_4_4_REV:
+        case GL_UNSIGNED_SHORT_5_5_5_1: case GL_UNSIGNED_SHORT_1_5_5_5_REV:
+            return 2u;
+        case GL_UNSIGNED_INT_8_8_8_8: case GL_UNSIGNED_INT_8_8_8_8_REV: case GL_UNSIGNED_INT_10_10_10_2: case GL_UNSIGNED_INT_2_10_10_10_REV:
+        case GL_UNSIGNED_INT_24_8: case GL_UNSIGNED_INT_10F_11F_11F_REV: case GL_UNSIGNED_INT_5_9_9_9_REV:
+            return 4u;
+        case GL_FLOAT_32_UNSIGNED_INT_24_8_REV:
+            return 8u;
+        default:
+            return 0u;
+        }
+    }
+
+    std::size_t CapacityPerFrameBytes() const
+    {
+        return regionBytes;
+    }
+
+    std::size_t CapacityBytes() const
+    {
+        return regionBytes * framesInFlight;
+    }
+
+    /// - bytes staged so far in the current frame, including alignment padding
+    std::size_t FrameBytesUsed() const
+    {
+        return cursor;
+    }
+
+    /// - copies recorded but not submitted yet
+    std::size_t PendingCount() const
+    {
+        return commands.size();
+    }
+
+    /// - copies issued by submit() since construction
+    std::size_t SubmittedCount() const
+    {
+        return submittedCommands;
+    }
+
+    /// - bytes that didn't fit the ring and went straight to the driver since construction.  Non zero means bytesPerFrame is too small
+    std::size_t DirectBytes() const
+    {
+        return directBytes;
+    }
+
+    /// - ring storage as device bytes, and the copies it issues.  See GPUTelemetry.h
+    GPUStats& Stats()
+    {
+        return stats;
+    }
+
+    const GPUStats& Stats() const
+    {
+        return stats;
+    }
+
+private:
+
+    enum class Kind
+    {
+        Buffer,
+        Texture2D,
+        Texture3D
+    };
+
+    struct Command
+    {
+        Kind kind = Kind::Buffer;
+        GLuint dst = 0;                 // buffer or texture name
+        std::size_t srcOffset = 0;      // in the ring buffer
+        std::size_t dstOffset = 0;      // buffer copies
+        std::size_t bytes = 0;
+
+        // -- texture uploads
+        GLint level = 0, x = 0, y = 0, z = 0;
+        GLsizei width = 0, height = 0, depth = 0;
+        GLenum format = 0, type = 0;
+        GLint unpackAlignment = 4;
+    };
+
+    constexpr static std::size_t NoSpace = ~std::size_t(0);
+
+    std::size_t framesInFlight;
+    std::size_t regionBytes;
+
+    unsigned char* mappedPtr = nullptr;
+    GLenum mapFlags = 0;
+
+    std::size_t region = 0;
+    std::size_t cursor = 0;         // bytes used in the current region
+    std::size_t flushedCursor = 0;  // non-coherent mappings : bytes of the current region already flushed
+    bool regionReady = false;       // the fence of the current region has been waited on
+
+    std::vector<GLsync> fences;
+    std::vector<Command> commands;
+
+    std::size_t submittedCommands = 0;
+    std::size_t directBytes = 0;
+
+    GLSUGAR_NO_UNIQUE_ADDRESS GPUStats stats;
+
+    static std::size_t alignUp(std::size_t bytes, std::size_t alignment)
+    {
+        return ((bytes + alignment - 1) / alignment) * alignment;
+    }
+
+    /// - offset in buffer of bytes free in the current region, or NoSpace
+    std::size_t allocate(std::size_t bytes, std::size_t alignment)
+    {
+        const std::size_t offset = alignUp(cursor, alignment);
+
+        if (offset + bytes > regionBytes)
+        {
+            return NoSpace;
+        }
+
+        if (!regionReady)
+        {
+            waitForRegion(region);
+            regionReady = true;
+        }
+
+        cursor = offset + bytes;
+
+        return region * regionBytes + offset;
+    }
+
+    bool stageTexture(Kind kind, gl::Texture& tex, GLint level, GLint x, GLint y, GLint z, GLsizei width, GLsizei height, GLsizei depth,
+        GLenum format, GLenum type, const void* pixels, GLint unpackAlignment)
+    {
+        if (width <= 0 || height <= 0 || depth <= 0) return true;
+
+        const std::size_t rowBytes = std::size_t(width) * texelBytes(format, type);
+        const std::size_t rowPitch = alignUp(rowBytes, std::size_t(unpackAlignment));
+
+        // -- the last row isn't padded
+        const std::size_t bytes = rowPitch * (std::size_t(height) * std::size_t(depth) - 1u) + rowBytes;
+
+        const std::size_t src = rowBytes ? allocate(bytes, TextureAlignment) : NoSpace;
+
+        if (src == NoSpace)
+        {
+            submit();
+
+            GLint restoreAlignment = gl::Get<GLint>(GL_UNPACK_ALIGNMENT);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, unpackAlignment);
+
+            if (kind == Kind::Texture2D)
+            {
+                tex.SubImage2D(level, x, y, width, height, format, type, pixels);
+            }
+            else
+            {
+                tex.SubImage3D(level, x, y, z, width, height, depth, format, type, pixels);
+            }
+
+            stats.driverCalls(1u);
+
+            glPixelStorei(GL_UNPACK_ALIGNMENT, restoreAlignment);
+
+            directBytes += bytes;
+            return false;
+        }
+
+        std::memcpy(mappedPtr + src, pixels, bytes);
+
+        Command c;
+        c.kind = kind;
+        c.dst = tex.name();
+        c.srcOffset = src;
+        c.bytes = bytes;
+        c.level = level;
+        c.x = x;
+        c.y = y;
+        c.z = z;
+        c.width = width;
+        c.height = height;
+        c.depth = depth;
+        c.format = format;
+        c.type = type;
+        c.unpackAlignment = unpackAlignment;
+
+        commands.push_back(c);
+
+        return true;
+    }
+
+    bool waitForRegion(std::size_t r)
+    {
+        GLsync& f = fences[r];
+
+        if (!f) return false;
+
+        bool blocked = false;
+
+        // -- first check is non blocking, if that doesn't succeed flush and wait
+        GLenum result = glClientWaitSync(f, 0, 0);
+
+        while (result == GL_TIMEOUT_EXPIRED)
+        {
+            blocked = true;
+            result = glClientWaitSync(f, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000); // 1ms
+        }
+
+        assert(result != GL_WAIT_FAILED);
+
+        glDeleteSync(f);
+        f = nullptr;
+
+        return blocked;
+    }
+};
@@ -1,10 +1,39 @@
 #pragma once
 
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "GPUBufferHeap.h"
+#include "GPUReadback.h"
+#include "GPUTelemetry.h"
+#include "GPUUploadManager.h"
+#include "RemoveUnorderedPlan.h"
+
+/// - mapping state of a GPUVector : empty unless the vector has the mapped interface
+template <typename T, bool MappedInterface>
+struct GPUVectorMapping
+{
+    T* ptr() const { return nullptr; }
+    bool explicitFlush() const { return false; }
+};
+
+template <typename T>
+struct GPUVectorMapping<T, true>
+{
+    T* mappedPtr = nullptr;
+    GLenum mapFlags = 0;
+
+    T* ptr() { return mappedPtr; }
+    bool explicitFlush() const { return mapFlags & GL_MAP_FLUSH_EXPLICIT_BIT; }
+};
+
 template <typename T, bool MappedInterface = false>
 struct GPUVector
 {
-    gl::Buffer buffer;
-
     using value_type = T;
 
     const static inline std::size_t DefaultCapacity = 64u;
@@ -14,9 +43,53 @@ struct GPUVector
 
     GPUVector(std::size_t capacityIn = DefaultCapacity, GLenum usageIn = MappedInterface ? PersistentMappingDefaultFlags : NonMappedCreationFlagsDefault) :
         capacity(capacityIn),
-        usage(usageIn)
+        usage(usageIn),
+        ownBuffer(std::make_unique<gl::Buffer>())
+    {
+        ownBuffer->Storage(capacity * sizeof(T), nullptr, usage);
+
+        stats.allocation();
+        stats.setDeviceBytes(CapacityBytes());
+        stats.setCapacityBytes(CapacityBytes());
+    }
+
+    /// - storage is sub-allocated from heapIn instead of owning a buffer : many vectors share a few buffers, see storage() / StorageOffset().  Can't be mapped
+    GPUVector(std::shared_ptr<GPUBufferHeap> heapIn, std::size_t capacityIn = DefaultCapacity) requires (!MappedInterface) :
+        capacity(capacityIn),
+        usage(heapIn->usage),
+        heapRange(std::move(heapIn), capacityIn * sizeof(T), false, sizeof(T))
+    {
+        // -- the heap's storage is the heap's device memory
+        stats.setCapacityBytes(CapacityBytes());
+    }
+
+    /// - the buffer holding the elements : the vector's own buffer, or a block of the heap.  Element 0 is at StorageOffset() bytes
+    gl::Buffer& storage()
+    {
+        return heapRange ? heapRange.buffer() : *ownBuffer;
+    }
+
+    const gl::Buffer& storage() const
     {
-        buffer.Storage(capacity * sizeof(T), nullptr, usage);
+        return heapRange ? heapRange.buffer() : *ownBuffer;
+    }
+
+    std::size_t StorageOffset() const
+    {
+        return heapRange ? heapRange.offset() : 0u;
+    }
+
+    /// - bind the whole capacity to an indexed binding (eg. GL_SHADER_STORAGE_BUFFER), at its offset in storage()
+    void bind(GLenum target, GLuint index) const
+    {
+        if (heapRange)
+        {
+            glBindBufferRange(target, index, storage().name(), GLintptr(StorageOffset()), GLsizeiptr(CapacityBytes()));
+        }
+        else
+        {
+            glBindBufferBase(target, index, ownBuffer->name());
+        }
     }
 
     void removeUnordered(const std::size_t index)
@@ -24,6 +97,40 @@ struct GPUVector
         removeSwapBack(index);
     }
 
+    /// - remove many elements at once, see removeUnorderedPlan().  Adjacent moves are merged into a single CopySubData
+    void removeUnordered(std::span<const std::size_t> indices)
+    {
+        std::size_t newSize = size;
+        std::vector<CopyRun> runs = removeUnorderedPlan(indices, size, newSize);
+
+        if (mirrored)
+        {
+            // -- the mirror is the source of truth, so the moves happen there and reach the buffer at the next flush()
+            for (const CopyRun& r : runs)
+            {
+                std::copy_n(mirror.begin() + r.src, r.count, mirror.begin() + r.dst);
+                trackWrite(r.dst, r.dst + r.count);
+            }
+
+            runs.clear();
+        }
+
+        if (!runs.empty() && hasPendingWrites())
+        {
+            // -- the copies below happen on the server, so they have to see any staged / unflushed writes
+            flush();
+        }
+
+        for (const CopyRun& r : runs)
+        {
+            storage().CopySubData(storage(), byteOffset(r.src), byteOffset(r.dst), r.count * sizeof(T));
+            stats.copy(r.count * sizeof(T));
+        }
+
+        size = newSize;
+        stats.setLiveBytes(SizeBytes());
+    }
+
     /// - remove element at index, swapping with last element to keep data tightly packed
     /// - side effect : order of the elements is changed
     void removeSwapBack(const std::size_t index)
@@ -33,26 +140,50 @@ struct GPUVector
 
         std::size_t last = size - 1;
 
-        if (index != last)
+        if (index != last && mirrored)
+        {
+            mirror[index] = mirror[last];
+            trackWrite(index, index + 1);
+        }
+        else if (index != last)
         {
+            // -- the copy below happens on the server, so it has to see any staged / unflushed writes
+            if (hasPendingWrites())
+            {
+                flush();
+            }
+
             // -- small buffer-buffer copy on gpu / server
-            buffer.CopySubData(buffer, last * sizeof(T), index * sizeof(T), sizeof(T));
+            storage().CopySubData(storage(), byteOffset(last), byteOffset(index), sizeof(T));
+            stats.copy(sizeof(T));
         }
 
         size -= 1;
+        stats.setLiveBytes(SizeBytes());
     }
 
     void clear()
     {
         size = 0;
+        dirtyRanges.clear();
+        stats.setLiveBytes(0u);
     }
 
     void shrink_to_fit()
     {
+        flush();
         capacity = size;
         reallocate();
     }
 
+    /// - set the element count without writing any data, eg. after a GPU pass filled the buffer.  New elements are uninitialized
+    void resize(std::size_t sizeIn)
+    {
+        reserve(sizeIn);
+        size = sizeIn;
+        stats.setLiveBytes(SizeBytes());
+    }
+
     void reserve(std::size_t capacityIn)
     {
         if (capacityIn > capacity)
@@ -66,44 +197,326 @@ struct GPUVector
     {
         if (size >= capacity)
         {
-            reserve(capacity * 2);
+            reserve(std::max<std::size_t>(capacity * 2, 1u));
             assert(size < capacity);
         }
 
         if (MappedInterface)
         {
-            _impl.ptr()[(size++)] = t;
+            clientPtr()[size] = t;
+            trackWrite(size, size + 1);
+            size++;
+        }
+        else if (staging)
+        {
+            stage(&t, 1, size++);
         }
         else
         {
-            buffer.SubData((size++) * sizeof(T), sizeof(T), &t);
+            upload(byteOffset(size++), sizeof(T), &t);
         }
+
+        stats.setLiveBytes(SizeBytes());
     }
 
-    template<typename = std::enable_if_t<MappedInterface == true>>
-    const T& operator[] (const std::size_t& i) const
+    /// - push a contiguous run of elements, growing at most once
+    /// - non-mapped + non-staging this is a single SubData call (or one staged copy, see setUploader) regardless of the element count
+    void append(std::span<const T> values)
     {
+        if (values.empty()) return;
+
+        const std::size_t newSize = size + values.size();
+
+        if (newSize > capacity)
+        {
+            reserve(std::max(capacity * 2, newSize));
+        }
+
+        if (MappedInterface)
+        {
+            std::copy(values.begin(), values.end(), clientPtr() + size);
+            trackWrite(size, newSize);
+        }
+        else if (staging)
+        {
+            stage(values.data(), values.size(), size);
+        }
+        else
+        {
+            upload(byteOffset(size), values.size_bytes(), values.data());
+        }
+
+        size = newSize;
+        stats.setLiveBytes(SizeBytes());
+    }
+
+    /// - replace the contents of the vector with values
+    void assign(std::span<const T> values)
+    {
+        clear();
+        append(values);
+    }
+
+    /// - staging mode : push_back / write / append go to a client side copy and only record dirty ranges.
+    /// - nothing reaches the buffer until flush(), which does one SubData per coalesced dirty range.
+    /// - disabling staging flushes any pending writes first.
+    void setStaging(bool enabled)
+    {
+        assert(!MappedInterface || !enabled);
+
+        if (!enabled)
+        {
+            flush();
+            stagingData.clear();
+            stagingData.shrink_to_fit();
+        }
+        else
+        {
+            stagingData.resize(capacity);
+        }
+
+        staging = enabled;
+    }
+
+    bool isStaging() const
+    {
+        return staging;
+    }
+
+    /// - mirror mode, mapped vectors only : a client side std::vector is the source of truth, so reads and read-modify-write loops hit cached memory
+    ///   instead of the (often uncached / write combined) mapping.  Writes mark fixed size blocks dirty, and flush() streams only the dirty blocks into the mapping.
+    /// - operator[] marks the element's block dirty, read through a const reference to avoid that.  The GPU must not write the buffer, see refreshMirror()
+    /// - enabling reads the mapping once.  Disabling flushes first
+    void setMirrored(bool enabled) requires MappedInterface
+    {
+        if (enabled == mirrored) return;
+
+        if (enabled)
+        {
+            mirror.assign(capacity, T());
+            dirtyBlocks.assign(mirrorBlockCount(capacity) / 64u + 1u, 0u);
+            mirrored = true;
+
+            refreshMirror();
+        }
+        else
+        {
+            flush();
+
+            mirrored = false;
+            mirror.clear();
+            mirror.shrink_to_fit();
+            dirtyBlocks.clear();
+        }
+    }
+
+    bool isMirrored() const
+    {
+        return mirrored;
+    }
+
+    /// - reload the mirror from the mapping, dropping unflushed mirror writes.  eg. after a GPU pass wrote the buffer (and it was fenced)
+    void refreshMirror() requires MappedInterface
+    {
+        assert(mirrored && _impl.mappedPtr != nullptr);
+
+        if (_impl.mapFlags & GL_MAP_READ_BIT)
+        {
+            std::copy(_impl.ptr(), _impl.ptr() + size, mirror.begin());
+        }
+        else if (size)
+        {
+            // -- write only mapping
+            ownBuffer->GetSubData(0u, SizeBytes(), mirror.data());
+        }
+
+        std::fill(dirtyBlocks.begin(), dirtyBlocks.end(), 0u);
+        mirrorDirty = false;
+
+        stats.readback(SizeBytes(), 0u);
+    }
+
+    /// - mirror mode : number of blocks the next flush() would write
+    std::size_t dirtyBlockCount() const
+    {
+        std::size_t rval = 0;
+
+        for (std::uint64_t w : dirtyBlocks)
+        {
+            rval += std::popcount(w);
+        }
+
+        return rval;
+    }
+
+    /// - upload all staged writes, or flush all tracked writes to a non-coherent mapping.  With an uploader its pending copies are submitted too.
+    /// - call once per frame before the buffer is used by the GPU.  Returns the number of bytes flushed
+    std::size_t flush()
+    {
+        std::size_t bytes = mirrorDirty ? flushMirror() : 0u;
+
+        for (const DirtyRange& r : dirtyRanges)
+        {
+            // -- removeSwapBack may have shrunk the vector past the end of a dirty range
+            const std::size_t last = std::min(r.second, size);
+
+            if (r.first < last)
+            {
+                const std::size_t rangeBytes = (last - r.first) * sizeof(T);
+
+                if (MappedInterface)
+                {
+                    ownBuffer->FlushMappedRange(r.first * sizeof(T), rangeBytes);
+                    stats.upload(rangeBytes);
+                }
+                else
+                {
+                    upload(byteOffset(r.first), rangeBytes, &stagingData[r.first]);
+                }
+
+                bytes += rangeBytes;
+            }
+        }
+
+        dirtyRanges.clear();
+
+        submitUploads();
+
+        return bytes;
+    }
+
+    /// - route writes (push_back / append / write / staged flushes) through uploader : they are copied into its staging ring and reach
+    ///   the buffer when it submits.  Server side operations on the vector submit it first.  nullptr writes with SubData directly.
+    /// - uploader has to outlive the vector, or be detached with setUploader(nullptr)
+    /// - heap backed vectors must use the heap's uploader (GPUBufferHeap::setUploader), so defragment() submits it before moving their data
+    void setUploader(GPUUploadManager* uploaderIn)
+    {
+        assert(!MappedInterface || !uploaderIn);
+        assert(!heapRange || !uploaderIn || uploaderIn == heapRange.Heap().Uploader());
+
+        submitUploads();
+        uploader = uploaderIn;
+    }
+
+    GPUUploadManager* Uploader() const
+    {
+        return uploader;
+    }
+
+    /// - number of SubData / FlushMappedRange calls the next flush() would make
+    std::size_t dirtyRangeCount() const
+    {
+        return dirtyRanges.size();
+    }
+
+    /// - non-coherent mappings : flush client writes so they are visible to the server.  One FlushMappedRange per coalesced dirty range
+    std::size_t flushWrites() requires MappedInterface
+    {
+        return flush();
+    }
+
+    /// - non-coherent mappings : record writes made through operator[] so flushWrites() picks them up.
+    /// - push_back / append / write are tracked automatically
+    void markWritten(const std::size_t first, const std::size_t count = 1) requires MappedInterface
+    {
+        assert(first + count <= size);
+        trackWrite(first, first + count);
+    }
+
+    const T& operator[] (const std::size_t& i) const requires MappedInterface
+    {
+        if (mirrored)
+        {
+            return mirror[i];
+        }
+
         assert(_impl.mappedPtr != nullptr);
         return _impl.mappedPtr[i];
     }
 
-    template<typename = std::enable_if_t<MappedInterface == true>>
-    T& operator[] (const std::size_t& i)
+    T& operator[] (const std::size_t& i) requires MappedInterface
     {
+        if (mirrored)
+        {
+            // -- assume the caller writes
+            markMirrorDirty(i, i + 1);
+            return mirror[i];
+        }
+
         assert(_impl.mappedPtr != nullptr);
         return _impl.mappedPtr[i];
     }
 
-    template<typename = std::enable_if_t<MappedInterface == false>>
-    T operator[] (const std::size_t& i) const
+    /// - where client writes go : the mapping, or the mirror.  Writes through it are not tracked, see markWritten()
+    T* data() requires MappedInterface
+    {
+        assert(mirrored || _impl.mappedPtr != nullptr);
+        return clientPtr();
+    }
+
+    T operator[] (const std::size_t& i) const requires (!MappedInterface)
     {
         assert(i < size);
 
+        if (staging && isDirty(i))
+        {
+            return stagingData[i];
+        }
+
+        submitUploads();
+
         T rval;
-        buffer.GetSubData(i * sizeof(T), sizeof(T), &rval);
+        storage().GetSubData(byteOffset(i), sizeof(T), &rval);
+        stats.readback(sizeof(T));
         return rval;
     }
 
+    /// - asynchronous readback of [first, first + count) : one server side copy into a readback buffer plus a fence.  Never stalls
+    GPUReadback<T> readAsync(const std::size_t first, const std::size_t count)
+    {
+        assert(first + count <= size);
+
+        // -- the copy happens on the server, so it has to see any staged / unflushed writes
+        if (hasPendingWrites())
+        {
+            flush();
+        }
+
+        GPUReadback<T> rval = readbacks.acquire<T>(count);
+
+        if (count)
+        {
+            storage().CopySubData(rval.buffer(), byteOffset(first), 0u, count * sizeof(T));
+            stats.readback(count * sizeof(T));
+        }
+
+        rval.submit();
+
+        return rval;
+    }
+
+    /// - synchronous readback of the whole vector with a single GetSubData
+    void copyTo(std::vector<T>& out)
+    {
+        out.resize(size);
+
+        if (!size) return;
+
+        if (MappedInterface)
+        {
+            std::copy(clientPtr(), clientPtr() + size, out.begin());
+            return;
+        }
+
+        if (hasPendingWrites())
+        {
+            flush();
+        }
+
+        storage().GetSubData(byteOffset(0u), SizeBytes(), out.data());
+        stats.readback(SizeBytes());
+    }
+
     //template<typename = std::enable_if_t<MappedInterface == false>>
     void write(const T& value, const std::size_t& i)
     {
@@ -111,30 +524,35 @@ struct GPUVector
 
         if (MappedInterface)
         {
-            _impl.ptr()[i] = value;
+            clientPtr()[i] = value;
+            trackWrite(i, i + 1);
+        }
+        else if (staging)
+        {
+            stage(&value, 1, i);
         }
         else
         {
-            buffer.SubData(i * sizeof(T), sizeof(T), &value);
+            upload(byteOffset(i), sizeof(T), &value);
         }
     }
 
-    template<typename = std::enable_if_t<MappedInterface>>
-    void map(GLenum flags = PersistentMappingDefaultFlags)
+    void map(GLenum flags = PersistentMappingDefaultFlags) requires MappedInterface
     {
         assert(_impl.mappedPtr == nullptr);
 
-        _impl.mappedPtr = (T*)buffer.MapRange(0, CapacityBytes(), flags);
+        _impl.mappedPtr = (T*)ownBuffer->MapRange(0, CapacityBytes(), flags);
+        stats.driverCalls(1u);
 
         assert(_impl.mappedPtr != nullptr);
         _impl.mapFlags = flags;
     }
 
-    template<typename = std::enable_if_t<MappedInterface>>
-    void unmap()
+    void unmap() requires MappedInterface
     {
         assert(_impl.mappedPtr != nullptr);
-        buffer.Unmap();
+        ownBuffer->Unmap();
+        stats.driverCalls(1u);
         _impl.mappedPtr = nullptr;
         _impl.mapFlags = 0;
     }
@@ -159,14 +577,212 @@ struct GPUVector
         return capacity * sizeof(T);
     }
 
+    /// - memory / traffic counters of this vector, see GPUTelemetry.h.  Empty unless GLSUGAR_TELEMETRY is defined
+    GPUStats& Stats()
+    {
+        return stats;
+    }
+
+    const GPUStats& Stats() const
+    {
+        return stats;
+    }
+
 private:
 
     std::size_t capacity = 0;
     std::size_t size = 0;
     const GLenum usage;
 
-    template<typename = std::enable_if_t<MappedInterface>>
-    bool remap()
+    std::unique_ptr<gl::Buffer> ownBuffer;  // storage unless allocated from a GPUBufferHeap, which then creates no buffer name
+    GPUHeapRange heapRange;                 // storage when allocated from a GPUBufferHeap
+    GPUReadbackRing readbacks;              // buffers of readAsync()
+
+    GLSUGAR_NO_UNIQUE_ADDRESS mutable GPUStats stats;  // mutable : reads count as traffic
+
+    std::size_t byteOffset(const std::size_t i) const
+    {
+        return StorageOffset() + i * sizeof(T);
+    }
+
+    using DirtyRange = std::pair<std::size_t, std::size_t>; // [first, last) in elements
+
+    bool staging = false;
+    std::vector<T> stagingData;             // client side copy, only valid inside dirtyRanges
+    std::vector<DirtyRange> dirtyRanges;    // sorted, non overlapping, non adjacent
+
+    GPUUploadManager* uploader = nullptr;
+    mutable bool uploadsPending = false;    // uploader holds copies into our storage
+
+    bool hasPendingWrites() const
+    {
+        return !dirtyRanges.empty() || uploadsPending || mirrorDirty;
+    }
+
+    // -- mirror mode, see setMirrored()
+    constexpr static std::size_t MirrorBlockBytes = 4096u;
+    constexpr static std::size_t MirrorBlockElements = std::max<std::size_t>(MirrorBlockBytes / sizeof(T), 1u);
+
+    bool mirrored = false;
+    bool mirrorDirty = false;
+    std::vector<T> mirror;                  // capacity elements, the source of truth
+    std::vector<std::uint64_t> dirtyBlocks; // one bit per MirrorBlockElements elements
+
+    static std::size_t mirrorBlockCount(const std::size_t elements)
+    {
+        return (elements + MirrorBlockElements - 1) / MirrorBlockElements;
+    }
+
+    /// - where the client reads / writes mapped vectors : the mirror, or the mapping
+    T* clientPtr()
+    {
+        return mirrored ? mirror.data() : _impl.ptr();
+    }
+
+    void markMirrorDirty(const std::size_t first, const std::size_t last)
+    {
+        for (std::size_t b = first / MirrorBlockElements; b * MirrorBlockElements < last; b++)
+        {
+            dirtyBlocks[b / 64u] |= std::uint64_t(1u) << (b % 64u);
+        }
+
+        mirrorDirty = true;
+    }
+
+    /// - copy each run of dirty blocks into the mapping with one sequential write, plus one FlushMappedRange for explicit flush mappings
+    std::size_t flushMirror()
+    {
+        assert(_impl.ptr() != nullptr);
+
+        std::size_t bytes = 0;
+        const std::size_t blocks = mirrorBlockCount(size);
+
+        auto dirty = [this](std::size_t b) { return (dirtyBlocks[b / 64u] >> (b % 64u)) & 1u; };
+
+        for (std::size_t b = 0; b < blocks;)
+        {
+            if (!dirtyBlocks[b / 64u])
+            {
+                b = (b / 64u + 1u) * 64u;
+                continue;
+            }
+
+            if (!dirty(b))
+            {
+                b++;
+                continue;
+            }
+
+            std::size_t e = b + 1;
+
+            while (e < blocks && dirty(e))
+            {
+                e++;
+            }
+
+            const std::size_t first = b * MirrorBlockElements;
+            const std::size_t last = std::min(e * MirrorBlockElements, size);
+
+            std::copy(mirror.begin() + first, mirror.begin() + last, _impl.ptr() + first);
+
+            const std::size_t runBytes = (last - first) * sizeof(T);
+
+            if (_impl.explicitFlush())
+            {
+                ownBuffer->FlushMappedRange(first * sizeof(T), runBytes);
+            }
+
+            stats.upload(runBytes, _impl.explicitFlush() ? 1u : 0u);
+            bytes += runBytes;
+
+            b = e;
+        }
+
+        std::fill(dirtyBlocks.begin(), dirtyBlocks.end(), 0u);
+        mirrorDirty = false;
+
+        return bytes;
+    }
+
+    void upload(const std::size_t offsetBytes, const std::size_t bytes, const void* data)
+    {
+        if (uploader)
+        {
+            uploadsPending |= uploader->stageBuffer(storage(), offsetBytes, data, bytes);
+
+            // -- the copy itself is the uploader's driver call
+            stats.upload(bytes, 0u);
+        }
+        else
+        {
+            storage().SubData(offsetBytes, bytes, data);
+            stats.upload(bytes);
+        }
+    }
+
+    void submitUploads() const
+    {
+        if (uploadsPending)
+        {
+            uploader->submit();
+            uploadsPending = false;
+        }
+    }
+
+    bool isDirty(const std::size_t i) const
+    {
+        auto it = std::upper_bound(dirtyRanges.begin(), dirtyRanges.end(), i,
+            [](std::size_t idx, const DirtyRange& r) { return idx < r.first; });
+
+        return it != dirtyRanges.begin() && i < std::prev(it)->second;
+    }
+
+    void stage(const T* values, const std::size_t count, const std::size_t first)
+    {
+        std::copy(values, values + count, stagingData.begin() + first);
+        markDirty(first, first + count);
+    }
+
+    void trackWrite(const std::size_t first, const std::size_t last)
+    {
+        if (mirrored)
+        {
+            markMirrorDirty(first, last);
+        }
+        // -- coherent mappings don't need any bookkeeping
+        else if (_impl.explicitFlush())
+        {
+            markDirty(first, last);
+        }
+    }
+
+    void markDirty(std::size_t first, std::size_t last)
+    {
+        // -- fast path : sequential push_back extends the last range
+        if (!dirtyRanges.empty() && dirtyRanges.back().second >= first && dirtyRanges.back().first <= first)
+        {
+            dirtyRanges.back().second = std::max(dirtyRanges.back().second, last);
+            return;
+        }
+
+        // -- merge with every range that overlaps or touches [first, last)
+        auto lo = std::lower_bound(dirtyRanges.begin(), dirtyRanges.end(), first,
+            [](const DirtyRange& r, std::size_t idx) { return r.second < idx; });
+
+        auto hi = lo;
+
+        while (hi != dirtyRanges.end() && hi->first <= last)
+        {
+            first = std::min(first, hi->first);
+            last = std::max(last, hi->second);
+            ++hi;
+        }
+
+        lo = dirtyRanges.erase(lo, hi);
+        dirtyRanges.insert(lo, { first, last });
+    }
+
+    bool remap() requires MappedInterface
     {
         if (_impl.mapFlags)
         {
@@ -178,17 +794,60 @@ private:
         return false;
     }
 
-    template<typename = std::enable_if_t<MappedInterface == false>>
-    void remap() { ; }
+    void remap() requires (!MappedInterface) { ; }
 
     void reallocate()
     {
+        // -- the copy below happens on the server, and the old storage may be freed
+        submitUploads();
+
+        if (heapRange)
+        {
+            // -- the heap moves the data if the range can't grow in place.  Staged data keeps its element offsets as below
+            heapRange.reallocate(CapacityBytes(), SizeBytes());
+
+            stats.reallocation();
+            stats.setCapacityBytes(CapacityBytes());
+
+            if (staging)
+            {
+                stagingData.resize(capacity);
+            }
+
+            return;
+        }
+
         gl::Buffer b;
 
         b.Storage(capacity * sizeof(T), nullptr, usage);
 
-        buffer.CopySubData(b, 0u, 0u, size * sizeof(T));
-        buffer = std::move(b);
+        if (MappedInterface)
+        {
+            // -- the copy below happens on the server, so unflushed client writes have to go first
+            flush();
+        }
+
+        ownBuffer->CopySubData(b, 0u, 0u, size * sizeof(T));
+        *ownBuffer = std::move(b);
+
+        stats.reallocation();
+        stats.allocation();
+        stats.copy(SizeBytes());
+        stats.setDeviceBytes(CapacityBytes());
+        stats.setCapacityBytes(CapacityBytes());
+
+        if (staging)
+        {
+            // -- staged data keeps its element offsets, so dirty ranges are still valid against the new buffer
+            stagingData.resize(capacity);
+        }
+
+        if (mirrored)
+        {
+            // -- flushed above, so the mirror and the new buffer agree
+            mirror.resize(capacity);
+            dirtyBlocks.resize(mirrorBlockCount(capacity) / 64u + 1u, 0u);
+        }
 
 #if _DEBUG
         //std::clog << "Reallocated bytes :" << SizeBytes() << std::endl;
@@ -196,22 +855,7 @@ private:
         remap();
     }
 
-    template <bool MappedInterface>
-    struct _Impl
-    {
-        T* ptr() const { return nullptr; }
-    };
-
-    template<>
-    struct _Impl<true>
-    {
-        T* mappedPtr = nullptr;
-        GLenum mapFlags = 0;
-
-        T* ptr() { return mappedPtr; }
-    };
-
-    using Impl = _Impl<MappedInterface>;
+    using Impl = GPUVectorMapping<T, MappedInterface>;
 
     Impl _impl;
 };
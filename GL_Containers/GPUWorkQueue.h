@@ -0,0 +1,283 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <span>
+#include <vector>
+
+#include "GPUReadback.h"
+#include "GPUTelemetry.h"
+#include "GPUVector.h"
+
+/// - append / consume queue between compute passes that never goes through the client : a producer pass pushes items with an atomicAdd on the header,
+///   prepareDispatch() turns the count into indirect dispatch arguments on the GPU, and dispatchIndirect() runs the consumer over exactly the pushed items.
+/// - items go to Items(), a GPUVector of fixed capacity.  Pushes past it are dropped but still counted, readCountAsync() tells how many without stalling.
+/// - the shader side protocol is in Shaders/WorkQueue/WorkQueue.glsl.  Chain passes with one queue per hop (cull -> bin -> shade), resetting each before
+///   its producer runs.  GPUWorkQueueCPU emulates the same counters and dispatch on the client, for tests
+
+/// - layout of the header buffer, matches WorkQueueHeader in WorkQueue.glsl
+struct WorkQueueHeader
+{
+    GLuint count;       // pushed items, including dropped ones
+    GLuint consumed;    // popped items
+    GLuint capacity;
+    GLuint size;        // min(count, capacity), written by prepareDispatch()
+    GLuint groups[3];   // glDispatchComputeIndirect arguments, written by prepareDispatch()
+    GLuint pad;
+};
+
+/// - built by the client from Shaders/WorkQueue/WorkQueueDispatchArgs.glsl with WorkQueue.glsl
+struct GPUWorkQueuePrograms
+{
+    gl::Program dispatchArgs;
+};
+
+template <typename T>
+struct GPUWorkQueue
+{
+    using value_type = T;
+
+    explicit GPUWorkQueue(std::size_t capacityIn = GPUVector<T>::DefaultCapacity, GLenum usageIn = GPUVector<T>::NonMappedCreationFlagsDefault) :
+        items(capacityIn, usageIn)
+    {
+        items.resize(capacityIn);
+
+        header.Storage(sizeof(WorkQueueHeader), nullptr, GL_DYNAMIC_STORAGE_BIT);
+        stats.allocation();
+        stats.setDeviceBytes(sizeof(WorkQueueHeader));
+
+        reset();
+    }
+
+    /// - empty the queue, before the pass that produces its items.  Also applies a capacity change from reserve()
+    void reset()
+    {
+        // -- the previous passes' atomics on the header have to land before the update overwrites it
+        glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+        const WorkQueueHeader h = { 0u, 0u, GLuint(Capacity()), 0u, { 0u, 1u, 1u }, 0u };
+        header.SubData(0u, sizeof(h), &h);
+        stats.upload(sizeof(h));
+    }
+
+    /// - grows Items(), takes effect at the next reset()
+    void reserve(std::size_t capacityIn)
+    {
+        items.resize(std::max(capacityIn, Capacity()));
+    }
+
+    /// - Items() as itemsBinding and the header as headerBinding, for the producer or the consumer
+    void bind(GLuint itemsBinding, GLuint headerBinding)
+    {
+        items.bind(GL_SHADER_STORAGE_BUFFER, itemsBinding);
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, headerBinding, header.name());
+    }
+
+    /// - after the producer : compute the size and dispatch arguments of a consumer with local_size_x == groupSize, on the GPU
+    void prepareDispatch(GPUWorkQueuePrograms& progs, GLuint groupSize)
+    {
+        glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, "Work Queue Dispatch Args");
+
+        // -- the producer's pushes
+        glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, header.name());
+        progs.dispatchArgs.Use();
+        progs.dispatchArgs.Uniform1<GLuint>("groupSize", groupSize);
+        glDispatchCompute(1, 1, 1);
+
+        // -- read next as dispatch arguments, by the consumer, or copied into draw commands
+        glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+        glPopDebugGroup();
+    }
+
+    /// - run the program in use over the items, one invocation per item, with the groups from prepareDispatch().  Bind the queue first
+    void dispatchIndirect()
+    {
+        glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, header.name());
+        glDispatchComputeIndirect(GLintptr(offsetof(WorkQueueHeader, groups)));
+        glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0);
+    }
+
+    /// - server side copy of the size from prepareDispatch() to dst at dstOffset bytes, eg. the count / instanceCount of an indirect draw
+    void copySizeTo(gl::Buffer& dst, std::size_t dstOffset)
+    {
+        header.CopySubData(dst, offsetof(WorkQueueHeader, size), dstOffset, sizeof(GLuint));
+        stats.copy(sizeof(GLuint));
+    }
+
+    /// - asynchronous readback of the header.  count > capacity means count - capacity pushes were dropped
+    GPUReadback<WorkQueueHeader> readHeaderAsync()
+    {
+        GPUReadback<WorkQueueHeader> rval = readbacks.acquire<WorkQueueHeader>(1u);
+        header.CopySubData(rval.buffer(), 0u, 0u, sizeof(WorkQueueHeader));
+        rval.submit();
+        stats.readback(sizeof(WorkQueueHeader));
+        return rval;
+    }
+
+    /// - asynchronous readback of the pushed count, dropped ones included
+    GPUReadback<GLuint> readCountAsync()
+    {
+        GPUReadback<GLuint> rval = readbacks.acquire<GLuint>(1u);
+        header.CopySubData(rval.buffer(), offsetof(WorkQueueHeader, count), 0u, sizeof(GLuint));
+        rval.submit();
+        stats.readback(sizeof(GLuint));
+        return rval;
+    }
+
+    GPUVector<T>& Items()
+    {
+        return items;
+    }
+
+    /// - the WorkQueueHeader, eg. to bind it to another binding point
+    gl::Buffer& Header()
+    {
+        return header;
+    }
+
+    std::size_t Capacity() const
+    {
+        return items.Size();
+    }
+
+    /// - counts the header traffic; Items() has its own Stats()
+    GPUStats& Stats()
+    {
+        return stats;
+    }
+
+    const GPUStats& Stats() const
+    {
+        return stats;
+    }
+
+private:
+
+    GPUVector<T> items;
+    gl::Buffer header;
+    GPUReadbackRing readbacks;      // buffers of readHeaderAsync() / readCountAsync()
+
+    GLSUGAR_NO_UNIQUE_ADDRESS GPUStats stats;
+};
+
+/*** CPU emulation ***/
+
+/// - same counters and dispatch rules as GPUWorkQueue + WorkQueue.glsl on the client, so a pipeline's kernels ported to C++ can be tested without a context.
+/// - push() / pop() are thread safe like their atomicAdd counterparts; dispatchIndirect() runs the kernel over the same invocations the GPU would
+template <typename T>
+struct GPUWorkQueueCPU
+{
+    using value_type = T;
+
+    explicit GPUWorkQueueCPU(std::size_t capacityIn = GPUVector<T>::DefaultCapacity) :
+        items(capacityIn)
+    {
+    }
+
+    void reset()
+    {
+        count = 0;
+        consumed = 0;
+        size = 0;
+        groups = 0;
+    }
+
+    void reserve(std::size_t capacityIn)
+    {
+        items.resize(std::max(capacityIn, Capacity()));
+    }
+
+    /// - WORK_QUEUE_PUSH + the capacity check.  Returns the slot, >= Capacity() when the item was dropped
+    std::size_t push(const T& item)
+    {
+        const std::size_t slot = count.fetch_add(1u);
+
+        if (slot < Capacity())
+        {
+            items[slot] = item;
+        }
+
+        return slot;
+    }
+
+    /// - WORK_QUEUE_POP : the next unconsumed item, false once every item is taken
+    bool pop(T& item)
+    {
+        const std::size_t slot = consumed.fetch_add(1u);
+
+        if (slot >= std::min(count.load(), Capacity())) return false;
+
+        item = items[slot];
+        return true;
+    }
+
+    /// - WorkQueueDispatchArgs.glsl
+    void prepareDispatch(std::size_t groupSize)
+    {
+        size = std::min(count.load(), Capacity());
+        groups = (size + groupSize - 1) / groupSize;
+        dispatchGroupSize = groupSize;
+    }
+
+    /// - kernel(invocation) for every invocation of groups * groupSize, like the GPU.  The kernel has to skip invocation >= Size() itself
+    template <typename Kernel>
+    void dispatchIndirect(Kernel&& kernel)
+    {
+        for (std::size_t i = 0; i < groups * dispatchGroupSize; i++)
+        {
+            kernel(i);
+        }
+    }
+
+    std::span<T> Items()
+    {
+        return items;
+    }
+
+    std::span<const T> Items() const
+    {
+        return items;
+    }
+
+    /// - pushed items, dropped ones included
+    std::size_t Count() const
+    {
+        return count.load();
+    }
+
+    /// - from the last prepareDispatch()
+    std::size_t Size() const
+    {
+        return size;
+    }
+
+    std::size_t Groups() const
+    {
+        return groups;
+    }
+
+    std::size_t Dropped() const
+    {
+        return Count() - std::min(Count(), Capacity());
+    }
+
+    std::size_t Capacity() const
+    {
+        return items.size();
+    }
+
+private:
+
+    std::vector<T> items;
+
+    std::atomic<std::size_t> count = 0;
+    std::atomic<std::size_t> consumed = 0;
+
+    std::size_t size = 0;
+    std::size_t groups = 0;
+    std::size_t dispatchGroupSize = 0;
+};
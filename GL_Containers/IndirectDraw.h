@@ -0,0 +1,194 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include "GPUVector.h"
+#include "GPUDeque.h"
+
+/// layout read by glMultiDrawArraysIndirect
+struct DrawArraysIndirectCommand
+{
+    GLuint count;
+    GLuint instanceCount;
+    GLuint first;
+    GLuint baseInstance;
+};
+
+/// layout read by glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand
+{
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+/// - indirect draw commands built from the live ranges of a GPUDeque, so the deque draws with one glMultiDraw*Indirect per backing buffer instead of a bind + draw per page.
+/// - give the deque a pool made with pagesPerArena > 1 (GPUDeque::makePagePool) and its pages share one backing buffer : one bind and one draw for the whole deque.
+/// - ranges that happen to be adjacent in the backing buffer are merged into one command.
+/// - Cmd is DrawArraysIndirectCommand or DrawElementsIndirectCommand
+template <typename Cmd>
+struct GPUIndirectDrawList
+{
+    /// commands [firstCommand, firstCommand + commandCount) all read from buffer
+    struct Batch
+    {
+        gl::Buffer* buffer;
+        std::size_t firstCommand;
+        std::size_t commandCount;
+    };
+
+    GPUVector<Cmd> commands;
+
+    /// - deque elements are the vertices : first / count of each command address the elements directly
+    template <typename T, bool Mapped, std::size_t MinPageSize>
+    void buildVertices(GPUDeque<T, Mapped, MinPageSize>& deque, GLuint instanceCount = 1u, GLuint baseInstance = 0u)
+    {
+        static_assert(std::is_same_v<Cmd, DrawArraysIndirectCommand>);
+
+        build(deque, [&](GLuint first, GLuint count)
+        {
+            return Cmd{ count, instanceCount, first, baseInstance };
+        });
+    }
+
+    /// - deque elements are per instance data : each command draws one instance per element, with baseInstance pointing at its first element.
+    /// - instanced attributes (divisor != 0) are offset by baseInstance automatically.  Shaders fetching from an SSBO use gl_BaseInstance + gl_InstanceID
+    /// - vertexCount / first are the index count / first index for DrawElementsIndirectCommand
+    template <typename T, bool Mapped, std::size_t MinPageSize>
+    void buildInstances(GPUDeque<T, Mapped, MinPageSize>& deque, GLuint vertexCount, GLuint first = 0u, GLint baseVertex = 0)
+    {
+        build(deque, [&](GLuint firstElement, GLuint count)
+        {
+            if constexpr (std::is_same_v<Cmd, DrawElementsIndirectCommand>)
+            {
+                return Cmd{ vertexCount, count, first, baseVertex, firstElement };
+            }
+            else
+            {
+                assert(baseVertex == 0);
+                return Cmd{ vertexCount, count, first, firstElement };
+            }
+        });
+    }
+
+    /// - makeCommand(first element in the backing buffer, element count) -> Cmd, called once per merged range
+    template <typename T, bool Mapped, std::size_t MinPageSize, typename Func>
+    void build(GPUDeque<T, Mapped, MinPageSize>& deque, Func&& makeCommand)
+    {
+        // -- group ranges by backing buffer, keeping deque order within each
+        struct Run
+        {
+            gl::Buffer* buffer;
+            std::size_t first;
+            std::size_t count;
+        };
+
+        std::vector<Run> runs;
+
+        for (auto range : deque.ranges())
+        {
+            if (!range.count) continue;
+            runs.push_back({ &range.buffer, range.firstElement(), range.count });
+        }
+
+        std::vector<gl::Buffer*> order;
+
+        for (const Run& r : runs)
+        {
+            if (std::find(order.begin(), order.end(), r.buffer) == order.end())
+            {
+                order.push_back(r.buffer);
+            }
+        }
+
+        std::stable_sort(runs.begin(), runs.end(), [&](const Run& a, const Run& b)
+        {
+            return std::find(order.begin(), order.end(), a.buffer) < std::find(order.begin(), order.end(), b.buffer);
+        });
+
+        std::vector<Cmd> cmds;
+        batches.clear();
+
+        for (std::size_t i = 0; i < runs.size();)
+        {
+            Batch batch = { runs[i].buffer, cmds.size(), 0u };
+
+            for (; i < runs.size() && runs[i].buffer == batch.buffer;)
+            {
+                std::size_t first = runs[i].first;
+                std::size_t count = runs[i].count;
+
+                // -- the pool hands out neighbouring slots, so consecutive pages are often back to back
+                for (i++; i < runs.size() && runs[i].buffer == batch.buffer && runs[i].first == first + count; i++)
+                {
+                    count += runs[i].count;
+                }
+
+                cmds.push_back(makeCommand(GLuint(first), GLuint(count)));
+                batch.commandCount++;
+            }
+
+            batches.push_back(batch);
+        }
+
+        commands.assign(cmds);
+    }
+
+    /// - one glMultiDrawArraysIndirect per batch.  bindBuffer(gl::Buffer&) binds the backing buffer for the draw, eg. as the vertex buffer of a vao
+    template <typename BindFunc>
+    void draw(GLenum mode, BindFunc&& bindBuffer)
+    {
+        static_assert(std::is_same_v<Cmd, DrawArraysIndirectCommand>);
+
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commands.storage().name());
+
+        for (const Batch& b : batches)
+        {
+            bindBuffer(*b.buffer);
+            glMultiDrawArraysIndirect(mode, (const void*)(b.firstCommand * sizeof(Cmd)), GLsizei(b.commandCount), 0);
+        }
+
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+
+    /// - one glMultiDrawElementsIndirect per batch, with the element buffer bound by the caller (eg. in the vao)
+    template <typename BindFunc>
+    void draw(GLenum mode, GLenum indexType, BindFunc&& bindBuffer)
+    {
+        static_assert(std::is_same_v<Cmd, DrawElementsIndirectCommand>);
+
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commands.storage().name());
+
+        for (const Batch& b : batches)
+        {
+            bindBuffer(*b.buffer);
+            glMultiDrawElementsIndirect(mode, indexType, (const void*)(b.firstCommand * sizeof(Cmd)), GLsizei(b.commandCount), 0);
+        }
+
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+
+    /// - number of commands built
+    std::size_t Size() const
+    {
+        return commands.Size();
+    }
+
+    /// - number of multi draw calls draw() will make.  1 when the whole deque lives in one backing buffer
+    std::size_t BatchCount() const
+    {
+        return batches.size();
+    }
+
+    const std::vector<Batch>& Batches() const
+    {
+        return batches;
+    }
+
+private:
+
+    std::vector<Batch> batches;
+};
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <algorithm>
+#include <span>
+#include <vector>
+
+/// One server side copy of count elements from src to dst (element indices)
+struct CopyRun
+{
+    std::size_t src;
+    std::size_t dst;
+    std::size_t count;
+};
+
+/// - CPU side plan for removing many elements at once with swap-back semantics.
+/// - indices are positions before the removal; duplicates are ignored.  The result matches calling removeSwapBack on each index in descending order.
+/// - returns the copies to perform, merged into as few runs as possible, and writes the new size to newSize.
+/// - every src is >= newSize and every dst is < newSize, so the copies never overlap and can run in any order.
+inline std::vector<CopyRun> removeUnorderedPlan(std::span<const std::size_t> indicesIn, const std::size_t size, std::size_t& newSize)
+{
+    std::vector<std::size_t> indices(indicesIn.begin(), indicesIn.end());
+    std::sort(indices.begin(), indices.end());
+    indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+
+    assert(indices.empty() || indices.back() < size);
+
+    newSize = size - indices.size();
+
+    // -- simulate swap-back in descending order.  Only removed slots are ever written, so track what
+    // -- each of them holds in a parallel array : the original index of the element moved there.
+    std::vector<std::size_t> holds(indices.size());
+
+    std::size_t n = size;
+
+    for (std::size_t k = indices.size(); k-- > 0;)
+    {
+        const std::size_t last = --n;
+
+        if (indices[k] != last)
+        {
+            // -- last is either untouched, or a removed slot we already filled
+            auto it = std::lower_bound(indices.begin() + k, indices.end(), last);
+            holds[k] = (it != indices.end() && *it == last) ? holds[it - indices.begin()] : last;
+        }
+    }
+
+    // -- removed slots below newSize are the holes left behind; everything else got popped
+    std::vector<CopyRun> runs;
+
+    for (std::size_t k = 0; k < indices.size() && indices[k] < newSize; k++)
+    {
+        const std::size_t dst = indices[k];
+        const std::size_t src = holds[k];
+
+        if (!runs.empty() && runs.back().dst + runs.back().count == dst && runs.back().src + runs.back().count == src)
+        {
+            runs.back().count++;
+        }
+        else
+        {
+            runs.push_back({ src, dst, 1u });
+        }
+    }
+
+    return runs;
+}
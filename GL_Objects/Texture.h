@@ -13,6 +13,8 @@ struct android_app;
 #include <functional>
 #include <assert.h>
 
+#include "GL_Containers/GPUUploadManager.h"
+
 namespace glSugar
 {
     /// Client side input data used to initialize a GL texture
@@ -92,6 +94,16 @@ namespace glSugar
     /// fills "tex" at miplevel "level" with data in "image"
     void fillTextureWithData(gl::Texture &tex, const TextureInputData &image, int level = 0);
 
+    /// texture upload traffic for GPUTelemetry, listed as "Textures".  Texture storage itself isn't tracked
+    inline GPUStats& textureStats();
+
+    /// as above, but the pixels are copied into uploader's staging ring and reach "tex" at uploader.submit().  "image" can be released right away
+    void fillTextureWithData(gl::Texture &tex, const TextureInputData &image, int level, GPUUploadManager &uploader);
+
+    /// cube map faces through uploader, see above
+    void fillCubeTextureWithFaceData(gl::Texture &tex, const TextureInputData *images, int level,
+                                     GPUUploadManager &uploader);
+
     /*** Include stb_image.h prior to this to enable these loaders ***/
 ///#ifdef STBI_INCLUDE_STB_IMAGE_H
     TextureInputData loadTextureDataFromFile(const std::string& filename);
@@ -237,6 +249,18 @@ namespace glSugar
         return shadowmap;
     }
 
+    inline GPUStats& textureStats()
+    {
+        static GPUStats stats = []
+        {
+            GPUStats s;
+            s.setName("Textures");
+            return s;
+        }();
+
+        return stats;
+    }
+
     /// fills a previously allocated texture level.
     ///\todo should make this an interface function to a fillTextureSubdataFromFile, eg, if we fill in a tile atlas
     inline void fillTextureWithData(gl::Texture &tex, const TextureInputData &img, int level)
@@ -245,9 +269,18 @@ namespace glSugar
         img.useUnpackAlignment();
 
         tex.SubImage2D(level, 0, 0, img.width, img.height, img.format, img.type, img.pixels);
+        textureStats().upload(std::size_t(img.width) * img.height * GPUUploadManager::texelBytes(img.format, img.type));
 
         glPixelStorei(GL_UNPACK_ALIGNMENT, unpackAlignment);
     }
+
+    inline void fillTextureWithData(gl::Texture &tex, const TextureInputData &img, int level, GPUUploadManager &uploader)
+    {
+        uploader.stageTexture2D(tex, level, 0, 0, img.width, img.height, img.format, img.type, img.pixels, img.unpackAlignment);
+
+        // -- the TextureSubImage2D is the uploader's driver call
+        textureStats().upload(std::size_t(img.width) * img.height * GPUUploadManager::texelBytes(img.format, img.type), 0u);
+    }
 } //namespace glSugar
 
 #endif
@@ -329,6 +362,7 @@ namespace glSugar
             */
 
             tex.SubImage3D(level, 0, 0, i, images[i].width, images[i].height, 1, images[i].format, images[i].type, images[i].pixels);
+            textureStats().upload(std::size_t(images[i].width) * images[i].height * GPUUploadManager::texelBytes(images[i].format, images[i].type));
 
             //tex.SubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, level, 0, 0, images[i].width, images[i].height, images[i].format, images[i].type, images[i].pixels);
 
@@ -346,6 +380,26 @@ namespace glSugar
         glPixelStorei(GL_UNPACK_ALIGNMENT, unpackAlignment);
     }
 
+    void fillCubeTextureWithFaceData(gl::Texture& tex, const TextureInputData* images, int level, GPUUploadManager& uploader)
+    {
+        for (int i = 0; i < 6; i++)
+        {
+            if (images[i].width != images[0].width || images[i].height != images[0].height)
+            {
+                throw std::runtime_error("Inputs for cubemap loader have mismatched dimensions");
+            }
+
+            if (images[i].width != images[i].height)
+            {
+                throw std::runtime_error("Cube map face inputs not square");
+            }
+
+            // -- faces are layers of the cube map for the DSA calls, same as SubImage3D above
+            uploader.stageTexture3D(tex, level, 0, 0, i, images[i].width, images[i].height, 1, images[i].format, images[i].type, images[i].pixels, images[i].unpackAlignment);
+            textureStats().upload(std::size_t(images[i].width) * images[i].height * GPUUploadManager::texelBytes(images[i].format, images[i].type), 0u);
+        }
+    }
+
     #ifdef STBI_INCLUDE_STB_IMAGE_H
 
     TextureInputData loadTextureDataFromMemory(const unsigned char* mem, std::size_t bufferSize, bool isHDR)
@@ -16,6 +16,7 @@
 #include <imgui.h>
 #include "GL_Objects/ShaderProgram.h"
 #include "GL_Objects/Texture.h"
+#include "GL_Containers/GPUTelemetry.h"
 #include <array>
 #include <string_view>
 
@@ -114,6 +115,9 @@ struct ImguiRenderState
     ImguiRenderState(const std::string_view& apiVersion = DEFAULT_API_VERSION);
     
     void renderGUI(ImDrawData* data);
+
+    /// GPU memory / traffic window from GPUTelemetry : totals, per frame history and the named containers.  Call between ImGui::NewFrame() and ImGui::Render()
+    void drawTelemetryPanel(bool* open = nullptr);
 };
 
 inline constexpr std::string_view imguiVert =
@@ -256,6 +260,85 @@ void ImguiRenderState::renderGUI(ImDrawData* data)
     glScissor(scissorBoxOld[0], scissorBoxOld[1], scissorBoxOld[2], scissorBoxOld[3]);
 }
 
+void ImguiRenderState::drawTelemetryPanel(bool* open)
+{
+    if (!ImGui::Begin("GPU Telemetry", open))
+    {
+        ImGui::End();
+        return;
+    }
+
+#ifdef GLSUGAR_TELEMETRY
+    const GPUTelemetry& telemetry = GPUTelemetry::get();
+    const GPUCounters& total = telemetry.Total();
+
+    const auto kb = [](auto bytes) { return double(bytes) / 1024.0; };
+
+    ImGui::Text("Device   %10.1f KB", kb(total.deviceBytes));
+    ImGui::Text("Capacity %10.1f KB", kb(total.capacityBytes));
+    ImGui::Text("Live     %10.1f KB", kb(total.liveBytes));
+
+    if (telemetry.HistorySize())
+    {
+        const GPUCounters& last = telemetry.History(0);
+
+        ImGui::Separator();
+        ImGui::Text("Last frame : upload %.1f KB  readback %.1f KB  copy %.1f KB", kb(last.uploadBytes), kb(last.readbackBytes), kb(last.copyBytes));
+        ImGui::Text("             %llu driver calls  %llu allocations  %llu reallocations",
+            (unsigned long long)last.driverCalls, (unsigned long long)last.allocations, (unsigned long long)last.reallocations);
+
+        // -- oldest first
+        std::array<float, GPUTelemetry::HistoryFrames> uploads;
+        std::array<float, GPUTelemetry::HistoryFrames> calls;
+
+        const int frames = int(telemetry.HistorySize());
+
+        for (int i = 0; i < frames; i++)
+        {
+            const GPUCounters& c = telemetry.History(frames - 1 - i);
+            uploads[i] = float(kb(c.uploadBytes));
+            calls[i] = float(c.driverCalls);
+        }
+
+        ImGui::PlotHistogram("upload KB", uploads.data(), frames, 0, nullptr, 0.0f, FLT_MAX, ImVec2(0, 60));
+        ImGui::PlotHistogram("driver calls", calls.data(), frames, 0, nullptr, 0.0f, FLT_MAX, ImVec2(0, 60));
+    }
+
+    if (!telemetry.NamedInstances().empty())
+    {
+        ImGui::Separator();
+
+        ImGui::Columns(6, "GPUTelemetryInstances");
+        ImGui::Text("Name"); ImGui::NextColumn();
+        ImGui::Text("Capacity KB"); ImGui::NextColumn();
+        ImGui::Text("Live KB"); ImGui::NextColumn();
+        ImGui::Text("Reallocs"); ImGui::NextColumn();
+        ImGui::Text("Upload KB/frame"); ImGui::NextColumn();
+        ImGui::Text("Calls/frame"); ImGui::NextColumn();
+        ImGui::Separator();
+
+        for (const GPUStats* stats : telemetry.NamedInstances())
+        {
+            const GPUCounters& c = stats->Total();
+            const GPUCounters frame = stats->LastFrame();
+
+            ImGui::Text("%s", stats->Name().c_str()); ImGui::NextColumn();
+            ImGui::Text("%.1f", kb(std::max(c.capacityBytes, c.deviceBytes))); ImGui::NextColumn();
+            ImGui::Text("%.1f", kb(c.liveBytes)); ImGui::NextColumn();
+            ImGui::Text("%llu", (unsigned long long)c.reallocations); ImGui::NextColumn();
+            ImGui::Text("%.1f", kb(frame.uploadBytes)); ImGui::NextColumn();
+            ImGui::Text("%llu", (unsigned long long)frame.driverCalls); ImGui::NextColumn();
+        }
+
+        ImGui::Columns(1);
+    }
+#else
+    ImGui::TextUnformatted("Built without GLSUGAR_TELEMETRY");
+#endif
+
+    ImGui::End();
+}
+
 ImguiRenderState::ImguiRenderState(const std::string_view& apiVersion)
     :
     imguiProg(glSugar::VertFragProgram(std::string(apiVersion).append(imguiVert), std::string(apiVersion).append(imguiFrag)))
@@ -0,0 +1,56 @@
+#version 450 core
+
+// -- test each instance's bounds against the frustum and append the survivors to their draw's range of visible : command c owns
+// -- visible[commands[c].baseInstance, + capacities[c]), and atomicAdd on its instanceCount picks the slot, so the command ends up drawing exactly the visible instances.
+// -- instances past a draw's capacity are dropped, and the atomicMin brings instanceCount back to the capacity once every overflowing add is done.
+// -- needs Shaders/Raytracing/FrustumIntersection.glsl, inserted after the #version line by the client
+
+layout(local_size_x=256, local_size_y=1, local_size_z=1) in;
+
+// -- DrawElementsIndirectCommand
+struct Command
+{
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint baseInstance;
+};
+
+layout(std430, binding = 0) readonly buffer BoundsBuffer { vec4 bounds[]; };     // spheres : center, radius.  boxes : aabbMin, aabbMax as two vec4s
+layout(std430, binding = 1) readonly buffer DrawIdBuffer { uint drawIds[]; };
+layout(std430, binding = 2) writeonly buffer VisibleBuffer { uint visible[]; };
+layout(std430, binding = 3) buffer CommandBuffer { Command commands[]; };
+layout(std430, binding = 4) readonly buffer CapacityBuffer { uint capacities[]; };
+
+uniform uint count;
+uniform bool boxes;             // bounds are aabbMin, aabbMax pairs instead of spheres
+uniform bool hasDrawIds;        // otherwise every instance belongs to command 0
+uniform vec4 planes[6];
+
+void main()
+{
+    const uint i = gl_GlobalInvocationID.x;
+
+    if (i >= count) return;
+
+    const bool inside = boxes ?
+        AABBInFrustum(planes, bounds[2u * i].xyz, bounds[2u * i + 1u].xyz) :
+        SphereInFrustum(planes, bounds[i]);
+
+    if (!inside) return;
+
+    const uint c = hasDrawIds ? drawIds[i] : 0u;
+
+    const uint capacity = capacities[c];
+    const uint slot = atomicAdd(commands[c].instanceCount, 1u);
+
+    if (slot < capacity)
+    {
+        visible[commands[c].baseInstance + slot] = i;
+    }
+    else
+    {
+        atomicMin(commands[c].instanceCount, capacity);
+    }
+}
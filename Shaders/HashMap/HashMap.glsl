@@ -0,0 +1,104 @@
+// -- open addressing hash table of uint keys to uint values, filled by GL_Containers/GPUHashMap.h.  Linear probing over a power of two slot count,
+// -- slot s is the (key, value) pair hashMapSlots[2s], hashMapSlots[2s + 1].
+// -- the table is bound to HASH_MAP_BINDING : define it before this file to move it off binding 0.
+// -- inserts only claim empty slots, so concurrent inserts of one key can't both succeed.  Erased slots stay tombstones until the host rehash()es.
+// -- a lookup racing an insert of the same key may see the old value : insert and look up in separate passes, with a barrier in between
+
+#ifndef HASH_MAP_BINDING
+#define HASH_MAP_BINDING 0
+#endif
+
+const uint HashMapEmpty = 0xFFFFFFFFu;
+const uint HashMapTombstone = 0xFFFFFFFEu;
+const uint HashMapNotFound = 0xFFFFFFFFu;
+
+layout(std430, binding = HASH_MAP_BINDING) buffer HashMapBuffer { uint hashMapSlots[]; };
+
+uint hashMapSlotMask()
+{
+    return uint(hashMapSlots.length()) / 2u - 1u;
+}
+
+// -- must match GPUHashMapCPU::hash()
+uint hashMapHash(uint key)
+{
+    key ^= key >> 16;
+    key *= 0x7feb352du;
+    key ^= key >> 15;
+    key *= 0x846ca68bu;
+    key ^= key >> 16;
+    return key;
+}
+
+// -- insert key or overwrite its value.  false when every slot is taken
+bool hashMapInsert(uint key, uint value)
+{
+    const uint mask = hashMapSlotMask();
+    uint slot = hashMapHash(key) & mask;
+
+    for (uint probe = 0u; probe <= mask; probe++)
+    {
+        const uint prev = atomicCompSwap(hashMapSlots[2u * slot], HashMapEmpty, key);
+
+        if (prev == HashMapEmpty || prev == key)
+        {
+            atomicExchange(hashMapSlots[2u * slot + 1u], value);
+            return true;
+        }
+
+        slot = (slot + 1u) & mask;
+    }
+
+    return false;
+}
+
+// -- false when key isn't in the table, value is left untouched then
+bool hashMapFind(uint key, inout uint value)
+{
+    const uint mask = hashMapSlotMask();
+    uint slot = hashMapHash(key) & mask;
+
+    for (uint probe = 0u; probe <= mask; probe++)
+    {
+        const uint k = hashMapSlots[2u * slot];
+
+        if (k == key)
+        {
+            value = hashMapSlots[2u * slot + 1u];
+            return true;
+        }
+
+        if (k == HashMapEmpty) return false;
+
+        slot = (slot + 1u) & mask;
+    }
+
+    return false;
+}
+
+// -- value of key, or HashMapNotFound.  A stored value with the same bits (int -1) looks missing : use hashMapFind() when values can take it
+uint hashMapLookup(uint key)
+{
+    uint value = HashMapNotFound;
+    hashMapFind(key, value);
+    return value;
+}
+
+// -- false when key isn't in the table
+bool hashMapErase(uint key)
+{
+    const uint mask = hashMapSlotMask();
+    uint slot = hashMapHash(key) & mask;
+
+    for (uint probe = 0u; probe <= mask; probe++)
+    {
+        const uint k = hashMapSlots[2u * slot];
+
+        if (k == key) return atomicCompSwap(hashMapSlots[2u * slot], key, HashMapTombstone) == key;
+        if (k == HashMapEmpty) return false;
+
+        slot = (slot + 1u) & mask;
+    }
+
+    return false;
+}
@@ -0,0 +1,19 @@
+#version 450 core
+
+// -- erase keys[i] for i < count.  Missing keys are ignored.
+// -- needs Shaders/HashMap/HashMap.glsl, inserted after the #version line by the client.  The table is binding 0
+
+layout(local_size_x=256, local_size_y=1, local_size_z=1) in;
+
+layout(std430, binding = 1) readonly buffer KeyBuffer { uint keys[]; };
+
+uniform uint count;
+
+void main()
+{
+    const uint i = gl_GlobalInvocationID.x;
+
+    if (i >= count) return;
+
+    hashMapErase(keys[i]);
+}
@@ -0,0 +1,20 @@
+#version 450 core
+
+// -- insert keys[i] -> values[i] for i < count.  Duplicate keys in one batch keep one of their values.
+// -- needs Shaders/HashMap/HashMap.glsl, inserted after the #version line by the client.  The table is binding 0
+
+layout(local_size_x=256, local_size_y=1, local_size_z=1) in;
+
+layout(std430, binding = 1) readonly buffer KeyBuffer { uint keys[]; };
+layout(std430, binding = 2) readonly buffer ValueBuffer { uint values[]; };
+
+uniform uint count;
+
+void main()
+{
+    const uint i = gl_GlobalInvocationID.x;
+
+    if (i >= count) return;
+
+    hashMapInsert(keys[i], values[i]);
+}
@@ -0,0 +1,31 @@
+#version 450 core
+
+// -- values[i] = value of keys[i] for i < count, HashMapNotFound (0xFFFFFFFF) when missing.
+// -- with hasFound, found[i] = 1 when keys[i] is in the table and 0 otherwise, for tables whose values can have the HashMapNotFound bits.
+// -- needs Shaders/HashMap/HashMap.glsl, inserted after the #version line by the client.  The table is binding 0
+
+layout(local_size_x=256, local_size_y=1, local_size_z=1) in;
+
+layout(std430, binding = 1) readonly buffer KeyBuffer { uint keys[]; };
+layout(std430, binding = 2) writeonly buffer ValueBuffer { uint values[]; };
+layout(std430, binding = 3) writeonly buffer FoundBuffer { uint found[]; };
+
+uniform uint count;
+uniform bool hasFound;
+
+void main()
+{
+    const uint i = gl_GlobalInvocationID.x;
+
+    if (i >= count) return;
+
+    uint value = HashMapNotFound;
+    const bool hit = hashMapFind(keys[i], value);
+
+    values[i] = value;
+
+    if (hasFound)
+    {
+        found[i] = hit ? 1u : 0u;
+    }
+}
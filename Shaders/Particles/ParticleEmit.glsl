@@ -0,0 +1,77 @@
+#version 450 core
+
+// -- append emitCount new particles to back.  Each one is seeded from seed + its index, the same way glSugar::EmitParticlesCPU() does.
+// -- particles that don't fit in capacity are dropped; ParticleFinalize.glsl clamps the count afterwards.
+// -- Particle must match glSugar::Particle in Algorithms/ParticleSystem.h
+
+layout(local_size_x=256, local_size_y=1, local_size_z=1) in;
+
+struct Particle
+{
+    vec3 position;
+    float age;
+    vec3 velocity;
+    float lifetime;
+    vec4 color;
+};
+
+layout(std430, binding = 1) writeonly buffer BackBuffer { Particle back[]; };
+layout(std430, binding = 2) buffer CounterBuffer { uint counts[]; };
+
+uniform uint backSlot;
+uniform uint capacity;
+uniform uint emitCount;
+uniform uint seed;
+uniform vec3 position;
+uniform float radius;
+uniform vec3 velocity;
+uniform float velocitySpread;
+uniform vec4 color;
+uniform float lifetimeMin;
+uniform float lifetimeMax;
+
+// -- PCG hash, matches glSugar::particleHash()
+uint particleHash(uint v)
+{
+    const uint state = v * 747796405u + 2891336453u;
+    const uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+float random01(inout uint state)
+{
+    state = particleHash(state);
+    return float(state >> 8u) * (1.0 / 16777216.0);
+}
+
+// -- uniformly distributed direction
+vec3 randomDirection(inout uint state)
+{
+    const float z = random01(state) * 2.0 - 1.0;
+    const float phi = random01(state) * 6.28318530718;
+    const float r = sqrt(max(0.0, 1.0 - z * z));
+    return vec3(r * cos(phi), r * sin(phi), z);
+}
+
+void main()
+{
+    const uint i = gl_GlobalInvocationID.x;
+
+    if (i >= emitCount) return;
+
+    uint state = particleHash(seed + i);
+
+    Particle p;
+    p.position = position + randomDirection(state) * (radius * random01(state));
+    p.velocity = velocity + randomDirection(state) * (velocitySpread * random01(state));
+    p.age = 0.0;
+    p.lifetime = mix(lifetimeMin, lifetimeMax, random01(state));
+    p.color = color;
+
+    const uint dst = atomicAdd(counts[backSlot], 1u);
+
+    if (dst < capacity)
+    {
+        back[dst] = p;
+    }
+}
@@ -0,0 +1,39 @@
+#version 450 core
+
+// -- single thread run after a step : clamp the back count to capacity (emission may overshoot), then write the indirect commands for it.
+// -- commands layout matches glSugar::ParticleIndirectCommands : dispatch for the next ParticleSimulate.glsl, glDrawArraysIndirect, glDrawElementsIndirect
+
+layout(local_size_x=1, local_size_y=1, local_size_z=1) in;
+
+layout(std430, binding = 2) buffer CounterBuffer { uint counts[]; };
+layout(std430, binding = 5) writeonly buffer CommandBuffer { uint commands[]; };
+
+uniform uint backSlot;
+uniform uint capacity;
+
+const uint GroupSize = 256u;    // local_size_x of ParticleSimulate.glsl
+
+void main()
+{
+    const uint count = min(counts[backSlot], capacity);
+    counts[backSlot] = count;
+
+    // -- DispatchIndirectCommand
+    commands[0] = (count + GroupSize - 1u) / GroupSize;
+    commands[1] = 1u;
+    commands[2] = 1u;
+    commands[3] = 0u;
+
+    // -- DrawArraysIndirectCommand : count, instanceCount, first, baseInstance
+    commands[4] = count;
+    commands[5] = 1u;
+    commands[6] = 0u;
+    commands[7] = 0u;
+
+    // -- DrawElementsIndirectCommand : count, instanceCount, firstIndex, baseVertex, baseInstance
+    commands[8] = count;
+    commands[9] = 1u;
+    commands[10] = 0u;
+    commands[11] = 0u;
+    commands[12] = 0u;
+}
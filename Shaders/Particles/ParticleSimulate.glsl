@@ -0,0 +1,89 @@
+#version 450 core
+
+// -- one simulation step of every live particle in front : age, integrate gravity and drag, collide with planes and spheres, then append the survivors to back.
+// -- appending with atomicAdd on the back count compacts out the dead particles as we go, so the order of the particles is not kept.
+// -- dispatched indirectly with the group count ParticleFinalize.glsl wrote for front, so the client never needs the live count.
+// -- Particle must match glSugar::Particle in Algorithms/ParticleSystem.h
+
+layout(local_size_x=256, local_size_y=1, local_size_z=1) in;
+
+struct Particle
+{
+    vec3 position;
+    float age;
+    vec3 velocity;
+    float lifetime;
+    vec4 color;
+};
+
+layout(std430, binding = 0) readonly buffer FrontBuffer { Particle front[]; };
+layout(std430, binding = 1) writeonly buffer BackBuffer { Particle back[]; };
+layout(std430, binding = 2) buffer CounterBuffer { uint counts[]; };
+layout(std430, binding = 3) readonly buffer PlaneBuffer { vec4 planes[]; };     // xyz normal, w distance : dot(normal, p) + w >= 0 is outside
+layout(std430, binding = 4) readonly buffer SphereBuffer { vec4 spheres[]; };   // xyz center, w radius
+
+uniform uint frontSlot;
+uniform uint backSlot;
+uniform float dt;
+uniform vec3 gravity;
+uniform float drag;
+uniform float restitution;
+uniform float friction;
+uniform uint planeCount;
+uniform uint sphereCount;
+
+// -- reflect the normal part of the velocity with restitution, damp the tangential part with friction.  Only when moving into the surface
+void bounce(inout vec3 velocity, vec3 n)
+{
+    const float vn = dot(velocity, n);
+
+    if (vn < 0.0)
+    {
+        const vec3 vt = velocity - n * vn;
+        velocity = vt * (1.0 - friction) - n * (vn * restitution);
+    }
+}
+
+void main()
+{
+    const uint i = gl_GlobalInvocationID.x;
+
+    if (i >= counts[frontSlot]) return;
+
+    Particle p = front[i];
+
+    p.age += dt;
+
+    if (p.age >= p.lifetime) return;
+
+    p.velocity += gravity * dt;
+    p.velocity *= max(0.0, 1.0 - drag * dt);
+    p.position += p.velocity * dt;
+
+    for (uint c = 0u; c < planeCount; c++)
+    {
+        const vec3 n = planes[c].xyz;
+        const float d = dot(n, p.position) + planes[c].w;
+
+        if (d < 0.0)
+        {
+            p.position -= n * d;
+            bounce(p.velocity, n);
+        }
+    }
+
+    for (uint c = 0u; c < sphereCount; c++)
+    {
+        const vec3 toP = p.position - spheres[c].xyz;
+        const float dist = length(toP);
+
+        if (dist < spheres[c].w && dist > 0.0)
+        {
+            const vec3 n = toP / dist;
+            p.position = spheres[c].xyz + n * spheres[c].w;
+            bounce(p.velocity, n);
+        }
+    }
+
+    back[atomicAdd(counts[backSlot], 1u)] = p;
+}
@@ -0,0 +1,33 @@
+#version 450 core
+
+// -- back to front sort keys of front for glSugar::RadixSortIndices : keys[i] is the key of particle i, and slots past the live count get the largest key so they sort last.
+// -- needs backToFrontSortKey() from Shaders/RadixSort/SortKey.glsl, inserted after the #version line by the client
+// -- Particle must match glSugar::Particle in Algorithms/ParticleSystem.h
+
+layout(local_size_x=256, local_size_y=1, local_size_z=1) in;
+
+struct Particle
+{
+    vec3 position;
+    float age;
+    vec3 velocity;
+    float lifetime;
+    vec4 color;
+};
+
+layout(std430, binding = 0) readonly buffer FrontBuffer { Particle front[]; };
+layout(std430, binding = 1) writeonly buffer KeyBuffer { uint keys[]; };
+layout(std430, binding = 2) readonly buffer CounterBuffer { uint counts[]; };
+
+uniform uint frontSlot;
+uniform uint count;     // keys to write : the client side upper bound of the live count
+uniform vec3 eye;
+
+void main()
+{
+    const uint i = gl_GlobalInvocationID.x;
+
+    if (i >= count) return;
+
+    keys[i] = (i < counts[frontSlot]) ? backToFrontSortKey(distance(front[i].position, eye)) : 0xFFFFFFFFu;
+}
@@ -0,0 +1,42 @@
+#version 450 core
+
+// -- per workgroup count of each 4 bit digit of the keys at bit shift.
+// -- written digit major, histograms[digit * blockCount + block], so one exclusive scan of the whole array gives every block its scatter offset for each digit
+
+layout(local_size_x=256, local_size_y=1, local_size_z=1) in;
+
+layout(std430, binding = 0) readonly buffer KeyBuffer { uint keys[]; };
+layout(std430, binding = 1) writeonly buffer HistogramBuffer { uint histograms[]; };
+
+uniform uint count;
+uniform uint shift;
+uniform uint blockCount;
+
+const uint RadixDigits = 16u;
+
+shared uint localCounts[RadixDigits];
+
+void main()
+{
+    const uint gid = gl_GlobalInvocationID.x;
+    const uint lid = gl_LocalInvocationID.x;
+
+    if (lid < RadixDigits)
+    {
+        localCounts[lid] = 0u;
+    }
+
+    barrier();
+
+    if (gid < count)
+    {
+        atomicAdd(localCounts[(keys[gid] >> shift) & (RadixDigits - 1u)], 1u);
+    }
+
+    barrier();
+
+    if (lid < RadixDigits)
+    {
+        histograms[lid * blockCount + gl_WorkGroupID.x] = localCounts[lid];
+    }
+}
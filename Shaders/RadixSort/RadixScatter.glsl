@@ -0,0 +1,80 @@
+#version 450 core
+
+// -- stable scatter of one 4 bit digit pass.  Each key goes to offsets[digit * blockCount + block] (the scanned histograms) plus its rank among the keys of the block with the same digit.
+// -- ranks come from a prefix sum over 16 counters per thread, packed two 16 bit counters per uint.
+// -- values (eg. particle indices) move with their keys.  iotaValues writes each key's original index instead of reading valuesIn
+
+layout(local_size_x=256, local_size_y=1, local_size_z=1) in;
+
+layout(std430, binding = 0) readonly buffer KeyInBuffer { uint keysIn[]; };
+layout(std430, binding = 1) writeonly buffer KeyOutBuffer { uint keysOut[]; };
+layout(std430, binding = 2) readonly buffer ValueInBuffer { uint valuesIn[]; };
+layout(std430, binding = 3) writeonly buffer ValueOutBuffer { uint valuesOut[]; };
+layout(std430, binding = 4) readonly buffer OffsetBuffer { uint offsets[]; };
+
+uniform uint count;
+uniform uint shift;
+uniform uint blockCount;
+uniform bool hasValues;
+uniform bool iotaValues;
+
+const uint RadixDigits = 16u;
+const uint CounterWords = RadixDigits / 2u;
+
+shared uint counters[gl_WorkGroupSize.x][CounterWords];
+
+void main()
+{
+    const uint gid = gl_GlobalInvocationID.x;
+    const uint lid = gl_LocalInvocationID.x;
+
+    const bool valid = gid < count;
+    const uint key = valid ? keysIn[gid] : 0u;
+    const uint digit = (key >> shift) & (RadixDigits - 1u);
+    const uint word = digit >> 1u;
+    const uint bitOffset = (digit & 1u) * 16u;
+
+    for (uint w = 0u; w < CounterWords; w++)
+    {
+        counters[lid][w] = 0u;
+    }
+
+    if (valid)
+    {
+        counters[lid][word] = 1u << bitOffset;
+    }
+
+    barrier();
+
+    // Hillis-Steele inclusive scan of all 16 counters at once.  Counts never exceed 256, so the 16 bit halves can't carry into each other
+    for (uint offset = 1u; offset < gl_WorkGroupSize.x; offset <<= 1u)
+    {
+        uint add[CounterWords];
+
+        for (uint w = 0u; w < CounterWords; w++)
+        {
+            add[w] = lid >= offset ? counters[lid - offset][w] : 0u;
+        }
+
+        barrier();
+
+        for (uint w = 0u; w < CounterWords; w++)
+        {
+            counters[lid][w] += add[w];
+        }
+
+        barrier();
+    }
+
+    if (!valid) return;
+
+    const uint rank = ((counters[lid][word] >> bitOffset) & 0xFFFFu) - 1u;
+    const uint dst = offsets[digit * blockCount + gl_WorkGroupID.x] + rank;
+
+    keysOut[dst] = key;
+
+    if (hasValues)
+    {
+        valuesOut[dst] = iotaValues ? gid : valuesIn[gid];
+    }
+}
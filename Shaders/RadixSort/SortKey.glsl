@@ -0,0 +1,12 @@
+// -- map a float to a uint whose unsigned order matches the float order, for RadixSort keys
+uint floatToSortKey(float f)
+{
+    uint u = floatBitsToUint(f);
+    return (u & 0x80000000u) != 0u ? ~u : (u | 0x80000000u);
+}
+
+// -- key for sorting back to front (largest view distance first) with an ascending sort
+uint backToFrontSortKey(float viewDistance)
+{
+    return ~floatToSortKey(viewDistance);
+}
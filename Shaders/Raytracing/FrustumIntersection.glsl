@@ -0,0 +1,25 @@
+// frustum as 6 planes : xyz inward facing unit normal, w distance, so dot(plane.xyz, p) + plane.w >= 0 is inside
+// spheres are position, radius encoded as a vec4 and boxes are aabbMin / aabbMax, as in the ray intersections
+
+bool SphereInFrustum(vec4 planes[6], vec4 sphere)
+{
+    for (int i = 0; i < 6; i++)
+    {
+        if (dot(planes[i].xyz, sphere.xyz) + planes[i].w < -sphere.w) return false;
+    }
+
+    return true;
+}
+
+// -- conservative : tests the corner furthest along each plane normal, so boxes near a frustum corner may pass
+bool AABBInFrustum(vec4 planes[6], vec3 aabbMin, vec3 aabbMax)
+{
+    for (int i = 0; i < 6; i++)
+    {
+        vec3 p = mix(aabbMin, aabbMax, step(vec3(0.0), planes[i].xyz));
+
+        if (dot(planes[i].xyz, p) + planes[i].w < 0.0) return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,15 @@
+// -- resolve a GPUSlotMap handle (GL_Containers/GPUSlotMap.h) : handle is uvec2(index, generation), slot is Slots()[handle.x].
+// -- returns the element's index in Dense(), or SlotMapInvalid when the handle is stale.  Check handle.x < slots.length() first for untrusted handles
+
+struct SlotMapSlot
+{
+    uint dense;
+    uint generation;
+};
+
+const uint SlotMapInvalid = 0xFFFFFFFFu;
+
+uint slotMapResolve(uvec2 handle, SlotMapSlot slot)
+{
+    return slot.generation == handle.y ? slot.dense : SlotMapInvalid;
+}
@@ -0,0 +1,47 @@
+#version 450 core
+
+// -- scatter elements whose flag is set to their exclusive-scanned offset in dst.
+// -- elements are copied as elementWords uints, so element size must be a multiple of 4 bytes.
+// -- the thread owning the last element writes the surviving count to counters[counterIndex], eg. the instanceCount of an indirect draw.
+// -- flags / offsets are indexed by logical element (flagStart + i), src by buffer element (srcStart + i), so a paged container can be compacted one page per dispatch.
+
+layout(local_size_x=256, local_size_y=1, local_size_z=1) in;
+
+layout(std430, binding = 0) readonly buffer SrcBuffer { uint src[]; };
+layout(std430, binding = 1) writeonly buffer DstBuffer { uint dst[]; };
+layout(std430, binding = 2) readonly buffer FlagBuffer { uint flags[]; };
+layout(std430, binding = 3) readonly buffer OffsetBuffer { uint offsets[]; };
+layout(std430, binding = 4) buffer CounterBuffer { uint counters[]; };
+
+uniform uint count;
+uniform uint srcStart;
+uniform uint flagStart;
+uniform uint totalCount;
+uniform uint elementWords;
+uniform uint counterIndex;
+
+void main()
+{
+    const uint i = gl_GlobalInvocationID.x;
+
+    if (i >= count) return;
+
+    const uint f = flagStart + i;
+    const bool keep = flags[f] != 0u;
+
+    if (keep)
+    {
+        const uint dstBase = offsets[f] * elementWords;
+        const uint srcBase = (srcStart + i) * elementWords;
+
+        for (uint w = 0u; w < elementWords; w++)
+        {
+            dst[dstBase + w] = src[srcBase + w];
+        }
+    }
+
+    if (f == totalCount - 1u)
+    {
+        counters[counterIndex] = offsets[f] + (keep ? 1u : 0u);
+    }
+}
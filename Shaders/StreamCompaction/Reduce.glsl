@@ -0,0 +1,38 @@
+#version 450 core
+
+// -- sum of uints.  Each workgroup reduces its block in shared memory and atomically adds the total to dataOut[outOffset]
+
+layout(local_size_x=256, local_size_y=1, local_size_z=1) in;
+
+layout(std430, binding = 0) readonly buffer InputBuffer { uint dataIn[]; };
+layout(std430, binding = 1) buffer OutputBuffer { uint dataOut[]; };
+
+uniform uint count;
+uniform uint inOffset;
+uniform uint outOffset;
+
+shared uint partial[gl_WorkGroupSize.x];
+
+void main()
+{
+    const uint gid = gl_GlobalInvocationID.x;
+    const uint lid = gl_LocalInvocationID.x;
+
+    partial[lid] = gid < count ? dataIn[inOffset + gid] : 0u;
+    barrier();
+
+    for (uint stride = gl_WorkGroupSize.x >> 1u; stride > 0u; stride >>= 1u)
+    {
+        if (lid < stride)
+        {
+            partial[lid] += partial[lid + stride];
+        }
+
+        barrier();
+    }
+
+    if (lid == 0u)
+    {
+        atomicAdd(dataOut[outOffset], partial[0]);
+    }
+}
@@ -0,0 +1,21 @@
+#version 450 core
+
+// -- second half of a multi level scan : add the exclusive scan of the block totals to every element of the block
+
+layout(local_size_x=256, local_size_y=1, local_size_z=1) in;
+
+layout(std430, binding = 1) buffer OutputBuffer { uint dataOut[]; };
+layout(std430, binding = 2) readonly buffer BlockSumBuffer { uint blockSums[]; };
+
+uniform uint count;
+uniform uint outOffset;
+
+void main()
+{
+    const uint gid = gl_GlobalInvocationID.x;
+
+    if (gid < count)
+    {
+        dataOut[outOffset + gid] += blockSums[gl_WorkGroupID.x];
+    }
+}
@@ -0,0 +1,54 @@
+#version 450 core
+
+// -- per workgroup prefix sum over uints.  Writes the workgroup total to blockSums so the host can scan those and add them back (ScanAddBlockSums)
+// -- in and out may be the same buffer
+// -- countNonZero scans (value != 0) instead of value : the offsets of a compaction, whose flags may be any non zero value
+
+layout(local_size_x=256, local_size_y=1, local_size_z=1) in;
+
+layout(std430, binding = 0) readonly buffer InputBuffer { uint dataIn[]; };
+layout(std430, binding = 1) writeonly buffer OutputBuffer { uint dataOut[]; };
+layout(std430, binding = 2) writeonly buffer BlockSumBuffer { uint blockSums[]; };
+
+uniform uint count;
+uniform uint inOffset;
+uniform uint outOffset;
+uniform bool inclusive;
+uniform bool countNonZero;
+
+shared uint temp[gl_WorkGroupSize.x];
+
+void main()
+{
+    const uint gid = gl_GlobalInvocationID.x;
+    const uint lid = gl_LocalInvocationID.x;
+
+    uint value = gid < count ? dataIn[inOffset + gid] : 0u;
+
+    if (countNonZero)
+    {
+        value = value != 0u ? 1u : 0u;
+    }
+
+    temp[lid] = value;
+    barrier();
+
+    // Hillis-Steele inclusive scan in shared memory
+    for (uint offset = 1u; offset < gl_WorkGroupSize.x; offset <<= 1u)
+    {
+        uint add = lid >= offset ? temp[lid - offset] : 0u;
+        barrier();
+        temp[lid] += add;
+        barrier();
+    }
+
+    if (gid < count)
+    {
+        dataOut[outOffset + gid] = inclusive ? temp[lid] : temp[lid] - value;
+    }
+
+    if (lid == gl_WorkGroupSize.x - 1u)
+    {
+        blockSums[gl_WorkGroupID.x] = temp[lid];
+    }
+}
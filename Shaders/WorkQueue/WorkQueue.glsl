@@ -0,0 +1,24 @@
+// -- header of a GPUWorkQueue (GL_Containers/GPUWorkQueue.h).  The items live in a separate buffer of the caller's type.
+// -- declare it as   layout(std430, binding = N) buffer OutQueueHeader { WorkQueueHeader outQueue; };
+// -- push    : const uint slot = WORK_QUEUE_PUSH(outQueue, 1u);  if (slot < outQueue.capacity) items[slot] = item;
+// --           count keeps counting past capacity, so the host sees how many items were dropped
+// -- consume : dispatched indirectly with groups[] from WorkQueueDispatchArgs.glsl, invocation i handles item i when i < workQueueSize(inQueue).
+// --           persistent threads can WORK_QUEUE_POP(inQueue) instead, which hands out each index once until it reaches workQueueSize()
+
+struct WorkQueueHeader
+{
+    uint count;         // pushed items, including dropped ones
+    uint consumed;      // popped items
+    uint capacity;      // items buffer size
+    uint size;          // min(count, capacity), written by WorkQueueDispatchArgs.glsl
+    uint groups[3];     // glDispatchComputeIndirect arguments, written by WorkQueueDispatchArgs.glsl
+    uint pad;
+};
+
+#define WORK_QUEUE_PUSH(queue, n) atomicAdd(queue.count, n)
+#define WORK_QUEUE_POP(queue) atomicAdd(queue.consumed, 1u)
+
+uint workQueueSize(WorkQueueHeader queue)
+{
+    return min(queue.count, queue.capacity);
+}
@@ -0,0 +1,20 @@
+#version 450 core
+
+// -- turn the item count of a queue into the arguments of the indirect dispatch that consumes it, one invocation per item.
+// -- needs Shaders/WorkQueue/WorkQueue.glsl, inserted after the #version line by the client
+
+layout(local_size_x=1, local_size_y=1, local_size_z=1) in;
+
+layout(std430, binding = 0) buffer QueueHeader { WorkQueueHeader queue; };
+
+uniform uint groupSize;     // local_size_x of the consuming shader
+
+void main()
+{
+    const uint size = workQueueSize(queue);
+
+    queue.size = size;
+    queue.groups[0] = (size + groupSize - 1u) / groupSize;
+    queue.groups[1] = 1u;
+    queue.groups[2] = 1u;
+}
@@ -0,0 +1,206 @@
+/// Frustum / FrustumCullCPU() against known outputs, and GPUFrustumCuller against FrustumCullCPU().
+
+#include "Tests/TestHarness.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "GL_Containers/GPUContainers.h"
+#include "Algorithms/FrustumCulling.h"
+
+namespace
+{
+    using namespace glSugar;
+    using namespace glSugar::test;
+
+    constexpr float Identity[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+
+    /// - looking down -z, 90 degree fov, near 1, far 100
+    Frustum perspective()
+    {
+        const float n = 1.f;
+        const float f = 100.f;
+        const float m[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, -(f + n) / (f - n), -1, 0, 0, -2.f * f * n / (f - n), 0 };
+        return Frustum::fromMatrix(m);
+    }
+
+    void testCPU()
+    {
+        // -- the identity's frustum is the [-1, 1] cube
+        const Frustum cube = Frustum::fromMatrix(Identity);
+        const float expected[6][4] = { { 1, 0, 0, 1 }, { -1, 0, 0, 1 }, { 0, 1, 0, 1 }, { 0, -1, 0, 1 }, { 0, 0, 1, 1 }, { 0, 0, -1, 1 } };
+
+        for (int p = 0; p < 6; p++)
+        {
+            GLSUGAR_CHECK(std::equal(cube.planes[p], cube.planes[p] + 4, expected[p]));
+        }
+
+        GLSUGAR_CHECK(cube.contains(BoundingSphere{ { 0.f, 0.f, 0.f }, 0.1f }));
+        GLSUGAR_CHECK(cube.contains(BoundingSphere{ { 1.5f, 0.f, 0.f }, 0.6f }));     // straddles x = 1
+        GLSUGAR_CHECK(!cube.contains(BoundingSphere{ { 1.5f, 0.f, 0.f }, 0.4f }));
+        GLSUGAR_CHECK(!cube.contains(BoundingSphere{ { 0.f, 0.f, -3.f }, 1.f }));
+
+        GLSUGAR_CHECK(cube.contains(BoundingBox{ { 0.9f, 0.9f, 0.9f }, 0.f, { 2.f, 2.f, 2.f }, 0.f }));
+        GLSUGAR_CHECK(!cube.contains(BoundingBox{ { 1.1f, -0.5f, -0.5f }, 0.f, { 2.f, 0.5f, 0.5f }, 0.f }));
+        GLSUGAR_CHECK(cube.contains(BoundingBox{ { -5.f, -5.f, -5.f }, 0.f, { 5.f, 5.f, 5.f }, 0.f }));
+
+        // -- in front, behind the camera, past the far plane, off to the side
+        const Frustum view = perspective();
+        const std::vector<BoundingSphere> spheres =
+        {
+            { { 0.f, 0.f, -10.f }, 1.f },
+            { { 0.f, 0.f, 10.f }, 1.f },
+            { { 0.f, 0.f, -200.f }, 1.f },
+            { { 50.f, 0.f, -10.f }, 1.f },
+            { { 1.f, 1.f, -5.f }, 0.5f },
+        };
+
+        const std::vector<GLuint> drawIds = { 1, 0, 1, 0, 0 };
+
+        GLSUGAR_CHECK(FrustumCullCPU<BoundingSphere>(spheres, view, 1u) == std::vector<std::vector<GLuint>>({ { 0, 4 } }));
+        GLSUGAR_CHECK(FrustumCullCPU<BoundingSphere>(spheres, view, 2u, drawIds) == std::vector<std::vector<GLuint>>({ { 4 }, { 0 } }));
+    }
+
+    struct Scene
+    {
+        std::vector<BoundingSphere> spheres;
+        std::vector<BoundingBox> boxes;
+        std::vector<GLuint> drawIds;
+        std::vector<DrawElementsIndirectCommand> draws = { { 36, 0, 0, 0, 0 }, { 12, 0, 36, 0, 0 }, { 6, 0, 48, 0, 0 } };
+
+        explicit Scene(std::size_t n)
+        {
+            std::mt19937 rng(3);
+            std::uniform_real_distribution<float> position(-120.f, 120.f);
+            std::uniform_real_distribution<float> radius(0.1f, 5.f);
+
+            for (std::size_t i = 0; i < n; i++)
+            {
+                const float c[3] = { position(rng), position(rng), position(rng) };
+                const float r = radius(rng);
+
+                spheres.push_back({ { c[0], c[1], c[2] }, r });
+                boxes.push_back({ { c[0] - r, c[1] - r, c[2] - r }, 0.f, { c[0] + r, c[1] + r, c[2] + r }, 0.f });
+                drawIds.push_back(GLuint(i % 3));
+                draws[i % 3].instanceCount++;
+            }
+        }
+    };
+
+    /// - every draw holds a subset of the reference's instances, capacity of them when more are visible
+    void checkCulled(GPUFrustumCuller& culler, const std::vector<std::vector<GLuint>>& expected, std::span<const DrawElementsIndirectCommand> draws)
+    {
+        std::vector<DrawElementsIndirectCommand> commands;
+        std::vector<GLuint> visible;
+        culler.Commands().copyTo(commands);
+        culler.Visible().copyTo(visible);
+
+        GLSUGAR_CHECK(commands.size() == expected.size());
+
+        for (std::size_t c = 0; c < std::min(commands.size(), expected.size()); c++)
+        {
+            const std::size_t want = std::min<std::size_t>(expected[c].size(), draws[c].instanceCount);
+
+            GLSUGAR_CHECK(commands[c].instanceCount == want);
+            GLSUGAR_CHECK(commands[c].count == draws[c].count && commands[c].firstIndex == draws[c].firstIndex);
+
+            if (commands[c].baseInstance + commands[c].instanceCount > visible.size()) continue;
+
+            std::vector<GLuint> got(visible.begin() + commands[c].baseInstance, visible.begin() + commands[c].baseInstance + commands[c].instanceCount);
+            std::sort(got.begin(), got.end());
+
+            if (want == expected[c].size())
+            {
+                GLSUGAR_CHECK(got == expected[c]);
+            }
+            else
+            {
+                GLSUGAR_CHECK(std::adjacent_find(got.begin(), got.end()) == got.end());
+                GLSUGAR_CHECK(std::includes(expected[c].begin(), expected[c].end(), got.begin(), got.end()));
+            }
+        }
+    }
+
+    void testGPU()
+    {
+        FrustumCullPrograms progs = { computeProgram("Shaders/Culling/FrustumCull.glsl", { "Shaders/Raytracing/FrustumIntersection.glsl" }) };
+
+        const Frustum view = perspective();
+        const Scene scene(200000u);
+
+        const auto expectedSpheres = FrustumCullCPU<BoundingSphere>(scene.spheres, view, 3u, scene.drawIds);
+        const auto expectedBoxes = FrustumCullCPU<BoundingBox>(scene.boxes, view, 3u, scene.drawIds);
+
+        GPUVector<BoundingSphere> spheres;
+        spheres.assign(scene.spheres);
+
+        GPUVector<BoundingBox> boxes;
+        boxes.assign(scene.boxes);
+
+        GPUVector<GLuint> drawIds;
+        drawIds.assign(scene.drawIds);
+
+        GPUFrustumCuller culler;
+        culler.setDraws(scene.draws);
+
+        // -- twice each, the second cull starts from the reset commands
+        for (int repeat = 0; repeat < 2; repeat++)
+        {
+            culler.cull(progs, spheres, view, &drawIds);
+            checkCulled(culler, expectedSpheres, scene.draws);
+
+            culler.cull(progs, boxes, view, &drawIds);
+            checkCulled(culler, expectedBoxes, scene.draws);
+        }
+
+        // -- without drawIds every instance goes to draw 0
+        const std::vector<DrawElementsIndirectCommand> single = { { 3, GLuint(scene.spheres.size()), 0, 0, 0 } };
+        culler.setDraws(single);
+        culler.cull(progs, spheres, view);
+        checkCulled(culler, FrustumCullCPU<BoundingSphere>(scene.spheres, view, 1u), single);
+
+        // -- more visible instances than the draws can hold
+        const std::vector<DrawElementsIndirectCommand> small = { { 36, 1000, 0, 0, 0 }, { 12, 5000, 36, 0, 0 }, { 6, 0, 48, 0, 0 } };
+        culler.setDraws(small);
+
+        for (int repeat = 0; repeat < 2; repeat++)
+        {
+            culler.cull(progs, spheres, view, &drawIds);
+            checkCulled(culler, expectedSpheres, small);
+        }
+
+        // -- sub allocated bounds and drawIds, away from the start of the heap's buffer
+        auto heap = std::make_shared<GPUBufferHeap>(1u << 24);
+        GPUVector<GLuint> padding(heap, 1000u);
+        GPUVector<BoundingSphere> heapSpheres(heap, scene.spheres.size());
+        GPUVector<BoundingBox> heapBoxes(heap, scene.boxes.size());
+        GPUVector<GLuint> heapDrawIds(heap, scene.drawIds.size());
+
+        heapSpheres.assign(scene.spheres);
+        heapBoxes.assign(scene.boxes);
+        heapDrawIds.assign(scene.drawIds);
+        GLSUGAR_CHECK(heapSpheres.StorageOffset() != 0u && heapDrawIds.StorageOffset() != 0u);
+
+        culler.setDraws(scene.draws);
+        culler.cull(progs, heapSpheres, view, &heapDrawIds);
+        checkCulled(culler, expectedSpheres, scene.draws);
+
+        culler.cull(progs, heapBoxes, view, &heapDrawIds);
+        checkCulled(culler, expectedBoxes, scene.draws);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    testCPU();
+
+    GPUContext gpu(argc, argv);
+
+    if (gpu.available)
+    {
+        testGPU();
+    }
+
+    return finish("FrustumCullingTest");
+}
@@ -0,0 +1,271 @@
+/// GPUHashMapCPU against known layouts, and the GPU insert / lookup / erase of GPUHashMap against it.
+
+#include "Tests/TestHarness.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "GL_Containers/GPUContainers.h"
+
+namespace
+{
+    using namespace glSugar::test;
+
+    using CPUMap = GPUHashMapCPU<GLuint, float>;
+
+    std::vector<GLuint> slotKeys(const CPUMap& map)
+    {
+        std::vector<GLuint> rval;
+
+        for (const GPUHashMapSlot& s : map.Slots())
+        {
+            rval.push_back(s.key);
+        }
+
+        return rval;
+    }
+
+    /// - same live entries, wherever they sit
+    template <typename Value>
+    bool sameEntries(const GPUHashMapCPU<GLuint, Value>& a, const GPUHashMapCPU<GLuint, Value>& b)
+    {
+        bool rval = a.Size() == b.Size();
+
+        a.forEach([&](GLuint key, Value value)
+        {
+            const std::optional<Value> other = b.find(key);
+            rval &= other && *other == value;
+        });
+
+        return rval;
+    }
+
+    void testCPU()
+    {
+        // -- murmur3 finalizer
+        GLSUGAR_CHECK(CPUMap::hash(0u) == 0u);
+        GLSUGAR_CHECK(CPUMap::hash(1u) == 1753845952u);
+        GLSUGAR_CHECK(CPUMap::hash(2u) == 3507691905u);
+
+        // -- 2, 3 and 4 all hash to slot 1 of 4 : linear probing puts them in 1, 2, 3
+        constexpr GLuint E = CPUMap::Empty;
+        constexpr GLuint T = CPUMap::Tombstone;
+
+        CPUMap map(3u);
+        GLSUGAR_CHECK(map.SlotCount() == 4);
+
+        GLSUGAR_CHECK(map.insert(2u, 20.f) && map.insert(3u, 30.f) && map.insert(4u, 40.f));
+        GLSUGAR_CHECK(slotKeys(map) == std::vector<GLuint>({ E, 2, 3, 4 }));
+        GLSUGAR_CHECK(map.Size() == 3);
+
+        // -- overwrite in place
+        GLSUGAR_CHECK(map.insert(4u, 41.f) && map.Size() == 3 && map.find(4u) == 41.f);
+
+        // -- the tombstone keeps 4 reachable, and is not reused by inserts
+        GLSUGAR_CHECK(map.erase(3u) && !map.erase(3u));
+        GLSUGAR_CHECK(slotKeys(map) == std::vector<GLuint>({ E, 2, T, 4 }));
+        GLSUGAR_CHECK(!map.find(3u) && map.find(4u) == 41.f);
+
+        GLSUGAR_CHECK(map.insert(3u, 31.f));
+        GLSUGAR_CHECK(slotKeys(map) == std::vector<GLuint>({ 3, 2, T, 4 }));
+
+        // -- no empty slot left
+        GLSUGAR_CHECK(!map.insert(5u, 50.f));
+        GLSUGAR_CHECK(map.Size() == 3 && !map.find(5u));
+
+        std::vector<GLuint> visited;
+        map.forEach([&](GLuint key, float) { visited.push_back(key); });
+        GLSUGAR_CHECK(visited == std::vector<GLuint>({ 3, 2, 4 }));
+    }
+
+    std::vector<GLuint> uniqueKeys(std::mt19937& rng, std::size_t n)
+    {
+        std::vector<GLuint> rval(n);
+
+        for (GLuint& k : rval)
+        {
+            k = rng() % 1000000u;
+        }
+
+        std::sort(rval.begin(), rval.end());
+        rval.erase(std::unique(rval.begin(), rval.end()), rval.end());
+        std::shuffle(rval.begin(), rval.end(), rng);
+
+        return rval;
+    }
+
+    void testGPU()
+    {
+        GPUHashMapPrograms progs =
+        {
+            computeProgram("Shaders/HashMap/HashMapInsert.glsl", { "Shaders/HashMap/HashMap.glsl" }),
+            computeProgram("Shaders/HashMap/HashMapLookup.glsl", { "Shaders/HashMap/HashMap.glsl" }),
+            computeProgram("Shaders/HashMap/HashMapErase.glsl", { "Shaders/HashMap/HashMap.glsl" }),
+        };
+
+        std::mt19937 rng(5);
+
+        const std::vector<GLuint> keys = uniqueKeys(rng, 50000u);
+        std::vector<float> values(keys.size());
+
+        CPUMap reference(2u * keys.size());
+
+        for (std::size_t i = 0; i < keys.size(); i++)
+        {
+            values[i] = float(i) * 0.5f;
+            reference.insert(keys[i], values[i]);
+        }
+
+        // -- concurrent inserts : same entries as the reference, in whatever slots the races gave
+        GPUHashMap<GLuint, float> map(16u);
+        map.reserve(keys.size());
+
+        GPUVector<GLuint> gpuKeys;
+        gpuKeys.assign(keys);
+
+        GPUVector<float> gpuValues;
+        gpuValues.assign(values);
+
+        map.insert(progs, gpuKeys, gpuValues);
+        GLSUGAR_CHECK(sameEntries(map.download(), reference));
+
+        // -- lookups, the second half misses
+        std::vector<GLuint> queries;
+
+        for (std::size_t i = 0; i < 1000; i++) queries.push_back(keys[i * 7 % keys.size()]);
+        for (GLuint i = 0; i < 1000; i++) queries.push_back(2000000u + i);
+
+        GPUVector<GLuint> gpuQueries;
+        gpuQueries.assign(queries);
+
+        GPUVector<float> results;
+        GPUVector<GLuint> found;
+        map.lookup(progs, gpuQueries, results, found);
+
+        std::vector<float> readResults;
+        std::vector<GLuint> readFound;
+        results.copyTo(readResults);
+        found.copyTo(readFound);
+
+        GLSUGAR_CHECK(readResults.size() == queries.size() && readFound.size() == queries.size());
+
+        for (std::size_t i = 0; i < std::min(readResults.size(), queries.size()); i++)
+        {
+            const std::optional<float> expected = reference.find(queries[i]);
+
+            GLSUGAR_CHECK(readFound[i] == (expected ? 1u : 0u));
+            GLSUGAR_CHECK(expected ? readResults[i] == *expected : std::bit_cast<GLuint>(readResults[i]) == map.NotFound);
+        }
+
+        // -- erase half
+        const std::vector<GLuint> erased(keys.begin(), keys.begin() + keys.size() / 2);
+
+        for (GLuint k : erased)
+        {
+            reference.erase(k);
+        }
+
+        GPUVector<GLuint> gpuErased;
+        gpuErased.assign(erased);
+        map.erase(progs, gpuErased);
+        GLSUGAR_CHECK(sameEntries(map.download(), reference));
+
+        map.rehash();
+        GLSUGAR_CHECK(sameEntries(map.download(), reference));
+
+        // -- built on the client : the exact slots of the reference
+        GPUHashMap<GLuint, float> built(keys.size());
+        built.build(std::span<const GLuint>(keys), std::span<const float>(values));
+
+        CPUMap sameOrder(built.SlotCount());
+
+        for (std::size_t i = 0; i < keys.size(); i++)
+        {
+            sameOrder.insert(keys[i], values[i]);
+        }
+
+        const CPUMap downloaded = built.download();
+        GLSUGAR_CHECK(std::equal(downloaded.Slots().begin(), downloaded.Slots().end(), sameOrder.Slots().begin(), sameOrder.Slots().end(),
+            [](const GPUHashMapSlot& a, const GPUHashMapSlot& b) { return a.key == b.key && a.value == b.value; }));
+
+        // -- stored values with the NotFound bits : only found tells them apart from misses
+        GPUHashMap<GLuint, int> ints(64u);
+        const std::vector<GLuint> intKeys = { 1, 2, 3 };
+        const std::vector<int> intValues = { -1, 5, -1 };
+        ints.build(std::span<const GLuint>(intKeys), std::span<const int>(intValues));
+
+        GPUVector<GLuint> intQueries;
+        intQueries.assign(std::vector<GLuint>({ 1, 2, 3, 4, 7 }));
+
+        GPUVector<int> intResults;
+        ints.lookup(progs, intQueries, intResults, found);
+
+        std::vector<int> readInts;
+        intResults.copyTo(readInts);
+        found.copyTo(readFound);
+
+        GLSUGAR_CHECK(readInts == std::vector<int>({ -1, 5, -1, -1, -1 }));
+        GLSUGAR_CHECK(readFound == std::vector<GLuint>({ 1, 1, 1, 0, 0 }));
+
+        // -- sub allocated keys / values / results / found, none of them at the start of the heap's buffer
+        auto heap = std::make_shared<GPUBufferHeap>(1u << 16);
+        GPUVector<GLuint> padding(heap, 100u);
+
+        GPUVector<GLuint> heapKeys(heap, 4u);
+        GPUVector<GLuint> heapValues(heap, 4u);
+        GPUVector<GLuint> heapQueries(heap, 6u);
+        GPUVector<GLuint> heapResults(heap, 6u);
+        GPUVector<GLuint> heapFound(heap, 6u);
+        GPUVector<GLuint> heapErased(heap, 2u);
+
+        heapKeys.assign(std::vector<GLuint>({ 10, 20, 30, 40 }));
+        heapValues.assign(std::vector<GLuint>({ 1, 2, 3, 4 }));
+        heapQueries.assign(std::vector<GLuint>({ 40, 30, 20, 10, 50, 60 }));
+        heapErased.assign(std::vector<GLuint>({ 20, 40 }));
+        GLSUGAR_CHECK(heapKeys.StorageOffset() != 0u && heapFound.StorageOffset() != 0u);
+
+        GPUHashMap<GLuint, GLuint> heapMap(16u);
+        heapMap.insert(progs, heapKeys, heapValues);
+
+        GPUHashMapCPU<GLuint, GLuint> heapReference(heapMap.SlotCount());
+
+        for (GLuint k = 1; k <= 4; k++)
+        {
+            heapReference.insert(10u * k, k);
+        }
+
+        GLSUGAR_CHECK(sameEntries(heapMap.download(), heapReference));
+
+        heapMap.lookup(progs, heapQueries, heapResults, heapFound);
+
+        std::vector<GLuint> readUints;
+        heapResults.copyTo(readUints);
+        heapFound.copyTo(readFound);
+
+        GLSUGAR_CHECK(readUints == std::vector<GLuint>({ 4, 3, 2, 1, heapMap.NotFound, heapMap.NotFound }));
+        GLSUGAR_CHECK(readFound == std::vector<GLuint>({ 1, 1, 1, 1, 0, 0 }));
+
+        heapMap.erase(progs, heapErased);
+        heapReference.erase(20u);
+        heapReference.erase(40u);
+        GLSUGAR_CHECK(sameEntries(heapMap.download(), heapReference));
+
+        map.clear();
+        GLSUGAR_CHECK(map.download().Size() == 0);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    testCPU();
+
+    GPUContext gpu(argc, argv);
+
+    if (gpu.available)
+    {
+        testGPU();
+    }
+
+    return finish("HashMapTest");
+}
@@ -0,0 +1,253 @@
+/// ParticleSystemCPU against known behaviour, and ParticleSystem against ParticleSystemCPU.
+
+#include "Tests/TestHarness.h"
+
+#include <algorithm>
+#include <cmath>
+#include <tuple>
+#include <vector>
+
+#include "GL_Containers/GPUContainers.h"
+#include "Algorithms/ParticleSystem.h"
+
+namespace
+{
+    using namespace glSugar;
+    using namespace glSugar::test;
+
+    bool near(float a, float b)
+    {
+        return std::fabs(a - b) < 1e-5f;
+    }
+
+    /// - the GPU compacts the survivors in any order : compare both sides sorted on values no step changes the order of
+    bool particleLess(const Particle& a, const Particle& b)
+    {
+        return std::tie(a.lifetime, a.age, a.position[0]) < std::tie(b.lifetime, b.age, b.position[0]);
+    }
+
+    float distance(const Particle& p, const float eye[3])
+    {
+        const float d[3] = { p.position[0] - eye[0], p.position[1] - eye[1], p.position[2] - eye[2] };
+        return std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+    }
+
+    void testCPU()
+    {
+        // -- PCG hash reference values
+        GLSUGAR_CHECK(particleHash(0u) == 129708002u);
+        GLSUGAR_CHECK(particleHash(1u) == 2831084092u);
+        GLSUGAR_CHECK(particleHash(12345u) == 4099845390u);
+
+        // -- no radius, spread or lifetime range : every particle starts at the emitter
+        ParticleEmitter still;
+        still.position[1] = 2.f;
+        still.radius = 0.f;
+        still.velocity[0] = 1.f;
+        still.velocitySpread = 0.f;
+        still.lifetimeMin = still.lifetimeMax = 1.f;
+
+        std::vector<Particle> emitted;
+        EmitParticlesCPU(still, 3u, 0u, emitted);
+
+        GLSUGAR_CHECK(emitted.size() == 3);
+
+        for (const Particle& p : emitted)
+        {
+            GLSUGAR_CHECK(p.position[0] == 0.f && p.position[1] == 2.f && p.position[2] == 0.f);
+            GLSUGAR_CHECK(p.velocity[0] == 1.f && p.velocity[1] == 0.f && p.velocity[2] == 0.f);
+            GLSUGAR_CHECK(p.lifetime == 1.f && p.age == 0.f && p.color[3] == 1.f);
+        }
+
+        // -- one explicit Euler step under gravity
+        ParticleSimulationSettings settings;
+        std::vector<Particle> stepped = SimulateParticlesCPU(emitted, settings, {}, {}, 0.5f);
+
+        GLSUGAR_CHECK(stepped.size() == 3);
+        GLSUGAR_CHECK(near(stepped[0].age, 0.5f));
+        GLSUGAR_CHECK(near(stepped[0].velocity[1], -9.81f * 0.5f));
+        GLSUGAR_CHECK(near(stepped[0].position[0], 0.5f));
+        GLSUGAR_CHECK(near(stepped[0].position[1], 2.f - 9.81f * 0.25f));
+
+        // -- the second step reaches the lifetime
+        GLSUGAR_CHECK(SimulateParticlesCPU(stepped, settings, {}, {}, 0.5f).empty());
+
+        // -- falling through the ground : pushed back onto it, normal velocity reflected by restitution, tangential reduced by friction
+        Particle falling = {};
+        falling.position[1] = 0.05f;
+        falling.velocity[0] = 1.f;
+        falling.velocity[1] = -1.f;
+        falling.lifetime = 10.f;
+
+        settings.gravity[1] = 0.f;
+        const ParticlePlane ground = { { 0.f, 1.f, 0.f }, 0.f };
+        const std::vector<Particle> bounced = SimulateParticlesCPU(std::span(&falling, 1), settings, std::span(&ground, 1), {}, 0.1f);
+
+        GLSUGAR_CHECK(bounced.size() == 1);
+        GLSUGAR_CHECK(near(bounced[0].position[1], 0.f));
+        GLSUGAR_CHECK(near(bounced[0].velocity[1], settings.restitution));
+        GLSUGAR_CHECK(near(bounced[0].velocity[0], 1.f - settings.friction));
+
+        // -- inside a sphere : pushed out to its surface
+        Particle inside = {};
+        inside.position[0] = 0.25f;
+        inside.lifetime = 10.f;
+
+        const ParticleSphere ball = { { 0.f, 0.f, 0.f }, 1.f };
+        const std::vector<Particle> pushed = SimulateParticlesCPU(std::span(&inside, 1), settings, {}, std::span(&ball, 1), 0.f);
+
+        GLSUGAR_CHECK(pushed.size() == 1 && near(pushed[0].position[0], 1.f));
+
+        // -- emission past the capacity is dropped
+        ParticleSystemCPU system(4u);
+        system.settings.gravity[1] = 0.f;
+        system.emit(still, 3u);
+        system.emit(still, 3u);
+        system.update(0.f);
+        GLSUGAR_CHECK(system.particles.size() == 4);
+
+        // -- farthest first
+        system.particles[0].position[0] = 1.f;
+        system.particles[1].position[0] = 3.f;
+        system.particles[2].position[0] = 2.f;
+        system.particles[3].position[0] = -0.5f;
+
+        const float eye[3] = { 0.f, 2.f, 0.f };
+        GLSUGAR_CHECK(system.sortOrder(eye) == std::vector<GLuint>({ 1, 2, 0, 3 }));
+    }
+
+    gl::Program sortKeyProgram()
+    {
+        return computeProgram("Shaders/Particles/ParticleSortKeys.glsl", { "Shaders/RadixSort/SortKey.glsl" });
+    }
+
+    void testGPU()
+    {
+        ParticlePrograms progs =
+        {
+            computeProgram("Shaders/Particles/ParticleSimulate.glsl"),
+            computeProgram("Shaders/Particles/ParticleEmit.glsl"),
+            computeProgram("Shaders/Particles/ParticleFinalize.glsl"),
+            sortKeyProgram(),
+        };
+
+        StreamCompactionPrograms scanProgs =
+        {
+            computeProgram("Shaders/StreamCompaction/ScanBlocks.glsl"),
+            computeProgram("Shaders/StreamCompaction/ScanAddBlockSums.glsl"),
+            computeProgram("Shaders/StreamCompaction/Reduce.glsl"),
+            computeProgram("Shaders/StreamCompaction/Compact.glsl"),
+        };
+
+        RadixSortPrograms radixProgs =
+        {
+            computeProgram("Shaders/RadixSort/RadixHistogram.glsl"),
+            computeProgram("Shaders/RadixSort/RadixScatter.glsl"),
+        };
+
+        const std::size_t capacity = 30000;
+
+        ParticleSystem gpu(capacity);
+        ParticleSystemCPU cpu(capacity);
+
+        const ParticlePlane ground = { { 0.f, 1.f, 0.f }, 0.f };
+        const ParticleSphere ball = { { 0.f, 1.f, 0.f }, 0.5f };
+
+        gpu.setColliders(std::span(&ground, 1), std::span(&ball, 1));
+        cpu.planes = { ground };
+        cpu.spheres = { ball };
+        gpu.settings.drag = cpu.settings.drag = 0.1f;
+
+        ParticleEmitter emitter;
+        emitter.position[1] = 2.f;
+        emitter.radius = 0.3f;
+        emitter.velocity[0] = 1.f;
+        emitter.velocitySpread = 2.f;
+        emitter.lifetimeMin = 0.5f;
+        emitter.lifetimeMax = 1.5f;
+
+        // -- a burst, then a trickle while the burst dies
+        for (int frame = 0; frame < 30; frame++)
+        {
+            const GLuint count = frame < 12 ? 3000u : 200u;
+
+            gpu.emit(emitter, count);
+            cpu.emit(emitter, count);
+
+            gpu.update(progs, 0.05f);
+            cpu.update(0.05f);
+
+            GLSUGAR_CHECK(gpu.CountBound() >= cpu.particles.size());
+        }
+
+        const std::size_t count = gpu.Particles().syncSize();
+        GLSUGAR_CHECK(count == cpu.particles.size());
+
+        std::vector<Particle> gpuParticles;
+        gpu.Particles().copyTo(gpuParticles);
+
+        std::vector<Particle> cpuParticles = cpu.particles;
+        std::sort(gpuParticles.begin(), gpuParticles.end(), particleLess);
+        std::sort(cpuParticles.begin(), cpuParticles.end(), particleLess);
+
+        if (gpuParticles.size() == cpuParticles.size())
+        {
+            float maxError = 0.f;
+
+            for (std::size_t i = 0; i < cpuParticles.size(); i++)
+            {
+                for (int k = 0; k < 3; k++)
+                {
+                    maxError = std::max(maxError, std::fabs(gpuParticles[i].position[k] - cpuParticles[i].position[k]));
+                }
+            }
+
+            GLSUGAR_CHECK(maxError < 1e-3f);
+        }
+
+        ParticleIndirectCommands commands;
+        gpu.IndirectCommands().GetSubData(0u, sizeof(commands), &commands);
+
+        GLSUGAR_CHECK(commands.drawArrays.count == count && commands.drawElements.count == count);
+        GLSUGAR_CHECK(commands.dispatch[0] == (count + ParticleGroupSize - 1) / ParticleGroupSize);
+
+        // -- emission past the capacity is dropped
+        gpu.emit(emitter, GLuint(capacity + 10000u));
+        gpu.update(progs, 0.05f);
+        GLSUGAR_CHECK(gpu.Particles().syncSize() == capacity);
+
+        // -- back to front.  The GPU computes the distances itself, so allow for rounding
+        const float eye[3] = { 5.f, 1.f, 0.f };
+        RadixSortScratch scratch;
+        gpu.sort(progs, scanProgs, radixProgs, scratch, eye);
+
+        std::vector<GLuint> order;
+        gpu.DrawOrder().copyTo(order);
+        gpu.Particles().copyTo(gpuParticles);
+
+        GLSUGAR_CHECK(order.size() >= capacity);
+        order.resize(std::min(order.size(), capacity));
+
+        for (std::size_t i = 1; i < order.size(); i++)
+        {
+            GLSUGAR_CHECK(distance(gpuParticles[order[i]], eye) <= distance(gpuParticles[order[i - 1]], eye) + 1e-5f);
+        }
+
+        std::sort(order.begin(), order.end());
+        GLSUGAR_CHECK(std::adjacent_find(order.begin(), order.end()) == order.end() && order.back() == capacity - 1);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    testCPU();
+
+    GPUContext gpu(argc, argv);
+
+    if (gpu.available)
+    {
+        testGPU();
+    }
+
+    return finish("ParticleSystemTest");
+}
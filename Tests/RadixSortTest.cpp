@@ -0,0 +1,198 @@
+/// RadixSortCPU() against known outputs and std::stable_sort, and the GPU sorts against it.
+
+#include "Tests/TestHarness.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "GL_Containers/GPUContainers.h"
+#include "Algorithms/RadixSort.h"
+
+namespace
+{
+    using namespace glSugar;
+    using namespace glSugar::test;
+
+    /// - floats through floatToSortKey() in SortKey.glsl
+    const char* SortKeySource = R"(#version 450 core
+
+layout(local_size_x=64, local_size_y=1, local_size_z=1) in;
+
+layout(std430, binding = 0) readonly buffer InputBuffer { float values[]; };
+layout(std430, binding = 1) writeonly buffer OutputBuffer { uint keys[]; };
+
+uniform uint count;
+
+void main()
+{
+    const uint i = gl_GlobalInvocationID.x;
+
+    if (i < count)
+    {
+        keys[i] = floatToSortKey(values[i]);
+    }
+}
+)";
+
+    std::vector<GLuint> randomKeys(std::mt19937& rng, std::size_t n)
+    {
+        std::vector<GLuint> rval(n);
+
+        for (GLuint& k : rval)
+        {
+            // -- plenty of duplicates, so stability matters
+            k = rng() % 4 ? rng() % 1000u : rng();
+        }
+
+        return rval;
+    }
+
+    /// - the stable sort RadixSortCPU() has to match, on the low keyBits bits
+    std::vector<GLuint> stableOrder(const std::vector<GLuint>& keys, GLuint keyBits)
+    {
+        const GLuint mask = keyBits >= 32u ? ~0u : (1u << keyBits) - 1u;
+
+        std::vector<GLuint> rval(keys.size());
+        std::iota(rval.begin(), rval.end(), 0u);
+        std::stable_sort(rval.begin(), rval.end(), [&](GLuint a, GLuint b) { return (keys[a] & mask) < (keys[b] & mask); });
+
+        return rval;
+    }
+
+    void testCPU()
+    {
+        std::vector<GLuint> keys = { 5, 3, 0xFFFFFFFFu, 3, 0 };
+        std::vector<GLuint> values = { 0, 1, 2, 3, 4 };
+
+        RadixSortCPU(keys, values);
+        GLSUGAR_CHECK(keys == std::vector<GLuint>({ 0, 3, 3, 5, 0xFFFFFFFFu }));
+        GLSUGAR_CHECK(values == std::vector<GLuint>({ 4, 1, 3, 0, 2 }));
+
+        // -- only the low digit : equal digits keep their order
+        std::vector<GLuint> low = { 0x21, 0x12, 0x11 };
+        RadixSortCPU(low, {}, 4u);
+        GLSUGAR_CHECK(low == std::vector<GLuint>({ 0x21, 0x11, 0x12 }));
+
+        const std::vector<GLuint> unsorted = { 30, 10, 20 };
+        GLSUGAR_CHECK(RadixSortIndicesCPU(unsorted) == std::vector<GLuint>({ 1, 2, 0 }));
+
+        const float ascending[] = { -INFINITY, -2.0f, -1.0f, -0.0f, 0.0f, 1e-30f, 1.0f, 2.0f, INFINITY };
+
+        for (std::size_t i = 1; i < std::size(ascending); i++)
+        {
+            GLSUGAR_CHECK(FloatToSortKey(ascending[i - 1]) < FloatToSortKey(ascending[i]));
+        }
+
+        std::mt19937 rng(1);
+
+        for (GLuint keyBits : { 32u, 12u, 4u })
+        {
+            const std::vector<GLuint> random = randomKeys(rng, 10000u);
+            GLSUGAR_CHECK(RadixSortIndicesCPU(random, keyBits) == stableOrder(random, keyBits));
+        }
+    }
+
+    void testGPU(StreamCompactionPrograms& scanProgs, RadixSortPrograms& progs)
+    {
+        std::mt19937 rng(2);
+        RadixSortScratch scratch;
+
+        // -- 12 bits is an odd number of passes, the result comes back from the scratch buffers.  0 bits sorts nothing
+        for (std::size_t n : { std::size_t(1), std::size_t(1000), std::size_t(100000) })
+        {
+            for (GLuint keyBits : { 32u, 12u, 0u })
+            {
+                const std::vector<GLuint> keyValues = randomKeys(rng, n);
+                std::vector<GLuint> read;
+
+                std::vector<GLuint> expectedKeys = keyValues;
+                std::vector<GLuint> expectedValues(n);
+                std::iota(expectedValues.begin(), expectedValues.end(), 0u);
+                RadixSortCPU(expectedKeys, expectedValues, keyBits);
+
+                GPUVector<GLuint> keys;
+                keys.assign(keyValues);
+                RadixSort(scanProgs, progs, keys, scratch, keyBits);
+                keys.copyTo(read);
+                GLSUGAR_CHECK(read == expectedKeys);
+
+                std::vector<GLuint> valueValues(n);
+                std::iota(valueValues.begin(), valueValues.end(), 0u);
+
+                GPUVector<GLuint> values;
+                values.assign(valueValues);
+                keys.assign(keyValues);
+                RadixSort(scanProgs, progs, keys, values, scratch, keyBits);
+                keys.copyTo(read);
+                GLSUGAR_CHECK(read == expectedKeys);
+                values.copyTo(read);
+                GLSUGAR_CHECK(read == expectedValues);
+
+                GPUVector<GLuint> indices;
+                keys.assign(keyValues);
+                RadixSortIndices(scanProgs, progs, keys, indices, scratch, keyBits);
+                indices.copyTo(read);
+                GLSUGAR_CHECK(read == RadixSortIndicesCPU(keyValues, keyBits));
+            }
+        }
+    }
+
+    void testSortKey()
+    {
+        gl::Program prog = computeProgramFromSource(SortKeySource, { "Shaders/RadixSort/SortKey.glsl" });
+
+        const std::vector<float> floats = { -INFINITY, -2.0f, -1.0f, -0.0f, 0.0f, 1e-30f, 1.0f, 2.0f, INFINITY, 3.5f, -7.25f };
+
+        gl::Buffer in;
+        in.Storage(floats.size() * sizeof(float), floats.data(), 0);
+
+        gl::Buffer out;
+        out.Storage(floats.size() * sizeof(GLuint), nullptr, 0);
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, in.name());
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, out.name());
+        prog.Use();
+        prog.Uniform1<GLuint>("count", GLuint(floats.size()));
+        glDispatchCompute(1, 1, 1);
+        glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+        std::vector<GLuint> keys(floats.size());
+        out.GetSubData(0u, keys.size() * sizeof(GLuint), keys.data());
+
+        for (std::size_t i = 0; i < floats.size(); i++)
+        {
+            GLSUGAR_CHECK(keys[i] == FloatToSortKey(floats[i]));
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    testCPU();
+
+    GPUContext gpu(argc, argv);
+
+    if (gpu.available)
+    {
+        StreamCompactionPrograms scanProgs =
+        {
+            computeProgram("Shaders/StreamCompaction/ScanBlocks.glsl"),
+            computeProgram("Shaders/StreamCompaction/ScanAddBlockSums.glsl"),
+            computeProgram("Shaders/StreamCompaction/Reduce.glsl"),
+            computeProgram("Shaders/StreamCompaction/Compact.glsl"),
+        };
+
+        RadixSortPrograms progs =
+        {
+            computeProgram("Shaders/RadixSort/RadixHistogram.glsl"),
+            computeProgram("Shaders/RadixSort/RadixScatter.glsl"),
+        };
+
+        testGPU(scanProgs, progs);
+        testSortKey();
+    }
+
+    return finish("RadixSortTest");
+}
@@ -0,0 +1,140 @@
+/// removeUnorderedPlan() against removeSwapBack on a std::vector, and the batched removeUnordered() of GPUVector / GPUDeque against the same reference.
+
+#include "Tests/TestHarness.h"
+
+#include <random>
+#include <vector>
+
+#include "GL_Containers/GPUContainers.h"
+
+namespace
+{
+    using namespace glSugar::test;
+
+    /// - removeSwapBack on each index in descending order, the semantics removeUnorderedPlan() promises
+    std::vector<GLuint> swapBackReference(std::vector<GLuint> values, std::vector<std::size_t> indices)
+    {
+        std::sort(indices.begin(), indices.end());
+        indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+
+        for (std::size_t k = indices.size(); k-- > 0;)
+        {
+            values[indices[k]] = values.back();
+            values.pop_back();
+        }
+
+        return values;
+    }
+
+    std::vector<GLuint> applyPlan(std::vector<GLuint> values, const std::vector<std::size_t>& indices)
+    {
+        std::size_t newSize = 0;
+
+        for (const CopyRun& r : removeUnorderedPlan(indices, values.size(), newSize))
+        {
+            GLSUGAR_CHECK(r.src >= newSize && r.dst + r.count <= newSize);
+            std::copy_n(values.begin() + r.src, r.count, values.begin() + r.dst);
+        }
+
+        values.resize(newSize);
+        return values;
+    }
+
+    std::vector<GLuint> iota(std::size_t n)
+    {
+        std::vector<GLuint> rval(n);
+        std::iota(rval.begin(), rval.end(), 0u);
+        return rval;
+    }
+
+    void testPlan()
+    {
+        // -- size 10 without 1, 3, 8 : 8 is popped, 3 gets 9 and 1 gets 7
+        std::size_t newSize = 0;
+        const std::vector<std::size_t> indices = { 8, 1, 3, 3 };
+        const std::vector<CopyRun> runs = removeUnorderedPlan(indices, 10u, newSize);
+
+        GLSUGAR_CHECK(newSize == 7);
+        GLSUGAR_CHECK(runs.size() == 2);
+        GLSUGAR_CHECK(runs[0].src == 7 && runs[0].dst == 1 && runs[0].count == 1);
+        GLSUGAR_CHECK(runs[1].src == 9 && runs[1].dst == 3 && runs[1].count == 1);
+
+        // -- a block of holes at the front is filled by one run from the tail
+        const std::vector<std::size_t> front = { 0, 1, 2, 3 };
+        const std::vector<CopyRun> merged = removeUnorderedPlan(front, 10u, newSize);
+
+        GLSUGAR_CHECK(newSize == 6);
+        GLSUGAR_CHECK(merged.size() == 1 && merged[0].src == 6 && merged[0].dst == 0 && merged[0].count == 4);
+
+        // -- removing the tail needs no copies
+        const std::vector<std::size_t> tail = { 7, 8, 9 };
+        GLSUGAR_CHECK(removeUnorderedPlan(tail, 10u, newSize).empty() && newSize == 7);
+
+        std::mt19937 rng(1);
+
+        for (int iteration = 0; iteration < 2000; iteration++)
+        {
+            const std::size_t size = 1 + rng() % 200;
+            std::vector<std::size_t> remove(rng() % (size + 1));
+
+            for (std::size_t& i : remove)
+            {
+                i = rng() % size;
+            }
+
+            GLSUGAR_CHECK(applyPlan(iota(size), remove) == swapBackReference(iota(size), remove));
+        }
+    }
+
+    void testGPU()
+    {
+        std::mt19937 rng(2);
+
+        for (int iteration = 0; iteration < 20; iteration++)
+        {
+            const std::size_t size = 1 + rng() % 5000;
+            std::vector<std::size_t> remove(rng() % size);
+
+            for (std::size_t& i : remove)
+            {
+                i = rng() % size;
+            }
+
+            const std::vector<GLuint> expected = swapBackReference(iota(size), remove);
+
+            GPUVector<GLuint> vector;
+            vector.assign(iota(size));
+            vector.removeUnordered(remove);
+
+            std::vector<GLuint> out;
+            vector.copyTo(out);
+            GLSUGAR_CHECK(out == expected);
+
+            // -- small pages so the runs cross page boundaries
+            GPUDeque<GLuint, false, 64> deque;
+
+            for (GLuint v : iota(size))
+            {
+                deque.push_back(v);
+            }
+
+            deque.removeUnordered(remove);
+            deque.copyTo(out);
+            GLSUGAR_CHECK(out == expected);
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    testPlan();
+
+    GPUContext gpu(argc, argv);
+
+    if (gpu.available)
+    {
+        testGPU();
+    }
+
+    return finish("RemoveUnorderedTest");
+}
@@ -0,0 +1,229 @@
+/// The scan / reduce / compact CPU references against known outputs, and the GPU versions over GPUVector, GPUDeque and GPUPingPongVector against them.
+
+#include "Tests/TestHarness.h"
+
+#include <random>
+#include <vector>
+
+#include "GL_Containers/GPUContainers.h"
+#include "Algorithms/StreamCompaction.h"
+
+namespace
+{
+    using namespace glSugar;
+    using namespace glSugar::test;
+
+    /// - 16 bytes, so the compaction copies several words per element
+    struct Item
+    {
+        GLuint id;
+        GLuint a, b, c;
+
+        bool operator==(const Item&) const = default;
+    };
+
+    // -- single block, block boundaries, two and three scan levels
+    constexpr std::size_t Sizes[] = { 1, 255, 256, 257, 5000, 65537, 300000 };
+
+    void testCPU()
+    {
+        const std::vector<GLuint> in = { 3, 1, 4, 1, 5 };
+
+        GLSUGAR_CHECK(ExclusiveScanCPU(in) == std::vector<GLuint>({ 0, 3, 4, 8, 9 }));
+        GLSUGAR_CHECK(InclusiveScanCPU(in) == std::vector<GLuint>({ 3, 4, 8, 9, 14 }));
+        GLSUGAR_CHECK(ReduceCPU(in) == 14);
+        GLSUGAR_CHECK(ReduceCPU({}) == 0);
+
+        // -- any non zero flag keeps the element
+        const std::vector<GLuint> flags = { 1, 0, 0, 2, 0 };
+        GLSUGAR_CHECK(CompactCPU<GLuint>(in, flags) == std::vector<GLuint>({ 3, 1 }));
+        GLSUGAR_CHECK(CompactCPU<GLuint>(in, std::vector<GLuint>(5, 0u)).empty());
+    }
+
+    std::vector<GLuint> randomValues(std::mt19937& rng, std::size_t n, GLuint mod)
+    {
+        std::vector<GLuint> rval(n);
+
+        for (GLuint& v : rval)
+        {
+            v = rng() % mod;
+        }
+
+        return rval;
+    }
+
+    void testScanReduce(StreamCompactionPrograms& progs)
+    {
+        std::mt19937 rng(1);
+        ScanScratch scratch;
+
+        gl::Buffer result;
+        result.Storage(4 * sizeof(GLuint), nullptr, GL_DYNAMIC_STORAGE_BIT);
+
+        for (std::size_t n : Sizes)
+        {
+            const std::vector<GLuint> values = randomValues(rng, n, 16u);
+
+            GPUVector<GLuint> in;
+            in.assign(values);
+
+            GPUVector<GLuint> out;
+            std::vector<GLuint> read;
+
+            ExclusiveScan(progs, in, out, scratch);
+            out.copyTo(read);
+            GLSUGAR_CHECK(read == ExclusiveScanCPU(values));
+
+            InclusiveScan(progs, in, out, scratch);
+            out.copyTo(read);
+            GLSUGAR_CHECK(read == InclusiveScanCPU(values));
+
+            // -- in place
+            InclusiveScan(progs, in, in, scratch);
+            in.copyTo(read);
+            GLSUGAR_CHECK(read == InclusiveScanCPU(values));
+
+            in.assign(values);
+            Reduce(progs, in, result, 1u);
+
+            // -- paged, with a front that is not page aligned
+            GPUDeque<GLuint, false, 4096> deque;
+
+            for (int i = 0; i < 100; i++) deque.push_back(0u);
+            for (int i = 0; i < 100; i++) deque.pop_front();
+            for (GLuint v : values) deque.push_back(v);
+
+            Reduce(progs, deque, result, 2u);
+
+            GLuint sums[4];
+            result.GetSubData(0u, sizeof(sums), sums);
+            GLSUGAR_CHECK(sums[1] == ReduceCPU(values));
+            GLSUGAR_CHECK(sums[2] == ReduceCPU(values));
+        }
+
+        // -- sub allocated, so v[0] is not at the start of the buffer
+        auto heap = std::make_shared<GPUBufferHeap>(1u << 20);
+        GPUVector<GLuint> padding(heap, 1000u);
+        GPUVector<GLuint> in(heap, 5000u);
+        GPUVector<GLuint> out(heap, 5000u);
+
+        const std::vector<GLuint> values = randomValues(rng, 5000u, 16u);
+        in.assign(values);
+        GLSUGAR_CHECK(in.StorageOffset() != 0u);
+
+        std::vector<GLuint> read;
+        ExclusiveScan(progs, in, out, scratch);
+        out.copyTo(read);
+        GLSUGAR_CHECK(read == ExclusiveScanCPU(values));
+    }
+
+    std::vector<Item> randomItems(std::mt19937& rng, std::size_t n)
+    {
+        std::vector<Item> rval(n);
+
+        for (std::size_t i = 0; i < n; i++)
+        {
+            rval[i] = { GLuint(i), GLuint(rng()), GLuint(rng()), GLuint(rng()) };
+        }
+
+        return rval;
+    }
+
+    void testCompact(StreamCompactionPrograms& progs)
+    {
+        std::mt19937 rng(2);
+        ScanScratch scratch;
+
+        gl::Buffer counter;
+        counter.Storage(4 * sizeof(GLuint), nullptr, GL_DYNAMIC_STORAGE_BIT);
+
+        for (std::size_t n : Sizes)
+        {
+            const std::vector<Item> items = randomItems(rng, n);
+            const std::vector<GLuint> flagValues = randomValues(rng, n, 3u);
+            const std::vector<Item> expected = CompactCPU<Item>(items, flagValues);
+
+            GPUVector<GLuint> flags;
+            flags.assign(flagValues);
+
+            GPUVector<Item> src;
+            src.assign(items);
+
+            GPUVector<Item> dst;
+            std::vector<Item> read;
+            GLuint count[4];
+
+            Compact(progs, src, flags, dst, counter, 1u, scratch);
+            counter.GetSubData(0u, sizeof(count), count);
+            GLSUGAR_CHECK(count[1] == expected.size());
+
+            dst.resize(count[1]);
+            dst.copyTo(read);
+            GLSUGAR_CHECK(read == expected);
+
+            GPUDeque<Item, false, 4096> deque;
+
+            for (int i = 0; i < 100; i++) deque.push_back(Item{});
+            for (int i = 0; i < 100; i++) deque.pop_front();
+            for (const Item& item : items) deque.push_back(item);
+
+            Compact(progs, deque, flags, dst, counter, 2u, scratch);
+            counter.GetSubData(0u, sizeof(count), count);
+            GLSUGAR_CHECK(count[2] == expected.size());
+
+            dst.resize(count[2]);
+            dst.copyTo(read);
+            GLSUGAR_CHECK(read == expected);
+
+            GPUPingPongVector<Item> pingPong;
+            pingPong.assign(items);
+            pingPong.beginStep();
+            Compact(progs, pingPong, flags, scratch);
+            pingPong.swap();
+
+            GLSUGAR_CHECK(pingPong.syncSize() == expected.size());
+            pingPong.copyTo(read);
+            GLSUGAR_CHECK(read == expected);
+        }
+
+        // -- nothing survives : the counter is still written
+        GPUVector<GLuint> flags;
+        flags.assign(std::vector<GLuint>(1000u, 0u));
+
+        GPUVector<Item> src;
+        src.assign(randomItems(rng, 1000u));
+
+        GPUVector<Item> dst;
+        const GLuint stale = 1234u;
+        counter.SubData(0u, sizeof(stale), &stale);
+
+        Compact(progs, src, flags, dst, counter, 0u, scratch);
+
+        GLuint count = stale;
+        counter.GetSubData(0u, sizeof(count), &count);
+        GLSUGAR_CHECK(count == 0u);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    testCPU();
+
+    GPUContext gpu(argc, argv);
+
+    if (gpu.available)
+    {
+        StreamCompactionPrograms progs =
+        {
+            computeProgram("Shaders/StreamCompaction/ScanBlocks.glsl"),
+            computeProgram("Shaders/StreamCompaction/ScanAddBlockSums.glsl"),
+            computeProgram("Shaders/StreamCompaction/Reduce.glsl"),
+            computeProgram("Shaders/StreamCompaction/Compact.glsl"),
+        };
+
+        testScanReduce(progs);
+        testCompact(progs);
+    }
+
+    return finish("StreamCompactionTest");
+}
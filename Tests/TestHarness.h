@@ -0,0 +1,118 @@
+#pragma once
+
+/// Shared setup of the GLSugar tests.  Each test is one executable registered with ctest (GLSUGAR_BUILD_TESTS).
+/// - CPU references are checked against known outputs, always.
+/// - GPU paths are compared against the references when a headless GL 4.5 context can be created (Benchmarks/HeadlessContext.h), skipped otherwise.
+///   --software forces llvmpipe.
+/// - shaders are read from the source tree (GLSUGAR_SOURCE_DIR, set by CMake) and built the way a client builds them.
+
+#include <glad/gl.h>
+#include <glhpp/OpenGL.hpp>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <initializer_list>
+#include <sstream>
+#include <string>
+
+// -- every test is a single translation unit
+#define VIRTUOSO_SHADERPROGRAMLIB_IMPLEMENTATION
+#include "GL_Objects/ShaderProgram.h"
+#undef VIRTUOSO_SHADERPROGRAMLIB_IMPLEMENTATION
+
+#include "Benchmarks/HeadlessContext.h"
+
+#ifndef GLSUGAR_SOURCE_DIR
+#define GLSUGAR_SOURCE_DIR ""
+#endif
+
+#define GLSUGAR_CHECK(expr) glSugar::test::check(bool(expr), #expr, __FILE__, __LINE__)
+
+namespace glSugar::test
+{
+    inline int failures = 0;
+
+    inline void check(bool ok, const char* expr, const char* file, int line)
+    {
+        if (!ok)
+        {
+            failures++;
+            std::fprintf(stderr, "%s:%d : check failed : %s\n", file, line, expr);
+        }
+    }
+
+    /// - file under the repository root, eg. "Shaders/HashMap/HashMap.glsl"
+    inline std::string readSource(const std::string& path)
+    {
+        std::ifstream file(std::string(GLSUGAR_SOURCE_DIR) + path);
+        std::stringstream ss;
+        ss << file.rdbuf();
+
+        if (!file)
+        {
+            std::fprintf(stderr, "could not read %s\n", path.c_str());
+            failures++;
+        }
+
+        return ss.str();
+    }
+
+    /// - compute program from src, a shader with a #version line.  functions (.glsl files under the repository root) are inserted after it, as clients do
+    inline gl::Program computeProgramFromSource(std::string src, std::initializer_list<std::string> functions = {})
+    {
+        std::string inserted;
+
+        for (const std::string& f : functions)
+        {
+            inserted += readSource(f) + "\n";
+        }
+
+        src.insert(src.find('\n') + 1, inserted);
+
+        gl::Program rval = Program({ Shader(GL_COMPUTE_SHADER, src) });
+
+        GLint linked = GL_FALSE;
+        glGetProgramiv(rval.name(), GL_LINK_STATUS, &linked);
+        check(linked == GL_TRUE, "program links", __FILE__, __LINE__);
+
+        return rval;
+    }
+
+    /// - same, with the main shader read from the repository
+    inline gl::Program computeProgram(const std::string& main, std::initializer_list<std::string> functions = {})
+    {
+        return computeProgramFromSource(readSource(main), functions);
+    }
+
+    /// - the context of the GPU checks.  available is false when there is none, and the test only runs its CPU checks
+    struct GPUContext
+    {
+        bench::HeadlessContext context;
+        bool available = false;
+
+        GPUContext(int argc, char** argv)
+        {
+            bool software = false;
+
+            for (int i = 1; i < argc; i++)
+            {
+                software |= std::strcmp(argv[i], "--software") == 0;
+            }
+
+            available = context.create(software);
+
+            if (!available)
+            {
+                std::printf("no GL 4.5 context, skipping the GPU checks\n");
+            }
+        }
+    };
+
+    /// - exit code of the test
+    inline int finish(const char* name)
+    {
+        std::printf("%s : %s\n", name, failures ? "FAILED" : "passed");
+        return failures ? 1 : 0;
+    }
+}
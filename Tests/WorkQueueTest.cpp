@@ -0,0 +1,234 @@
+/// GPUWorkQueueCPU against known counts, and a GPU producer -> consumer chain of GPUWorkQueue against it.
+
+#include "Tests/TestHarness.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "GL_Containers/GPUContainers.h"
+
+namespace
+{
+    using namespace glSugar::test;
+
+    /// - pushes i * 2 for every third i < n
+    const char* ProducerSource = R"(#version 450 core
+
+layout(local_size_x=128, local_size_y=1, local_size_z=1) in;
+
+layout(std430, binding = 0) writeonly buffer ItemBuffer { uint items[]; };
+layout(std430, binding = 1) buffer OutQueueHeader { WorkQueueHeader outQueue; };
+
+uniform uint n;
+
+void main()
+{
+    const uint i = gl_GlobalInvocationID.x;
+
+    if (i >= n || i % 3u != 0u) return;
+
+    const uint slot = WORK_QUEUE_PUSH(outQueue, 1u);
+
+    if (slot < outQueue.capacity)
+    {
+        items[slot] = i * 2u;
+    }
+}
+)";
+
+    /// - forwards v + 1 for every item v that is a multiple of 4
+    const char* ConsumerSource = R"(#version 450 core
+
+layout(local_size_x=64, local_size_y=1, local_size_z=1) in;
+
+layout(std430, binding = 0) readonly buffer InItemBuffer { uint inItems[]; };
+layout(std430, binding = 1) buffer InQueueHeader { WorkQueueHeader inQueue; };
+layout(std430, binding = 2) writeonly buffer OutItemBuffer { uint outItems[]; };
+layout(std430, binding = 3) buffer OutQueueHeader { WorkQueueHeader outQueue; };
+
+void main()
+{
+    const uint i = gl_GlobalInvocationID.x;
+
+    if (i >= workQueueSize(inQueue)) return;
+
+    const uint v = inItems[i];
+
+    if (v % 4u != 0u) return;
+
+    const uint slot = WORK_QUEUE_PUSH(outQueue, 1u);
+
+    if (slot < outQueue.capacity)
+    {
+        outItems[slot] = v + 1u;
+    }
+}
+)";
+
+    constexpr GLuint ProducerInvocations = 100000;
+    constexpr GLuint ConsumerGroupSize = 64;
+
+    void testCPU()
+    {
+        GPUWorkQueueCPU<GLuint> queue(4u);
+
+        for (GLuint i = 0; i < 6; i++)
+        {
+            GLSUGAR_CHECK(queue.push(10u * i) == i);
+        }
+
+        GLSUGAR_CHECK(queue.Count() == 6 && queue.Dropped() == 2);
+
+        queue.prepareDispatch(3u);
+        GLSUGAR_CHECK(queue.Size() == 4 && queue.Groups() == 2);
+
+        // -- whole groups, past Size()
+        std::vector<std::size_t> invocations;
+        queue.dispatchIndirect([&](std::size_t i) { invocations.push_back(i); });
+        GLSUGAR_CHECK(invocations == std::vector<std::size_t>({ 0, 1, 2, 3, 4, 5 }));
+
+        // -- pops stop at the capacity
+        std::vector<GLuint> popped;
+        GLuint item = 0;
+
+        while (queue.pop(item))
+        {
+            popped.push_back(item);
+        }
+
+        GLSUGAR_CHECK(popped == std::vector<GLuint>({ 0, 10, 20, 30 }));
+
+        queue.reserve(8u);
+        queue.reset();
+        GLSUGAR_CHECK(queue.Capacity() == 8 && queue.Count() == 0 && queue.Dropped() == 0);
+
+        queue.prepareDispatch(3u);
+        GLSUGAR_CHECK(queue.Size() == 0 && queue.Groups() == 0);
+        GLSUGAR_CHECK(!queue.pop(item));
+    }
+
+    /// - the producer and consumer on the client, the expected result of one GPU frame
+    struct CPUChain
+    {
+        GPUWorkQueueCPU<GLuint> a;
+        GPUWorkQueueCPU<GLuint> b;
+
+        CPUChain(std::size_t capacityA, std::size_t capacityB) :
+            a(capacityA),
+            b(capacityB)
+        {
+            for (GLuint i = 0; i < ProducerInvocations; i++)
+            {
+                if (i % 3u == 0u) a.push(i * 2u);
+            }
+
+            a.prepareDispatch(ConsumerGroupSize);
+
+            a.dispatchIndirect([&](std::size_t i)
+            {
+                if (i < a.Size() && a.Items()[i] % 4u == 0u) b.push(a.Items()[i] + 1u);
+            });
+
+            b.prepareDispatch(ConsumerGroupSize);
+        }
+    };
+
+    std::vector<GLuint> sortedItems(std::span<const GLuint> items, std::size_t size)
+    {
+        std::vector<GLuint> rval(items.begin(), items.begin() + std::min(size, items.size()));
+        std::sort(rval.begin(), rval.end());
+        return rval;
+    }
+
+    void testGPU(GPUWorkQueuePrograms& progs, gl::Program& producer, gl::Program& consumer, std::size_t capacityA, std::size_t capacityB)
+    {
+        const CPUChain expected(capacityA, capacityB);
+
+        GPUWorkQueue<GLuint> a(capacityA);
+        GPUWorkQueue<GLuint> b(capacityB);
+
+        // -- the second frame's reset() has to wait for the first frame's atomics
+        for (int frame = 0; frame < 3; frame++)
+        {
+            a.reset();
+            b.reset();
+
+            a.bind(0, 1);
+            producer.Use();
+            producer.Uniform1<GLuint>("n", ProducerInvocations);
+            glDispatchCompute((ProducerInvocations + 127) / 128, 1, 1);
+
+            a.prepareDispatch(progs, ConsumerGroupSize);
+
+            a.bind(0, 1);
+            b.bind(2, 3);
+            consumer.Use();
+            a.dispatchIndirect();
+
+            b.prepareDispatch(progs, ConsumerGroupSize);
+        }
+
+        GPUReadback<WorkQueueHeader> headerA = a.readHeaderAsync();
+        GPUReadback<WorkQueueHeader> headerB = b.readHeaderAsync();
+        GPUReadback<GLuint> countB = b.readCountAsync();
+
+        const WorkQueueHeader ha = headerA.get()[0];
+        const WorkQueueHeader hb = headerB.get()[0];
+
+        GLSUGAR_CHECK(ha.count == expected.a.Count() && ha.size == expected.a.Size() && ha.capacity == capacityA);
+        GLSUGAR_CHECK(ha.groups[0] == expected.a.Groups() && ha.groups[1] == 1 && ha.groups[2] == 1);
+        GLSUGAR_CHECK(hb.size == std::min<std::size_t>(hb.count, capacityB) && hb.groups[0] == (hb.size + ConsumerGroupSize - 1) / ConsumerGroupSize);
+        GLSUGAR_CHECK(countB.get()[0] == hb.count);
+
+        // -- which items survive a full queue depends on the order of the atomics : compare the contents only without drops
+        if (!expected.a.Dropped())
+        {
+            GLSUGAR_CHECK(hb.count == expected.b.Count() && hb.size == expected.b.Size());
+
+            std::vector<GLuint> items;
+            a.Items().copyTo(items);
+            GLSUGAR_CHECK(sortedItems(items, ha.size) == sortedItems(expected.a.Items(), expected.a.Size()));
+
+            if (!expected.b.Dropped())
+            {
+                b.Items().copyTo(items);
+                GLSUGAR_CHECK(sortedItems(items, hb.size) == sortedItems(expected.b.Items(), expected.b.Size()));
+            }
+        }
+
+        gl::Buffer size;
+        size.Storage(sizeof(GLuint), nullptr, GL_DYNAMIC_STORAGE_BIT);
+        b.copySizeTo(size, 0u);
+
+        GLuint copied = 0;
+        size.GetSubData(0u, sizeof(copied), &copied);
+        GLSUGAR_CHECK(copied == hb.size);
+
+        // -- a larger capacity takes effect at reset()
+        b.reserve(capacityB * 2u);
+        b.reset();
+
+        GPUReadback<WorkQueueHeader> grown = b.readHeaderAsync();
+        GLSUGAR_CHECK(grown.get()[0].capacity == capacityB * 2u && grown.get()[0].count == 0u);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    testCPU();
+
+    GPUContext gpu(argc, argv);
+
+    if (gpu.available)
+    {
+        GPUWorkQueuePrograms progs = { computeProgram("Shaders/WorkQueue/WorkQueueDispatchArgs.glsl", { "Shaders/WorkQueue/WorkQueue.glsl" }) };
+        gl::Program producer = computeProgramFromSource(ProducerSource, { "Shaders/WorkQueue/WorkQueue.glsl" });
+        gl::Program consumer = computeProgramFromSource(ConsumerSource, { "Shaders/WorkQueue/WorkQueue.glsl" });
+
+        // -- room for everything, then drops in both queues
+        testGPU(progs, producer, consumer, 40000u, 20000u);
+        testGPU(progs, producer, consumer, 1000u, 100u);
+    }
+
+    return finish("WorkQueueTest");
+}